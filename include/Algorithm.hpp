@@ -3,6 +3,11 @@
 
 #include "Graph.hpp"
 #include "Graphics.hpp"
+#include "RoutingGraph.hpp"
+#include "CompressedAdjacency.hpp"
+#include "EdgeWeights.hpp"
+#include "ContractionHierarchy.hpp"
+#include "Landmarks.hpp"
 #include <vector>
 #include <unordered_set>
 #include <queue>
@@ -11,10 +16,10 @@ class Algorithm {
 private: 
 	// Define a struct for A* node
 	struct AstarNode {
-		int64_t id; // Node ID
+		uint32_t index; // Node index
 		double g, h; // Cost from start, heuristic cost to target
 
-		AstarNode(int64_t id, double g, double h) : id(id), g(g), h(h) {}
+		AstarNode(uint32_t index, double g, double h) : index(index), g(g), h(h) {}
 
 		// Calculate the total cost f = g + h
 		double f() const {
@@ -27,15 +32,53 @@ private:
 		}
 	};
 
+	// Per node state of a search in arrays indexed by node index
+	// Kept from one search to the next so that routing doesn't allocate, only touched entries are reset
+	struct SearchState {
+		std::vector<double> dist; // g values, infinity if not reached
+		std::vector<uint32_t> prev_node; // Index of the node the best path came from
+		std::vector<uint32_t> prev_edge; // ID of the edge the best path came through
+		std::vector<uint32_t> touched; // Indices with a g value to reset
+		std::vector<uint32_t> improved; // Neighbors of the current node that got a shorter path
+		std::vector<double> heuristics; // Heuristics of the improved neighbors
+		std::vector<uint32_t> improved_nodes; // Node indices of the improved junctions, on a routing graph
+		Landmarks::Target landmark_target; // Distances from the landmarks to the target, if the graph has landmarks
+	};
+
+	// A* over the nodes of the graph, with getNeighbors(index) giving the neighbors of a node
+	// from the full adjacency or the compressed one
+	// Edge weights come from weights if given, from the neighbors otherwise
+	template <typename GetNeighbors>
+	static void runNodeAstar(const Graph& graph, GetNeighbors getNeighbors, uint32_t source_index, uint32_t target_index,
+		std::vector<uint32_t>& path, std::vector<bool>& path_lookup, double& distance, const EdgeWeights::Version* weights = nullptr);
+
+	// A* over the junctions of the graph's routing graph, runAstar hands over once the nodes are found
+	// Source and target are node indices, the path is unpacked to the edges of the graph
+	static void runContractedAstar(const Graph& graph, const RoutingGraph& routing, uint32_t source, uint32_t target,
+		std::vector<uint32_t>& path, std::vector<bool>& path_lookup, double& distance);
+
+	// Bidirectional search up the graph's contraction hierarchy, runAstar hands over once the nodes are found
+	// Source and target are node indices, the path is unpacked to the edges of the graph
+	static void runHierarchySearch(const Graph& graph, const ContractionHierarchy& hierarchy, uint32_t source, uint32_t target,
+		std::vector<uint32_t>& path, std::vector<bool>& path_lookup, double& distance);
+
 public:
 	// Run A* algorithm to find the shortest path from source to target
 	// If a path is found, store the edge IDs in the path vector and the total distance (meters) in the distance reference
+	// path_lookup is indexed by edge ID, edges of the path are set to true
+	// Source and target are OSM IDs, the search itself runs on node indices
+	// Graphs with changing edge weights are searched node by node on one snapshot of them
+	// Weights below the length of an edge make the heuristics overestimate, and routes may then not be the shortest
+	// Graphs with a contraction hierarchy are searched on it otherwise, giving a route of the same distance
+	// Graphs with a routing graph are searched on it otherwise, giving the same path and distance
+	// Graphs with a compressed adjacency are searched on it otherwise, with weights rounded up to decimeters
+	// Graphs with labeled components return at once with no path if the nodes are in different components
+	// Graphs with landmarks raise the Haversine heuristic to the landmark bound wherever that is higher
 	static void runAstar(Graph& graph, int64_t source, int64_t target,
-		std::vector<uint32_t>& path, std::unordered_set<uint32_t>& path_lookup, double& distance);
+		std::vector<uint32_t>& path, std::vector<bool>& path_lookup, double& distance);
 
-private:
-	// Helper function for A* to calculate the heuristic cost from current node to target node 
-	static double heuristic(Graph& graph, int64_t current, int64_t target);
+	// Nodes, junctions or hierarchy nodes settled by the last runAstar on the calling thread
+	static size_t getSettledCount();
 };
 
 #endif
\ No newline at end of file
@@ -4,18 +4,32 @@
 #include <SFML/Graphics.hpp>
 #include "Graph.hpp"
 #include "Graphics.hpp"
+#include "LoadProgress.hpp"
 #include <memory>
 
 constexpr sf::Color BG_COLOR = sf::Color(10, 10, 35); // Dark blue
 
 class App {
 public:
-	App(Graph& graph);
+	// The map may still be loading, progress tells when its parts are ready
+	App(Graph& graph, const Quadtree& quadtree, const LoadProgress& progress);
 
 	// Main event loop of application
 	void run();
 
 private:
+	// Print the time to each startup milestone the first time a displayed frame had it ready
+	void reportStartup(bool edges_ready, bool graph_ready, bool quadtree_ready);
+
+private:
+	const LoadProgress& progress;
+
+	// Startup milestones already reported
+	bool first_frame_reported = false;
+	bool first_edges_reported = false;
+	bool routing_reported = false;
+	bool map_reported = false;
+
 	// Initial window resolution
 	float window_width;
 	float window_height;
@@ -0,0 +1,172 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include "ParseOSM.hpp"
+
+// Benchmarks are run from the command line instead of opening the viewer:
+//
+// MapViewer --bench <name> [arguments...]
+//
+// Available benchmarks:
+// ingest <file.osm|file.osm.pbf>... Compare ingest throughput and peak memory of DOM, streaming, parallel and PBF parsing
+// scaling <file.osm> [max_threads]  Scaling curve of parallel parsing from 1 to max_threads threads
+// prune <file.osm>                  Nodes, graph memory and binary size with and without node pruning
+// load <file.bin>                   Size, startup time and memory of standard, compact and mapped binary files
+// startup <file.bin>                Startup phase times and time to first edges with and without the stored adjacency list and quadtree
+// hash <file.bin>                   Ingest and lookup throughput, memory and probe lengths of the node and edge hash tables
+// weights <file.bin>                Edge weight throughput and error of the Haversine kernel, portable, AVX2 and threaded
+// route <file.bin> [queries]        Routing latency and adjacency memory, hash map by OSM ID against CSR by index
+// chains <file.bin> [queries]       Node and edge counts and routing latency with degree-2 chains collapsed
+// compress <file.bin> [queries]     Bytes per edge and routing latency of the full and the compressed adjacency
+// live <file.bin> [seconds] [batch] [rate] Edge weight update throughput and routing latency while updates are applied
+// components <file.bin> [queries]   Component labeling time and routing latency between components with and without labels
+// hierarchy <file.bin> [queries]    Contraction hierarchy build time, size and routing latency against A* and chains collapsed
+// landmarks <file.bin> [queries] [count] Settled nodes and routing latency of A* with Haversine and landmark bounds
+// order <file.bin> [queries]        Locality, cache misses, routing and panning time with nodes by ID and in Hilbert order
+// tiles <file.bin> [budget_mb] [grid] Resident memory while panning across and routing through a tiled map
+// tags [ways]                       Cost per way of tag filtering and number decoding, before and after TagFilter
+
+
+class Benchmark {
+public:
+	// Run the benchmark named by the first argument
+	// Returns the process exit code
+	static int run(const std::vector<std::string>& args);
+
+	// Resident memory of the process in bytes
+	static size_t currentMemory();
+
+	// Peak resident memory of the process in bytes
+	static size_t peakMemory();
+
+	// Reset the peak memory counter so that the next measurement starts from current usage
+	// Returns false if the platform does not support resetting
+	static bool resetPeakMemory();
+
+	// Simple stopwatch started on construction
+	class Timer {
+	public:
+		Timer() : start(std::chrono::steady_clock::now()) {}
+
+		// Elapsed time in milliseconds
+		double elapsedMs() const {
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+	private:
+		std::chrono::steady_clock::time_point start;
+	};
+
+	// Hardware counter of the cache misses of the calling thread, started on construction
+	// Only on Linux where the CPU exposes its counters, which virtual machines often don't
+	class CacheMisses {
+	public:
+		CacheMisses();
+		~CacheMisses();
+		CacheMisses(const CacheMisses&) = delete;
+		CacheMisses& operator=(const CacheMisses&) = delete;
+
+		// Misses since construction, -1 if not available
+		long long count() const;
+
+	private:
+		int fd = -1;
+	};
+
+private:
+	// Compare DOM, streaming and parallel ingestion of the same .osm file
+	static void ingest(const std::string& file_path);
+
+	// Time parallel ingestion of a file with 1, 2, 4... up to max_threads threads
+	static void scaling(const std::string& file_path, unsigned max_threads);
+
+	// Load a file with and without pruning of nodes not used by any way
+	static void prune(const std::string& file_path);
+
+	// Load the same graph from a standard, a compact and a mapped binary file
+	static void load(const std::string& file_path);
+
+	// Time the startup phases of a map stored with and without its derived data
+	static void startup(const std::string& file_path);
+
+	// Pan a view across a tiled copy of the map and route between its corners,
+	// with every tile kept in memory and with a memory budget
+	// Tiles should be several pages large, smaller ones can't be dropped from memory
+	static void tiles(const std::string& file_path, size_t budget_mb, unsigned int grid);
+
+	// Fill and query the building tables of Graph with the nodes and edges of a map,
+	// using the standard containers with the old XOR edge hash, with a mixing hash, and the flat hash tables
+	static void hash(const std::string& file_path);
+
+	// Compute the weight of every edge per edge with the math library, with the batch kernel
+	// and through Graph with gathering and threads, checking the kernel against the math library
+	static void weights(const std::string& file_path);
+
+	// Route between random nodes with the hash map adjacency keyed by OSM ID that Graph used to have,
+	// and with the compressed sparse rows on node indices
+	static void route(const std::string& file_path, size_t queries);
+
+	// Route between random nodes on the full graph and on the routing graph with its chains collapsed
+	static void chains(const std::string& file_path, size_t queries);
+
+	// Pack the adjacency of a map by ID and in Hilbert order, and route between random nodes
+	// on the full and the compressed adjacency of the Hilbert sorted graph
+	static void compress(const std::string& file_path, size_t queries);
+
+	// Route between random nodes on reader threads for some seconds without updates to the edge weights,
+	// then as long again with a writer thread applying rate batches of random changes per second,
+	// then apply batches back to back without readers
+	static void live(const std::string& file_path, double seconds, size_t batch, double rate);
+
+	// Label the components of a map and route from its largest component to the others,
+	// searching until the queue runs out and returning at once with the labels
+	static void components(const std::string& file_path, size_t queries);
+
+	// Build, save and load a contraction hierarchy of a map, and route between random nodes of its largest component
+	// on the full graph, on the routing graph and on the hierarchy
+	static void hierarchy(const std::string& file_path, size_t queries);
+
+	// Pick count landmarks of a map with both strategies, and route between random nodes of its largest component
+	// with the Haversine heuristic and with the bounds of either set of landmarks
+	static void landmarks(const std::string& file_path, size_t queries, unsigned int count);
+
+	// Route and pan across the same map with nodes and edges sorted by ID and in Hilbert order
+	static void order(const std::string& file_path, size_t queries);
+
+	// Time tag filtering and node reference decoding of generated ways
+	// with the old string based filter and with TagFilter
+	static void tags(size_t way_count);
+
+	// Routes searched by runRoutes, the path as edge IDs and the distance of each
+	struct Routes {
+		std::vector<std::vector<uint32_t>> paths;
+		std::vector<double> distances;
+		double ms_per_route = 0;
+		size_t settled = 0; // Nodes settled by all searches together
+		size_t found = 0;
+	};
+
+	// Random pairs of node IDs, the first drawn from the node indices in from and the second from to,
+	// or from every node where either is empty
+	// Drawn with the same seed each time, so every setting a bench compares routes between the same nodes
+	static std::vector<std::pair<int64_t, int64_t>> randomPairs(const Graph& graph, size_t queries,
+		const std::vector<uint32_t>& from = {}, const std::vector<uint32_t>& to = {});
+
+	// Indices of the nodes in the largest component of a labeled graph
+	// Routes between them are always found and most cross the map
+	static std::vector<uint32_t> largestComponent(const Graph& graph);
+
+	// Search the route between every pair on the graph as it is set up
+	static Routes runRoutes(Graph& graph, const std::vector<std::pair<int64_t, int64_t>>& pairs);
+
+	// Number of routes whose distance differs from the expected one
+	static size_t countMismatches(const std::vector<double>& expected, const std::vector<double>& distances);
+
+	// Printable name of a parse mode
+	static const char* modeName(ParseMode mode);
+};
+
+#endif
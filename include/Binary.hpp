@@ -2,8 +2,19 @@
 #define BINARY_H
 
 #include "ParseOSM.hpp"
+#include "Quadtree.hpp"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
 
 // Binary file format:
+//
+// [File header]
+// [magic: char[4] = "MVGB"] [version: uint32_t] BINARY_VERSION, or MAPPED_VERSION for mapped and tiled files
+// [source_hash: uint64_t] Fingerprint of the map files the graph was built from
+// [config_hash: uint64_t] Fingerprint of the settings that change the graph, such as the way filter
+// [payload_size: uint64_t] [payload_hash: uint64_t] Size and Hash::bytes of everything after the file header
 // 
 // [Header]
 // [min_lat: double] [min_lon: double] [max_lat: double] [max_lon: double]
@@ -14,15 +25,158 @@
 // 
 // [Edges]
 // [edge_id: uint32_t] [from: int64_t] [to: int64_t] * num_edges
+// Edges are written in ID order, so edge_id is the index of the edge
+//
+// [Ways]
+// [way_id: int64_t] * num_edges
+// OSM way of every edge in ID order, needed for applying .osc changes
+//
+// Files written before the file header was added start straight from [Header] and may end after the edges
+// They still load, but can't be checked for corruption or matched to their map files
+//
+//
+// Mapped binary file format:
+//
+// [File header] as above with magic "MVGM"
+// payload_hash combines Hash::bytes of every array below, padding is not included
+//
+// [Header]
+// [min_lat: double] [min_lon: double] [max_lat: double] [max_lon: double]
+// [num_nodes: uint64_t] [num_edges: uint64_t]
+//
+// [Arrays] each starting at a multiple of MAPPED_ALIGNMENT bytes from the start of the file, zero padded
+// [node_ids: int64_t] * num_nodes Sorted, or in Hilbert order with the id_order section below
+// [node_lats: int32_t] * num_nodes Fixed-point, in units of 1/COORDINATE_SCALE degrees
+// [node_lons: int32_t] * num_nodes
+// [adj_offsets: uint32_t] * (num_nodes + 1)
+// [adj_targets: uint32_t] * 2 * num_edges Node indices
+// [adj_weights: double] * 2 * num_edges
+// [adj_edges: uint32_t] * 2 * num_edges
+// [edges: from int64_t, to int64_t] * num_edges
+// [edge_ways: int64_t] * num_edges
+//
+// [Quadtree] optional, in the same aligned layout
+// [num_cells: uint64_t] [num_cell_edges: uint64_t]
+// [segments: from x float, from y float, to x float, to y float] * num_edges
+// [cells: left, top, right, bottom float, first_child uint32_t, begin uint32_t, end uint32_t] * num_cells
+// [cell_edges: uint32_t] * num_cell_edges
+//
+// [Order] optional, in the same aligned layout after the quadtree, which must then be present
+// [num_tiles: uint64_t] Always 0
+// [id_order: uint32_t] * num_nodes Node indices sorted by node ID
+// Written for a graph after sortByHilbert, the nodes and edges are then in Hilbert order
+//
+// These are the arrays of Graph after createAdj and of Quadtree after build, so a mapped file is used in place without decoding
+// Integers and doubles are stored in the byte order of the machine that wrote the file
+//
+//
+// Tiled binary file format:
+//
+// [File header] as above with magic "MVGT"
+// A mapped file of a graph after partitionTiles, with the quadtree always present
+// Nodes are grouped by tile instead of sorted by ID, edges follow the tile of their source node
+//
+// [Tiles] in the same aligned layout after the quadtree, in place of [Order]
+// [num_tiles: uint64_t]
+// [id_order: uint32_t] * num_nodes Node indices sorted by node ID
+// [tiles: min_lat, max_lat, min_lon, max_lon double, node_begin, node_end, edge_begin, edge_end uint32_t] * num_tiles
+//
+// Each tile is a range of every array above, so it can be read in and dropped from memory on its own
+//
+//
+// Compact binary file format:
+//
+// [File header] as above with magic "MVGC"
+//
+// [Header]
+// [min_lat: double] [min_lon: double] [max_lat: double] [max_lon: double]
+// [num_nodes: uint32_t] [num_edges: uint32_t]
+//
+// [Nodes] sorted by ID, also for a graph in Hilbert order
+// [id: varint] [lat: zigzag varint] [lon: zigzag varint] * num_nodes
+// Each value is the difference to the previous node, the first node is relative to 0
+// Coordinates are the fixed-point values of the graph, in units of 1/COORDINATE_SCALE degrees
+//
+// [Edges] in ID order
+// [from: zigzag varint] [to: zigzag varint] [way_id: zigzag varint] * num_edges
+// from and to are indices into the sorted nodes, from relative to the previous edge's to and to relative to from
+// way_id is relative to the previous edge's way
+// Consecutive edges usually continue the same way, so most values take a single byte
+//
+// Varints store 7 bits per byte, lowest first, with the high bit set on every byte but the last
+// Zigzag maps signed values to unsigned ones so that small negative differences stay small
+
+enum class BinaryFormat {
+	Standard, // Decoded into the graph on load
+	Mapped, // Larger, memory mapped and used as is
+	Compact, // Smallest, delta coded
+	Tiled // Mapped, with nodes and edges grouped into tiles that are loaded on demand
+};
+
+constexpr char BINARY_MAGIC[4] = { 'M', 'V', 'G', 'B' };
+constexpr char MAPPED_MAGIC[4] = { 'M', 'V', 'G', 'M' };
+constexpr char COMPACT_MAGIC[4] = { 'M', 'V', 'G', 'C' };
+constexpr char TILED_MAGIC[4] = { 'M', 'V', 'G', 'T' };
+constexpr uint32_t BINARY_VERSION = 1; // Increase whenever the layout changes
+constexpr uint32_t MAPPED_VERSION = 4; // Version of mapped and tiled files, which follow the layout of Graph's arrays
+constexpr size_t MAPPED_ALIGNMENT = 64; // Cache line, also keeps every element naturally aligned
+constexpr size_t FINGERPRINT_SAMPLE_SIZE = 1 << 20; // Bytes hashed from the start, middle and end of every map file
 
 
 class Binary {
 public:
-	// Serialize data from parseOSM to binary file
-	static void saveToBinary(const std::string& bin_file_path, const Graph& graph);
+	// Provenance and checksum written in front of the graph
+	struct FileHeader {
+		BinaryFormat format = BinaryFormat::Standard;
+		uint32_t version = 0;
+		uint64_t source_hash = 0;
+		uint64_t config_hash = 0;
+		uint64_t payload_size = 0;
+		uint64_t payload_hash = 0;
+	};
+
+	// Serialize a graph to binary file, createAdj must have been called
+	// source_hash and config_hash are stored in the file header for readHeader
+	// Mapped files also store the quadtree if one built from graph is given
+	// Tiled files need a graph after partitionTiles and its quadtree, mapped and compact files need one that isn't tiled
+	// Mapped files of a graph after sortByHilbert need its quadtree too
+	static void saveToBinary(const std::string& bin_file_path, const Graph& graph, uint64_t source_hash = 0, uint64_t config_hash = 0,
+		BinaryFormat format = BinaryFormat::Standard, const Quadtree* quadtree = nullptr);
+
+	// Deserialize data from binary file of either format to graph
+	// Standard and compact files are checked completely before anything is added to graph
+	// Call createAdj afterwards for standard files, compact files come with the adjacency created
+	// Mapped and tiled files are used in place and come with the adjacency already created,
+	// they are hashed only if verify is set since hashing reads every page of the file
+	// quadtree is set from mapped files that store one and left as it is otherwise
+	// Returns false and leaves graph untouched if the file is missing, truncated or corrupted
+	static bool loadFromBinary(const std::string& bin_file_path, Graph& graph, bool verify = true, Quadtree* quadtree = nullptr);
+
+	// Read only the file header of a binary file of either format
+	// Returns false if the file is missing, too short or written before file headers, or has another version of its format
+	static bool readHeader(const std::string& bin_file_path, FileHeader& header);
+
+	// Fingerprint of map files from their names, sizes, modification times and a hash of sampled content
+	// Cheap enough to compute on every start, even for large extracts
+	static uint64_t sourceFingerprint(const std::vector<std::string>& file_paths);
+
+private:
+	// Write the payload of each format
+	static void writeStandard(std::ofstream& out_file, const Graph& graph, uint64_t source_hash, uint64_t config_hash);
+	static void writeMapped(std::ofstream& out_file, const Graph& graph, uint64_t source_hash, uint64_t config_hash,
+		const Quadtree* quadtree);
+	static void writeCompact(std::ofstream& out_file, const Graph& graph, uint64_t source_hash, uint64_t config_hash);
+
+	// Decode the graph from a payload buffer
+	// Returns false if the sizes in the payload don't add up
+	static bool decodePayload(const char* data, size_t size, Graph& graph);
+
+	// Decode the graph from a compact payload buffer
+	// Returns false if a value runs past the buffer or an index is out of range
+	static bool decodeCompact(const char* data, size_t size, Graph& graph);
 
-	// Deserialize data from binary file to graph
-	static void loadFromBinary(const std::string& bin_file_path, Graph& graph);
+	// Map a file in the mapped or tiled format into graph
+	static bool mapBinary(const std::string& bin_file_path, Graph& graph, bool verify, Quadtree* quadtree);
 };
 
-#endif
\ No newline at end of file
+#endif
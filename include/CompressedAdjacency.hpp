@@ -0,0 +1,121 @@
+#ifndef COMPRESSEDADJACENCY_H
+#define COMPRESSEDADJACENCY_H
+
+#include "Graph.hpp"
+#include <vector>
+#include <cstdint>
+
+// Adjacency list of a graph packed into a byte stream, for maps whose full adjacency doesn't fit in memory
+//
+// Every node has a record of its neighbors in the same order as in Graph's compressed sparse rows
+// A record starts with its length in bytes, then three varints per neighbor:
+// - the neighbor index minus the previous one (the node itself for the first), zigzag encoded
+// - the weight in WEIGHT_UNIT steps, rounded up so that the Haversine heuristic stays admissible
+// - the edge ID minus the previous one (the sample's edge for the first), zigzag encoded
+// Neighbors and edges of a node are close to it in Hilbert order, so most differences fit in one byte
+// Only every SAMPLE_INTERVAL:th record has its offset stored, the records before a node in its sample are skipped by their lengths
+
+
+class CompressedAdjacency {
+public:
+	// Nodes per stored record offset
+	static constexpr uint32_t SAMPLE_INTERVAL = 16;
+
+	// Meters per weight step, decimeters
+	static constexpr double WEIGHT_UNIT = 0.1;
+
+	// Neighbors of one node, decoded while iterating into Graph::Neighbor values
+	class Neighbors {
+	public:
+		class Iterator {
+		public:
+			Iterator(const uint8_t* at, const uint8_t* end, uint32_t index, uint32_t edge_id) : at(at), end(end) {
+				current.index = index;
+				current.edge_id = edge_id;
+				decode();
+			}
+
+			const Graph::Neighbor& operator*() const { return current; }
+			Iterator& operator++() {
+				at = next;
+				decode();
+				return *this;
+			}
+			bool operator!=(const Iterator& other) const { return at != other.at; }
+
+		private:
+			void decode() {
+				if (at == end) return;
+				next = at;
+				current.index += unzigzag(readVarint(next));
+				current.weight = readVarint(next) * WEIGHT_UNIT;
+				current.edge_id += unzigzag(readVarint(next));
+			}
+
+			const uint8_t* at; // Start of the current neighbor
+			const uint8_t* next = nullptr; // Start of the next one
+			const uint8_t* end;
+			Graph::Neighbor current{};
+		};
+
+		Neighbors(const uint8_t* begin, const uint8_t* end, uint32_t index, uint32_t edge_id) :
+			first(begin), last(end), index(index), edge_id(edge_id) {}
+
+		Iterator begin() const { return Iterator(first, last, index, edge_id); }
+		Iterator end() const { return Iterator(last, last, index, edge_id); }
+
+	private:
+		const uint8_t* first;
+		const uint8_t* last;
+		uint32_t index, edge_id; // What the first differences are from
+	};
+
+	CompressedAdjacency() = default;
+
+	// Pack the adjacency of a graph, createAdj must have been called
+	// Reads every node, so tiled graphs loaded on demand are better searched as they are
+	void build(const Graph& graph);
+
+	size_t getNodeCount() const { return node_count; }
+
+	// Memory taken in bytes
+	size_t memoryBytes() const;
+
+	Neighbors getNeighbors(uint32_t index) const {
+		uint32_t sample = index / SAMPLE_INTERVAL;
+		const uint8_t* at = bytes.data() + sample_offsets[sample];
+		for (uint32_t skip = index % SAMPLE_INTERVAL; skip > 0; --skip) {
+			uint32_t length = readVarint(at);
+			at += length;
+		}
+		uint32_t length = readVarint(at);
+		return Neighbors(at, at + length, index, sample_edges[sample]);
+	}
+
+private:
+	// Differences wrap around in 32 bits, zigzag puts small negative ones next to small positive ones
+	static uint32_t zigzag(uint32_t difference) {
+		return (difference << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(difference) >> 31);
+	}
+	static uint32_t unzigzag(uint32_t value) {
+		return (value >> 1) ^ (0u - (value & 1));
+	}
+
+	static void appendVarint(std::vector<uint8_t>& out, uint32_t value);
+
+	// Read a varint of 7 bits per byte, lowest first, and move at past it
+	static uint32_t readVarint(const uint8_t*& at) {
+		uint32_t value = *at & 0x7F;
+		for (unsigned shift = 7; *at++ & 0x80; shift += 7) {
+			value |= static_cast<uint32_t>(*at & 0x7F) << shift;
+		}
+		return value;
+	}
+
+	size_t node_count = 0;
+	std::vector<uint8_t> bytes; // Records of all nodes in node order
+	std::vector<uint64_t> sample_offsets; // Offset in bytes of every SAMPLE_INTERVAL:th record
+	std::vector<uint32_t> sample_edges; // Edge ID the first difference of the records in a sample is from
+};
+
+#endif
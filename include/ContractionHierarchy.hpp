@@ -0,0 +1,81 @@
+#ifndef CONTRACTIONHIERARCHY_H
+#define CONTRACTIONHIERARCHY_H
+
+#include "Graph.hpp"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Contraction hierarchy of a graph, for route searches that only go up the hierarchy from both ends
+//
+// Nodes are contracted one at a time, least important first, and get their rank in that order
+// Contracting a node adds a shortcut between two of its remaining neighbors for every shortest path through it,
+// unless a witness search finds another path that is as short
+// Each original edge and shortcut is stored as an arc of its lower ranked end, pointing up to the other end
+// A shortest route always climbs from the source to its highest node and descends to the target, so a search
+// from both ends over the upward arcs meets on it
+// Shortcuts remember the two arcs they replace, which unpacks a route to the same edge IDs as a search over the full graph
+//
+// Hierarchy file format, next to the binary file of the graph:
+//
+// [magic: char[4] = "MVCH"] [version: uint32_t] HIERARCHY_VERSION
+// [graph_hash: uint64_t] Graph::adjacencyFingerprint of the graph the hierarchy was built for
+// [num_nodes: uint64_t] [num_arcs: uint64_t] [shortcuts: uint64_t]
+// [data_hash: uint64_t] Hash::bytes of the arrays below
+// [up_offsets: uint32_t] * (num_nodes + 1)
+// [arcs: target, middle, first, second uint32_t, weight double] * num_arcs
+// Integers and doubles are stored in the byte order of the machine that wrote the file
+
+constexpr char HIERARCHY_MAGIC[4] = { 'M', 'V', 'C', 'H' };
+constexpr uint32_t HIERARCHY_VERSION = 1; // Increase whenever the layout or the contraction changes
+
+
+class ContractionHierarchy {
+public:
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	// Original edge or shortcut, stored with its lower ranked end
+	struct Arc {
+		uint32_t target; // Node index of the higher ranked end
+		uint32_t middle; // Node contracted to make the shortcut, NONE for an original edge
+		uint32_t first; // Edge ID of an original edge, arc from the middle node to one end of a shortcut
+		uint32_t second; // Arc from the middle node to the other end of a shortcut
+		double weight;
+	};
+
+	ContractionHierarchy() = default;
+
+	// Order and contract the nodes of a graph, createAdj must have been called
+	// Reads every node, so tiled graphs loaded on demand are better searched as they are
+	void build(const Graph& graph);
+
+	// Write the hierarchy to a file, built for graph
+	// Returns false if the file can't be written
+	bool save(const std::string& file_path, const Graph& graph) const;
+
+	// Read a hierarchy written for graph
+	// Returns false if the file is missing, damaged, of another version or written for another graph
+	bool load(const std::string& file_path, const Graph& graph);
+
+	size_t getNodeCount() const { return up_offsets.empty() ? 0 : up_offsets.size() - 1; }
+	size_t getArcCount() const { return arcs.size(); }
+	size_t getShortcutCount() const { return shortcuts; }
+
+	// Memory taken by the hierarchy in bytes
+	size_t memoryBytes() const;
+
+	// Arcs up from a node, by arc index
+	uint32_t upBegin(uint32_t node) const { return up_offsets[node]; }
+	uint32_t upEnd(uint32_t node) const { return up_offsets[node + 1]; }
+	const Arc& getArc(uint32_t arc) const { return arcs[arc]; }
+
+	// Append the edge IDs of an arc to edges, in order from node from to node to, its two ends
+	void unpack(uint32_t arc, uint32_t from, uint32_t to, std::vector<uint32_t>& edges) const;
+
+private:
+	std::vector<uint32_t> up_offsets; // Compressed sparse rows over node indices like in Graph
+	std::vector<Arc> arcs;
+	size_t shortcuts = 0;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef EDGEWEIGHTS_H
+#define EDGEWEIGHTS_H
+
+#include "Graph.hpp"
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+// Edge weights that can change while routes are being searched, such as for traffic or closed roads
+//
+// Every batch of changes makes a new version of the weights, versions are never changed once published
+// Weights are kept in pages of PAGE_SIZE edges shared between versions, so a batch only copies the pages it changes
+// Readers take a snapshot of the current version without locking or waiting, and see it unchanged until done
+// Replaced versions are freed by the next batch once no snapshot from before the change is left,
+// readers announce the update epoch they started in so that a batch knows which versions may still be read
+
+
+class EdgeWeights {
+public:
+	static constexpr uint32_t PAGE_BITS = 10;
+	static constexpr uint32_t PAGE_SIZE = 1u << PAGE_BITS; // Edges per page
+
+	struct Update {
+		uint32_t edge_id;
+		// Meters, or the meters the edge costs as much as, infinity closes the edge
+		// Never below the stored weight of the edge, which the A* heuristics rely on as a lower bound
+		double weight;
+	};
+
+	// Weights of every edge at one point in time
+	class Version {
+	public:
+		double get(uint32_t edge_id) const { return pages[edge_id >> PAGE_BITS]->weights[edge_id & (PAGE_SIZE - 1)]; }
+
+		// Number of batches applied before this version
+		uint64_t getNumber() const { return number; }
+
+	private:
+		friend class EdgeWeights;
+		struct Page {
+			double weights[PAGE_SIZE];
+		};
+		std::vector<std::shared_ptr<Page>> pages; // Only pages of an unpublished version are written to
+		uint64_t number = 0;
+	};
+
+	// The version current when the snapshot was taken, readable for as long as the snapshot lives
+	// Snapshots may be nested on a thread, and must not be passed to other threads
+	class Snapshot {
+	public:
+		explicit Snapshot(const EdgeWeights& weights);
+		~Snapshot();
+		Snapshot(const Snapshot&) = delete;
+		Snapshot& operator=(const Snapshot&) = delete;
+
+		const Version& operator*() const { return *version; }
+		const Version* operator->() const { return version; }
+
+	private:
+		const Version* version;
+		void* slot; // Reader slot of the thread
+	};
+
+	// Start from the weights of a graph, createAdj must have been called
+	// Reads every edge from the adjacency arrays, or from the compressed adjacency if they have been dropped
+	explicit EdgeWeights(const Graph& graph);
+
+	// No snapshot may be left
+	~EdgeWeights();
+
+	EdgeWeights(const EdgeWeights&) = delete;
+	EdgeWeights& operator=(const EdgeWeights&) = delete;
+
+	// Apply a batch of changes as one version, snapshots taken afterwards see all of them and earlier ones none
+	// Batches from several threads are applied one at a time, readers are never held up by them
+	// Returns false with nothing changed if an edge ID is out of range or a weight is below the stored one, negative or NaN
+	bool apply(const std::vector<Update>& updates);
+
+	size_t getEdgeCount() const { return edge_count; }
+
+	// Replaced versions not freed yet because snapshots from before them may still read them
+	size_t getRetiredCount() const;
+
+private:
+	struct Retired {
+		std::unique_ptr<const Version> version;
+		uint64_t epoch; // Readers that started in this epoch or later can't see the version
+	};
+
+	// Free the retired versions that no reader can see anymore, write_mutex must be held
+	void reclaim();
+
+	size_t edge_count = 0;
+	std::vector<std::shared_ptr<Version::Page>> stored; // Pages of the first version, kept once they are copied
+	std::atomic<const Version*> current;
+	std::vector<Retired> retired;
+	mutable std::mutex write_mutex; // Held by batches, never by readers
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef FLATARRAY_H
+#define FLATARRAY_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+// Array that either owns its elements or points into memory owned by someone else,
+// such as a memory mapped binary file
+//
+// Mapped arrays keep their owner alive through a shared pointer, so a graph mapped from a file
+// stays valid for as long as any of its arrays is in use
+// edit() turns a mapped array into an owned one by copying it
+
+
+template <typename T>
+class FlatArray {
+public:
+	FlatArray() = default;
+
+	// Take ownership of a vector
+	FlatArray(std::vector<T>&& elements) : owned(std::move(elements)) {}
+
+	// View count elements at data, owner keeps the memory alive
+	FlatArray(const T* data, size_t count, std::shared_ptr<const void> owner) :
+		mapped(data), mapped_count(count), owner(std::move(owner)) {}
+
+	const T* data() const { return owner ? mapped : owned.data(); }
+	size_t size() const { return owner ? mapped_count : owned.size(); }
+	bool empty() const { return size() == 0; }
+	const T& operator[](size_t i) const { return data()[i]; }
+	const T* begin() const { return data(); }
+	const T* end() const { return data() + size(); }
+
+	// True if the elements live in memory owned by someone else
+	bool isMapped() const { return owner != nullptr; }
+
+	// Get the elements as a vector for changing them
+	std::vector<T>& edit() {
+		if (owner) {
+			owned.assign(mapped, mapped + mapped_count);
+			owner.reset();
+		}
+		return owned;
+	}
+
+	// Release the elements
+	void clear() {
+		std::vector<T>().swap(owned);
+		owner.reset();
+	}
+
+private:
+	std::vector<T> owned;
+	const T* mapped = nullptr;
+	size_t mapped_count = 0;
+	std::shared_ptr<const void> owner; // Set only for mapped arrays
+};
+
+#endif
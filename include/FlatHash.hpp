@@ -0,0 +1,197 @@
+#ifndef FLATHASH_H
+#define FLATHASH_H
+
+#include "Hash.hpp"
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Open addressing hash map with linear probing
+//
+// Keys and values sit next to each other in one flat array, so a lookup usually reads a single cache line
+// instead of following the node pointers of std::unordered_map, and an entry costs no allocation
+// The capacity is a power of two and the table grows before it is three quarters full
+// Erasing shifts the following entries back, so there are no tombstones and probe sequences stay short
+//
+// Traits give the hash of a key and the key marking an empty slot, which can't be stored:
+//   static uint64_t hash(const Key& key);
+//   static Key emptyKey();
+// Hashes must be well mixed, the home slot of a key is taken from the low bits
+
+
+// Value of a set, takes no space in the slots
+struct FlatHashNoValue {};
+
+template <typename Key, typename Value, typename Traits>
+class FlatHashMap {
+public:
+	struct Slot {
+		Key key;
+		[[no_unique_address]] Value value;
+	};
+
+	// How far entries are from their home slot, in slots
+	struct ProbeStats {
+		size_t size = 0;
+		size_t capacity = 0;
+		double average = 0; // Extra slots read by a lookup that finds its key
+		size_t longest = 0;
+	};
+
+	// Iterates the occupied slots
+	class Iterator {
+	public:
+		Iterator(const Slot* slot, const Slot* end) : slot(slot), end(end) { skipEmpty(); }
+		const Slot& operator*() const { return *slot; }
+		const Slot* operator->() const { return slot; }
+		Iterator& operator++() {
+			++slot;
+			skipEmpty();
+			return *this;
+		}
+		bool operator!=(const Iterator& other) const { return slot != other.slot; }
+
+	private:
+		void skipEmpty() {
+			while (slot != end && isEmpty(slot->key)) ++slot;
+		}
+
+		const Slot* slot;
+		const Slot* end;
+	};
+
+	FlatHashMap() = default;
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	size_t capacity() const { return slots.size(); }
+
+	Iterator begin() const { return Iterator(slots.data(), slots.data() + slots.size()); }
+	Iterator end() const { return Iterator(slots.data() + slots.size(), slots.data() + slots.size()); }
+
+	// Make room for a number of entries without growing
+	void reserve(size_t entries) {
+		size_t needed = 16;
+		while (needed * 3 / 4 < entries) needed *= 2;
+		if (needed > slots.size()) rehash(needed);
+	}
+
+	// Remove every entry and release the memory
+	void clear() {
+		std::vector<Slot>().swap(slots);
+		count = 0;
+	}
+
+	const Value* find(const Key& key) const {
+		if (slots.empty()) return nullptr;
+		for (size_t pos = home(key);; pos = next(pos)) {
+			const Slot& slot = slots[pos];
+			if (slot.key == key) return &slot.value;
+			if (isEmpty(slot.key)) return nullptr;
+		}
+	}
+
+	Value* find(const Key& key) {
+		return const_cast<Value*>(static_cast<const FlatHashMap&>(*this).find(key));
+	}
+
+	bool contains(const Key& key) const { return find(key) != nullptr; }
+
+	// Insert key if it isn't in the map yet, a key already present keeps its value
+	// Returns the value of the key and true if it was inserted, with a single probe sequence either way
+	std::pair<Value*, bool> insert(const Key& key, const Value& value = Value()) {
+		if ((count + 1) * 4 > slots.size() * 3) {
+			rehash(slots.empty() ? 16 : slots.size() * 2);
+		}
+		for (size_t pos = home(key);; pos = next(pos)) {
+			Slot& slot = slots[pos];
+			if (slot.key == key) return { &slot.value, false };
+			if (isEmpty(slot.key)) {
+				slot.key = key;
+				slot.value = value;
+				++count;
+				return { &slot.value, true };
+			}
+		}
+	}
+
+	Value& operator[](const Key& key) {
+		return *insert(key).first;
+	}
+
+	// Returns false if the key wasn't in the map
+	bool erase(const Key& key) {
+		if (slots.empty()) return false;
+		size_t pos = home(key);
+		for (;; pos = next(pos)) {
+			if (slots[pos].key == key) break;
+			if (isEmpty(slots[pos].key)) return false;
+		}
+
+		// Move back every following entry that may take the freed slot without passing its home slot
+		for (size_t hole = pos, at = next(pos);; at = next(at)) {
+			if (isEmpty(slots[at].key)) {
+				slots[hole].key = Traits::emptyKey();
+				break;
+			}
+			size_t at_home = home(slots[at].key);
+			if (((at - at_home) & mask()) >= ((at - hole) & mask())) {
+				slots[hole] = slots[at];
+				hole = at;
+			}
+		}
+		--count;
+		return true;
+	}
+
+	ProbeStats probeStats() const {
+		ProbeStats stats;
+		stats.size = count;
+		stats.capacity = slots.size();
+		size_t total = 0;
+		for (size_t pos = 0; pos < slots.size(); ++pos) {
+			if (isEmpty(slots[pos].key)) continue;
+			size_t distance = (pos - home(slots[pos].key)) & mask();
+			total += distance;
+			stats.longest = std::max(stats.longest, distance);
+		}
+		stats.average = count > 0 ? static_cast<double>(total) / count : 0;
+		return stats;
+	}
+
+private:
+	static bool isEmpty(const Key& key) { return key == Traits::emptyKey(); }
+
+	size_t mask() const { return slots.size() - 1; }
+	size_t home(const Key& key) const { return static_cast<size_t>(Traits::hash(key)) & mask(); }
+	size_t next(size_t pos) const { return (pos + 1) & mask(); }
+
+	void rehash(size_t new_capacity) {
+		std::vector<Slot> old(new_capacity, Slot{ Traits::emptyKey(), Value() });
+		old.swap(slots);
+		for (const Slot& slot : old) {
+			if (isEmpty(slot.key)) continue;
+			size_t pos = home(slot.key);
+			while (!isEmpty(slots[pos].key)) pos = next(pos);
+			slots[pos] = slot;
+		}
+	}
+
+private:
+	std::vector<Slot> slots;
+	size_t count = 0;
+};
+
+template <typename Key, typename Traits>
+using FlatHashSet = FlatHashMap<Key, FlatHashNoValue, Traits>;
+
+// Traits for OSM IDs
+// The smallest int64_t marks empty slots, OSM IDs never reach it
+struct IdTraits {
+	static uint64_t hash(int64_t id) { return Hash::mix(static_cast<uint64_t>(id)); }
+	static int64_t emptyKey() { return INT64_MIN; }
+};
+
+#endif
@@ -1,18 +1,33 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
-#include <unordered_map>
-#include <unordered_set>
 #include <vector>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include "FlatArray.hpp"
+#include "FlatHash.hpp"
+#include <memory>
+#include <atomic>
 
 constexpr double R = 6371000; // Earth radius in meters
 constexpr double PI = 3.14159265358979323846; // Value of PI
+constexpr double COORDINATE_SCALE = 1e7; // Fixed-point units per degree, the precision of OSM data itself
 
+class TileCache;
+class RoutingGraph;
+class CompressedAdjacency;
+class EdgeWeights;
+class ContractionHierarchy;
+class Landmarks;
 
 class Graph {
 public: 
 	// A node stored in graph by its ID
 	// Only holds its earth coordinates parsed from .osm data
+	// The graph stores coordinates in fixed-point, so a node read back is rounded to 1e-7 degrees
 	struct Node {
 		double lat; // Latitude
 		double lon; // Longitude
@@ -20,79 +35,413 @@ public:
 
 	// An edge between two nodes stored in graph
 	// Holds the IDs of the nodes
+	// Edges are identified by their index in the edge array, IDs run from 0 to edge count - 1
 	struct Edge {
 		int64_t from; // Source
 		int64_t to; // Target
 
-		// Equality operator for unordered_set
+		// Equality operator for the edge set
 		bool operator==(const Edge& other) const {
 			return from == other.from && to == other.to;
 		}
 	};
 
-private:
 	// Exact latitude/longitude range which we want to keep nodes from
 	// Aka bounding box
+	// Starts out inverted so that the first expansion sets it
 	struct Bounds {
-		double min_lat;
-		double max_lat;
-		double min_lon;
-		double max_lon ;
+		double min_lat = std::numeric_limits<double>::max();
+		double max_lat = std::numeric_limits<double>::lowest();
+		double min_lon = std::numeric_limits<double>::max();
+		double max_lon = std::numeric_limits<double>::lowest();
 
 		// For filtering nodes during parsing
 		bool contains(double lat, double lon) const {
 			return lat >= min_lat && lat <= max_lat && lon >= min_lon && lon <= max_lon;
 		}
+
+		// Grow to cover other bounds as well
+		void expand(const Bounds& other) {
+			min_lat = std::min(min_lat, other.min_lat);
+			min_lon = std::min(min_lon, other.min_lon);
+			max_lat = std::max(max_lat, other.max_lat);
+			max_lon = std::max(max_lon, other.max_lon);
+		}
 	};
 
-	// Custom hash function for Edge
-	struct EdgeHash {
-		std::size_t operator()(const Edge& edge) const {
-			return std::hash<int64_t>()(edge.from) ^ std::hash<int64_t>()(edge.to);
+	// Hash traits of Edge for the edge set
+	// from and to are mixed in order, so an edge and its reverse land in different slots
+	struct EdgeTraits {
+		static uint64_t hash(const Edge& edge) {
+			return Hash::combine(Hash::mix(static_cast<uint64_t>(edge.from)), static_cast<uint64_t>(edge.to));
 		}
+		static Edge emptyKey() { return { INT64_MIN, INT64_MIN }; }
+	};
+
+	// Coordinates of a node as stored in the graph, in fixed-point units of 1/COORDINATE_SCALE degrees
+	// Every latitude and longitude fits in 32 bits, half the size of a double
+	struct FixedNode {
+		int32_t lat;
+		int32_t lon;
 	};
 
-public:
+	// Neighbor of a node as stored in the adjacency
+	struct Neighbor {
+		uint32_t index; // Neighbor node index, getNodeId gives its OSM ID
+		double weight; // Length of the edge in meters
+		uint32_t edge_id;
+	};
+
+	// Geographic tile of a tiled graph
+	// The nodes of a tile and the edges starting from them are ranges in every array
+	struct Tile {
+		Bounds bounds; // Covers the tile's nodes and both endpoints of its edges
+		uint32_t node_begin, node_end; // Range of node indices
+		uint32_t edge_begin, edge_end; // Range of edge IDs
+	};
+
+	// Arrays of a graph after createAdj
+	// Nodes are sorted by ID and found by binary search, a node's index is its position in node_ids
+	// Adjacency is in compressed sparse row form: the neighbors of the node at index i are
+	// at positions adj_offsets[i] .. adj_offsets[i + 1] - 1 of adj_targets, adj_weights and adj_edges
+	// Targets are node indices, so traversal never looks up OSM IDs
+	// Latitudes and longitudes are separate fixed-point arrays, so bulk loops over them read only what they use
+	// Mapped binary files store exactly these arrays, so they can be used straight from the file
+	//
+	// Hilbert sorted and tiled graphs have their nodes and edges in map order instead,
+	// id_order then holds the node indices sorted by node ID for the binary search
+	struct Arrays {
+		FlatArray<int64_t> node_ids;
+		FlatArray<int32_t> node_lats;
+		FlatArray<int32_t> node_lons;
+		FlatArray<uint32_t> adj_offsets; // Node count + 1 entries
+		FlatArray<uint32_t> adj_targets;
+		FlatArray<double> adj_weights;
+		FlatArray<uint32_t> adj_edges;
+		FlatArray<uint32_t> id_order; // Empty while nodes are sorted by ID
+		FlatArray<Tile> tiles; // In node order, empty unless tiled
+	};
+
+	// Neighbors of one node, iterating gives Neighbor values
+	class Neighbors {
+	public:
+		class Iterator {
+		public:
+			Iterator(const Neighbors& neighbors, size_t pos) : neighbors(neighbors), pos(pos) {}
+			Neighbor operator*() const {
+				return { neighbors.targets[pos], neighbors.weights[pos], neighbors.edge_ids[pos] };
+			}
+			Iterator& operator++() {
+				++pos;
+				return *this;
+			}
+			bool operator!=(const Iterator& other) const {
+				return pos != other.pos;
+			}
+
+		private:
+			const Neighbors& neighbors;
+			size_t pos;
+		};
+
+		Neighbors(const uint32_t* targets, const double* weights, const uint32_t* edge_ids, size_t count) :
+			targets(targets), weights(weights), edge_ids(edge_ids), count(count) {}
+
+		Iterator begin() const { return Iterator(*this, 0); }
+		Iterator end() const { return Iterator(*this, count); }
+		size_t size() const { return count; }
+
+	private:
+		const uint32_t* targets;
+		const double* weights;
+		const uint32_t* edge_ids;
+		size_t count;
+	};
+
+	// Memory taken by one node after createAdj: ID, coordinates and adjacency offset
+	static constexpr size_t NODE_MEMORY = sizeof(int64_t) + sizeof(FixedNode) + sizeof(uint32_t);
+
 	Bounds bbox; // Store the bounding box of the graph calculated in ParseOSM
 
+	// Building the graph
+	// Nodes and edges are added to flat hash tables until createAdj turns them into arrays
+
 	void addNode(int64_t id, Node node);
 
-	bool addEdge(uint32_t id, Edge edge);
+	// Add edge with the next free ID, which is the current edge count
+	// way_id is the OSM way the edge came from, 0 if unknown
+	// Returns false if the edge already exists
+	bool addEdge(Edge edge, int64_t way_id = 0);
 
-	bool hasNode(int64_t id);
+	// Add a batch of edges parsed from a map, way_ids[i] is the way of edges[i]
+	// Edges with an endpoint that isn't a node are skipped, as are duplicates
+	// The tables are sized for the whole batch up front, and every edge is hashed once
+	// Returns the number of edges added
+	size_t addEdges(const std::vector<Edge>& new_edges, const std::vector<int64_t>& way_ids);
 
+	// Move an existing node
+	void updateNode(int64_t id, Node node);
+
+	// Remove nodes and every edge connected to them in one pass over the edges
+	void removeNodes(const std::vector<int64_t>& ids);
+
+	// Remove an edge, the last edge takes over its ID so that IDs stay dense
+	void removeEdge(uint32_t id);
+
+	// Check if an edge has been added, only while building
 	bool hasEdge(int64_t from, int64_t to) const;
 
-	// Create adjacency list for traversal use
+	// Turn the nodes into sorted arrays and create the adjacency for traversal use
+	// Building data is released afterwards
 	void createAdj();
 
-	// Get all edges
-	const std::unordered_map<uint32_t, Edge>& getEdges() const;
+	// Create the adjacency straight from nodes sorted by ID, skipping the building maps
+	// Coordinates are fixed-point, edge_nodes holds the node indices of every edge's endpoints, from and to for each edge in ID order
+	// Used by binary formats that store nodes sorted
+	void createAdj(std::vector<int64_t> node_ids, std::vector<int32_t> node_lats, std::vector<int32_t> node_lons,
+		std::vector<Edge> edges, std::vector<int64_t> edge_ways, const std::vector<uint32_t>& edge_nodes);
+
+	// Go back to building: rebuild the node and edge lookups from the arrays and drop the adjacency
+	// Mapped arrays get copied, the file isn't changed
+	void releaseAdj();
+
+	// Use arrays mapped from a file as they are, the graph is then ready for traversal without createAdj
+	void setArrays(Arrays arrays, FlatArray<Edge> edges, FlatArray<int64_t> edge_ways);
+
+	// Order nodes along a Hilbert curve over bbox, so that nodes close on the map are close in memory, createAdj must have been called
+	// Edges follow the order of their source node and get new IDs in that order, so edges close on the map are close too
+	// Tiled graphs are left as they are
+	void sortByHilbert();
+
+	// True if the nodes are in Hilbert order instead of sorted by ID
+	bool isHilbertSorted() const;
+
+	// Group nodes and edges into the tiles of a grid x grid raster over bbox, createAdj must have been called
+	// Tiles are numbered along a Z curve so that tiles close on the map are close in memory,
+	// within a tile nodes are in Hilbert order
+	// Edges belong to the tile of their source node, and get new IDs in tile order
+	// grid is rounded up to a power of two
+	void partitionTiles(unsigned int grid);
+
+	// True if the nodes and edges are grouped by tile
+	bool isTiled() const;
+
+	// Load tiles on demand through cache when nodes are looked up, nullptr to stop
+	void setTileCache(std::shared_ptr<TileCache> cache);
+
+	// Search routes on a routing graph built from this graph instead of the full adjacency, nullptr to stop
+	// Dropped whenever the adjacency changes
+	void setRoutingGraph(std::shared_ptr<const RoutingGraph> routing);
+
+	// Routing graph set for route searches, nullptr if none
+	const RoutingGraph* getRoutingGraph() const { return routing_graph.get(); }
+
+	// Search routes on a compressed copy of the adjacency instead of the full one, nullptr to stop
+	// A routing graph is searched before either, dropped whenever the adjacency changes
+	void setCompressedAdjacency(std::shared_ptr<const CompressedAdjacency> compressed);
+
+	// Compressed adjacency set for route searches, nullptr if none
+	const CompressedAdjacency* getCompressedAdjacency() const { return compressed_adjacency.get(); }
+
+	// Search routes on a contraction hierarchy built from this graph, nullptr to stop
+	// May be set while routes are searched on other threads if none was set before, searches started afterwards use it
+	// Replaced or dropped only while no routes are searched, and whenever the adjacency changes
+	void setContractionHierarchy(std::shared_ptr<const ContractionHierarchy> hierarchy);
+
+	// Contraction hierarchy set for route searches, nullptr if none
+	const ContractionHierarchy* getContractionHierarchy() const { return contraction_hierarchy.get(); }
+
+	// Landmark distances for the A* heuristic, built from this graph, nullptr to stop
+	// Used by searches on the full, compressed or routing graph
+	// May be set while routes are searched on other threads if none was set before, searches started afterwards use it
+	// Replaced or dropped only while no routes are searched, and whenever the adjacency changes
+	void setLandmarks(std::shared_ptr<const Landmarks> landmarks);
+
+	// Landmarks set for route searches, nullptr if none
+	const Landmarks* getLandmarks() const { return landmarks.get(); }
+
+	// Search routes with weights that can change during searches instead of the stored ones, nullptr to stop
+	// Routes are then searched node by node, as the hierarchy, routing graph and compressed adjacency have the stored weights built in
+	// Set before routes are searched from other threads, dropped whenever the adjacency changes
+	void setEdgeWeights(std::shared_ptr<EdgeWeights> weights);
 
-	// Get all nodes
-	const std::unordered_map<int64_t, Node>& getNodes() const;
+	// Changing edge weights set for route searches, nullptr if none
+	// Batches can be applied through it from any thread while routes are searched, and only raise weights above the stored ones
+	EdgeWeights* getEdgeWeights() const { return edge_weights.get(); }
+
+	// Fingerprint of the nodes, edges and weights in their current order, createAdj must have been called
+	// Stored with data derived from the graph, such as a contraction hierarchy, to tell if it still fits
+	uint64_t adjacencyFingerprint() const;
+
+	// Free adj_offsets, adj_targets, adj_weights and adj_edges once routes are searched on a compressed adjacency
+	// Nothing that reads them, such as getNeighborsAt, mapped binary saving or another layout, may be used afterwards
+	// until releaseAdj and createAdj
+	void dropAdjArrays();
+
+	// Label every node with its connected component, createAdj must have been called
+	// Components are numbered by size from the largest down, so the largest is component 0
+	// Reads every node, so tiled graphs loaded on demand are better left unlabeled
+	// Dropped whenever the adjacency changes
+	void labelComponents();
+
+	// True if labelComponents has been called since the adjacency last changed
+	bool hasComponents() const { return !components.empty(); }
+
+	// Component of the node at an index, labelComponents must have been called
+	uint32_t getComponent(uint32_t index) const { return components[index]; }
+
+	// Number of components, 0 if not labeled
+	size_t getComponentCount() const { return component_sizes.size(); }
+
+	// Number of nodes in a component
+	size_t getComponentSize(uint32_t component) const { return component_sizes[component]; }
+
+	// False if two nodes are in different components, so that no route can join them
+	// True for nodes of the same component, and for any nodes before labeling
+	bool connected(uint32_t a, uint32_t b) const {
+		return components.empty() || components[a] == components[b];
+	}
+
+	// Load the tiles overlapping an area, such as the part of the map in view
+	// Does nothing without a tile cache
+	void loadTiles(const Bounds& area) const;
+
+	// Reading the graph
+	// Node lookups work both while building and after createAdj
+
+	bool hasNode(int64_t id) const;
+
+	// Number of nodes
+	size_t getNodeCount() const;
 
 	// Get node by id
-	const Node& getNode(int64_t id) const;
+	Node getNode(int64_t id) const;
+
+	// Get all edges, indexed by edge ID
+	const FlatArray<Edge>& getEdges() const;
+
+	// Get the way ID of every edge, indexed by edge ID
+	const FlatArray<int64_t>& getEdgeWays() const;
 
 	// Get edge by id
 	const Edge& getEdge(uint32_t id) const;
 
-	// Get neighbors of a node by id
-	const std::vector<std::tuple<int64_t, double, uint32_t>>& getNeighbors(int64_t id) const;
+	// Get the arrays created by createAdj
+	const Arrays& getArrays() const;
+
+	// Get neighbors of a node by id, empty before createAdj
+	Neighbors getNeighbors(int64_t id) const;
+
+	// Reading the graph by node index, after createAdj
+	// Indices run from 0 to node count - 1, and are what traversal works with
+
+	// Index of a node in the arrays, NOT_FOUND if there is no such node
+	static constexpr size_t NOT_FOUND = SIZE_MAX;
+	size_t findIndex(int64_t id) const;
+
+	int64_t getNodeId(uint32_t index) const { return arrays.node_ids[index]; }
+
+	Node getNodeAt(uint32_t index) const {
+		useNode(index);
+		return { toDegrees(arrays.node_lats[index]), toDegrees(arrays.node_lons[index]) };
+	}
+
+	Neighbors getNeighborsAt(uint32_t index) const {
+		useNode(index);
+		uint32_t begin = arrays.adj_offsets[index];
+		uint32_t end = arrays.adj_offsets[index + 1];
+		return Neighbors(arrays.adj_targets.data() + begin, arrays.adj_weights.data() + begin,
+			arrays.adj_edges.data() + begin, end - begin);
+	}
+
+	// Batch reading by node index
+	// Loops run over the contiguous coordinate arrays without going through Node, so the compiler can vectorize them
+
+	// Distances in meters between pairs of nodes, out[i] is between pairs[2 * i] and pairs[2 * i + 1]
+	// Pairs are split into batches over threads (0 for all cores) and run through the Haversine kernel,
+	// so results may differ from getHaversineDistance by up to Haversine::TOLERANCE
+	void getHaversineDistances(const uint32_t* pairs, size_t count, double* out, unsigned threads = 0) const;
+
+	// Distances in meters from nodes to one point, such as the A* heuristics towards the target
+	void getHaversineDistances(const uint32_t* indices, size_t count, const Node& target, double* out) const;
 
 	// Calculate the distance between two nodes using Haversine formula
-	double getHaversineDistance(const Node& from, const Node& to);
+	double getHaversineDistance(const Node& from, const Node& to) const;
+
+	// Conversion between degrees and the fixed-point values the graph stores
+	static int32_t toFixed(double degrees) { return static_cast<int32_t>(std::lround(degrees * COORDINATE_SCALE)); }
+	static double toDegrees(int32_t fixed) { return fixed / COORDINATE_SCALE; }
 
 private:
 	// Helper function to convert degrees to radians
-	double toRadians(double degrees);
+	double toRadians(double degrees) const;
+
+	// Fill the adjacency arrays from node_ids, the coordinates, edges and the endpoint indices of the edges
+	void buildAdjacency(const std::vector<uint32_t>& edge_nodes);
+
+	// Cell of every node in a size x size grid over bbox, x and y of each node in turn
+	std::vector<uint32_t> gridCells(unsigned int size) const;
+
+	// Move the nodes into a new order given as their current indices, edges are sorted by their source node's new index
+	// Rebuilds the adjacency and id_order, returns the endpoint indices of the edges in their new order
+	std::vector<uint32_t> applyOrder(const std::vector<uint32_t>& node_order);
+
+	// Forget the routing graph, compressed adjacency, contraction hierarchy, landmarks, edge weights and component labels,
+	// which are only valid for the current adjacency
+	void dropRoutingData();
+
+	// Tell the tile cache that a node is being used
+	void useNode(size_t index) const {
+		if (tile_cache) loadNodeTile(index);
+	}
+	void loadNodeTile(size_t index) const;
 
 private:
-	std::unordered_map<int64_t, Node> nodes; // ID to node
-	std::unordered_map<uint32_t, Edge> edges; // ID to edge
-	std::unordered_set<Edge, EdgeHash> edge_set; // For fast edge lookup
-	std::unordered_map<int64_t, std::vector<std::tuple<int64_t, double, uint32_t>>> adj_list; // <neighbor_id, weight, edge_id>
+	// Shared pointer that routing threads may read while the loading thread sets it
+	// The object stays alive until the pointer is set again or reset, which must not happen during searches
+	template <typename T>
+	class Published {
+	public:
+		Published() = default;
+		Published(Published&& other) noexcept : owner(std::move(other.owner)), current(owner.get()) { other.current = nullptr; }
+		Published& operator=(Published&& other) noexcept {
+			owner = std::move(other.owner);
+			current = owner.get();
+			other.current = nullptr;
+			return *this;
+		}
+
+		void set(std::shared_ptr<T> object) {
+			owner = std::move(object);
+			current.store(owner.get(), std::memory_order_release);
+		}
+		void reset() { set(nullptr); }
+		T* get() const { return current.load(std::memory_order_acquire); }
+
+	private:
+		std::shared_ptr<T> owner;
+		std::atomic<T*> current{ nullptr };
+	};
+
+	// Building data
+	FlatHashMap<int64_t, FixedNode, IdTraits> nodes; // ID to node
+	FlatHashSet<Edge, EdgeTraits> edge_set; // For fast edge lookup
+
+	FlatArray<Edge> edges; // ID to edge, IDs are dense
+	FlatArray<int64_t> edge_ways; // ID to the way the edge came from
+
+	// Created by createAdj or mapped from a file
+	Arrays arrays;
+	bool adj_created = false;
+
+	std::shared_ptr<TileCache> tile_cache; // Set for tiled graphs loaded on demand
+	std::shared_ptr<const RoutingGraph> routing_graph; // Set if routes are searched on collapsed chains
+	std::shared_ptr<const CompressedAdjacency> compressed_adjacency; // Set if routes are searched on packed neighbors
+	std::shared_ptr<EdgeWeights> edge_weights; // Set if routes are searched with changing weights
+	Published<const ContractionHierarchy> contraction_hierarchy; // Set if routes are searched up a hierarchy
+	Published<const Landmarks> landmarks; // Set if A* bounds distances with landmarks
+	std::vector<uint32_t> components; // Node index to component, empty unless labeled
+	std::vector<uint32_t> component_sizes; // Nodes per component, largest first
 };
 
 #endif
\ No newline at end of file
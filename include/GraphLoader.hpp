@@ -2,6 +2,11 @@
 #define GRAPHLOADER_H
 
 #include "Graph.hpp"
+#include "ParseOSM.hpp"
+#include "Binary.hpp"
+#include "Quadtree.hpp"
+#include "LoadProgress.hpp"
+#include "Landmarks.hpp"
 #include <string>
 #include <filesystem>
 
@@ -24,6 +29,8 @@ const std::filesystem::path RESOURCE_PATH = std::filesystem::path(CMAKE_SOURCE_D
 // (std::filesystem::path(RESOURCE_PATH) / "helsinki4.osm").string()
 // };
 // 
+// The .bin file remembers which .osm files and settings it was built from,
+// so it gets rebuilt automatically when you change them
 // Remember to also change the bin_file variable to save your map into a new .bin file!!!
 // 
 // The resources folder comes with two pre-loaded .bin files: tampere.bin and helsinki.bin
@@ -39,6 +46,7 @@ const std::filesystem::path RESOURCE_PATH = std::filesystem::path(CMAKE_SOURCE_D
 ///////////////////////////////
 
 // List of OSM files to load (absolute paths)
+// OpenStreetMap PBF extracts (.osm.pbf) can be listed as they are, without converting them to .osm
 const std::vector<std::string> osm_files = {
 };
 
@@ -49,9 +57,146 @@ const std::vector<std::string> osm_files = {
 // Binary file to save/load (absolute path)
 const std::string bin_file = (std::filesystem::path(RESOURCE_PATH) / "tampere.bin").string();
 
+/////////////////////////////
+// CHOOSE YOUR PARSE MODE  //
+/////////////////////////////
+
+// ParseMode::DOM reads the whole .osm file into memory, fine for city-sized maps
+// ParseMode::Streaming reads the file in chunks, so parsing memory stays the same regardless of file size
+// Use this for large regional extracts!!!
+// ParseMode::Parallel streams chunks of every file on all cores, use this for country-sized extracts
+constexpr ParseMode parse_mode = ParseMode::DOM;
+
+// Only keep nodes that are used by a routable way
+// Building corners, POIs and landuse vertices are never drawn or routed through,
+// so dropping them makes both the graph and the .bin file smaller
+// Set to false to keep every node inside the bounds
+// Also set to false if you update the map with .osc change files (MapViewer --apply),
+// since changed ways may use nodes that were pruned and aren't part of the change file
+constexpr bool prune_nodes = true;
+
+////////////////////////////////
+// CHOOSE YOUR BINARY FORMAT  //
+////////////////////////////////
+
+// BinaryFormat::Standard is the default format, the graph is decoded and its adjacency list created on every start
+// BinaryFormat::Compact is about a quarter of the size and decodes faster,
+// use this when the .bin file is read from a slow disk or network drive
+// BinaryFormat::Mapped is about twice the size but is memory mapped and used as it is,
+// so the map opens almost instantly and the OS only loads the parts that are used
+// It also stores the adjacency list with edge lengths and the quadtree used for drawing, so nothing is rebuilt on start
+// Use this for large maps!!!
+// BinaryFormat::Tiled is a mapped file with the map cut into tiles, which are loaded when they come into view
+// or a route search reaches them and dropped again when memory runs over tile_memory_budget
+// Use this for maps larger than your memory, such as whole countries!!!
+// An existing .bin file is converted to the chosen format on the next start
+constexpr BinaryFormat binary_format = BinaryFormat::Standard;
+
+// Hash the whole of a mapped or tiled file on every start to catch files damaged on disk
+// This reads every page of the file, so start up takes as long as reading it, off by default
+// The header, sizes and offsets are always checked, standard and compact files are always hashed as they are read anyway
+constexpr bool verify_mapped = false;
+
+// Tiled format only: the map is cut into tile_grid x tile_grid tiles (rounded up to a power of two),
+// empty tiles take no space
+// Memory is loaded and released in pages, so a tile should take at least a few hundred kB of the .bin file
+// Lower this for smaller maps!!!
+// Changing tile_grid takes effect when the .bin file is next rebuilt or converted
+constexpr unsigned int tile_grid = 64;
+
+// Tiled format only: memory kept for loaded tiles, in bytes
+constexpr size_t tile_memory_budget = size_t(256) * 1024 * 1024;
+
+// Keep nodes and edges in the order of a Hilbert curve over the map instead of by OSM ID
+// Nodes and edges close on the map are then close in memory, which makes routing and drawing read fewer cache lines
+// Mapped files store the order, other formats are sorted again on every start, tiled files use their own order
+constexpr bool hilbert_order = true;
+
+/////////////////////////
+// CHOOSE YOUR ROUTING //
+/////////////////////////
+
+// Search routes on a copy of the graph with every chain of degree-2 nodes collapsed into one edge
+// Roads are mostly such chains, so searches go through far fewer nodes and finish faster,
+// the path and distance found are the same
+// Builds on every start in a fraction of the adjacency time and takes some memory, tiled maps are searched as they are
+constexpr bool contract_chains = true;
+
+// Label the connected components of the graph, so that a route between two of them is known not to exist
+// without searching, and clicks on the map snap to the largest component
+// Takes about as long as one route search over the whole graph, tiled maps are left unlabeled
+constexpr bool label_components = true;
+
+// Search routes on a packed copy of the adjacency list and free the full one once the map is saved, for maps too large
+// to fit in memory otherwise
+// Neighbors take about 10 bytes per edge instead of 36 and routes about a tenth longer to find,
+// edge lengths are rounded up to decimeters so distances come out slightly longer
+// The routing graph is not built then, and tiled maps are searched as they are
+constexpr bool compress_adjacency = false;
+
+// Search routes on a contraction hierarchy, which only looks at a few hundred nodes even on routes across the map
+// The path and distance found are the same as without it
+// Built once, which takes a while for large maps, and saved next to bin_file, it is built again when the map changes
+// Built after the map is shown, routes are searched on the routing graph until it is ready
+// Not built with compress_adjacency or for tiled maps
+constexpr bool contraction_hierarchy = true;
+
+// Contraction hierarchy file (absolute path)
+const std::string hierarchy_file = std::filesystem::path(bin_file).replace_extension(".ch").string();
+
+// Bound the A* heuristic with the distances to this many landmarks, 0 for the straight line distance only
+// Landmark bounds follow the roads around water and other detours, so A* goes through far fewer nodes,
+// at 4 bytes per node and landmark
+// Only used without contraction_hierarchy, tiled maps are searched as they are
+// Tables are computed once in parallel and saved next to bin_file, they are computed again when the map or these change
+// Computed after the map is shown, routes are searched with the straight line distance until they are ready
+constexpr unsigned int landmark_count = 16;
+
+// LandmarkStrategy::Avoid places landmarks where the ones before bound routes worst, which gives the best bounds
+// LandmarkStrategy::Farthest spreads them out in a straight line, which is faster to compute on large maps
+constexpr LandmarkStrategy landmark_strategy = LandmarkStrategy::Avoid;
+
+// Landmark file (absolute path)
+const std::string landmark_file = std::filesystem::path(bin_file).replace_extension(".alt").string();
+
 class GraphLoader {
 public:
-	static bool loadGraph(Graph& graph);
+	// Load the graph from bin_file, or build it from osm_files if the binary is missing or out of date
+	// quadtree gets built from the graph, or loaded from mapped binary files
+	// Tiled files get a tile cache, graph must then stay where it is for as long as it is used
+	// progress, if given, is updated as the stages finish so that the window can show the map while it loads
+	// Returns true if the graph came from the binary file
+	static bool loadGraph(Graph& graph, Quadtree& quadtree, LoadProgress* progress = nullptr);
+
+	// Apply OsmChange (.osc) files to the map in bin_file and save it again
+	// Run with: MapViewer --apply <file.osc>...
+	// Returns false if there is no binary file to update
+	static bool applyChanges(const std::vector<std::string>& osc_files);
+
+private:
+	// Load or build the graph and quadtree, loadGraph marks progress done afterwards
+	static bool loadOrBuild(Graph& graph, Quadtree& quadtree, LoadProgress* progress);
+
+	// Build the quadtree, sharing the projected edges through progress while building
+	static void buildQuadtree(const Graph& graph, Quadtree& quadtree, LoadProgress* progress);
+
+	// Label components, and build the routing graph or the compressed adjacency,
+	// as label_components, contract_chains and compress_adjacency are set
+	// createAdj must have been called
+	static void prepareRouting(Graph& graph);
+
+	// Load the contraction hierarchy or the landmarks from their files, or build and save them,
+	// as contraction_hierarchy and landmark_count are set
+	// Slow to build, so they are left until the map is shown, routes can be searched meanwhile and use them once they are set
+	static void prepareRoutingFiles(Graph& graph);
+
+	// Fingerprint of the settings that change the built graph, stored in the binary file
+	static uint64_t configFingerprint();
+
+	// Tile or Hilbert sort the graph, or go back to ID order, to match binary_format and hilbert_order
+	// createAdj must have been called
+	// Returns true if the graph was changed, its quadtree must then be built again
+	static bool matchLayout(Graph& graph);
 };
 
 #endif
\ No newline at end of file
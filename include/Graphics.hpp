@@ -3,11 +3,10 @@
 
 #include "Quadtree.hpp"
 #include "Graph.hpp"
+#include "LoadProgress.hpp"
 #include <SFML/Graphics.hpp>
-#include <unordered_map>
 #include <vector>
 #include <memory>
-#include <mutex>
 
 constexpr int64_t UNASSIGNED = -1; // Sentinel value for unassigned node ID
 
@@ -22,10 +21,24 @@ constexpr float PATH_THICKNESS = 3.0f;
 // Click radius for node selection
 constexpr float CLICK_RADIUS = 2.5f;
 
+// Select nodes of the largest connected component when it is within the click radius,
+// instead of stray fragments such as footways that no road leads to
+constexpr bool SNAP_TO_LARGEST_COMPONENT = true;
+
 class Graphics {
 public:
+	// An edge as drawn on the window
+	struct ScreenEdge {
+		uint32_t id; // Edge id
+		sf::Vector2f v1, v2; // Edge endpoints
+		sf::Color color; // Color depending on if in path
+		float thickness; // Thickess of edge (found path appears thicker)
+	};
+
 	// Constructor
-	Graphics(Graph& graph, float window_width, float window_height);
+	// The graph and quadtree may still be loading, they are only read once progress says they are ready
+	// Until then the edges projected so far are drawn
+	Graphics(Graph& graph, const Quadtree& quadtree, const LoadProgress& progress, float window_width, float window_height);
 
 	// Render map, aka display graph edges
 	void render(sf::RenderWindow& window, const sf::View& view);
@@ -42,45 +55,53 @@ public:
 	void findRoute();
 
 private:
-	// Generate graph edges and insert to quadtree
-	void generateEdges();
+	// Create the screen edge of an edge by scaling its projection to the window
+	// Edges are only created for the part of the map in view, so large maps don't need them all in memory
+	ScreenEdge makeEdge(uint32_t id, const Quadtree::Segment& segment) const;
+
+	// Check if an edge is on the found path
+	bool onPath(uint32_t id) const;
+
+	// Get the edges in view from the edges projected so far, while the quadtree is still being built
+	std::vector<ScreenEdge> previewEdges(const Quadtree::Bounds& window_bounds) const;
 
 	// Initialize window elements:
 	// Selection circles and text box
 	void initWindowElements();
 
-	// Transform given coordinates of latitude and longitude to graphics coordinates
-	sf::Vector2f transformToSFML(double lat, double lon);
-
-	// Change edge color and set thickness by ID
-	void changeEdgeColor(uint32_t id, sf::Color new_color, float new_thickness);
+	// Transform the coordinates of a node to graphics coordinates
+	// Projected the same way as the edges, so the node sits exactly on their ends
+	sf::Vector2f transformToSFML(int64_t id);
 
 	// Get the view bounds for current view as Bounds-struct
 	Quadtree::Bounds getViewBounds(const sf::View& view);
 
+	// Convert bounds given in window coordinates to map space
+	Quadtree::Bounds toMapBounds(const Quadtree::Bounds& window_bounds) const;
+
+	// Query the quadtree with bounds given in window coordinates
+	std::vector<ScreenEdge> queryEdges(const Quadtree::Bounds& window_bounds);
+
 	// Get the node closest to the given world position
 	// Returns a pointer to the closest node and modifies reference id, nullptr if not found
-	// Takes a vector of TreeEdge-pointers to search from
-	sf::Vector2f* getClosestNode(const sf::Vector2f& world_pos, const std::vector<Quadtree::TreeEdge*>& edges, int64_t& selected_id);
+	// Takes a vector of ScreenEdges to search from
+	const sf::Vector2f* getClosestNode(const sf::Vector2f& world_pos, const std::vector<ScreenEdge>& edges, int64_t& selected_id);
+
+	// Keep only the edges of the largest component, if there are any among the edges and the graph is labeled
+	void keepLargestComponent(std::vector<ScreenEdge>& edges) const;
 
 	// Calculate the Euclidean distance between two points
 	float distance(const sf::Vector2f& p1, const sf::Vector2f& p2);
 
-	// Highlight the edges of a path given as a vector
-	void highlightPath(const std::vector<uint32_t>& path, sf::Color new_color, float new_thickness);
-
 	// Form thick lines to represent graph edges by rendering each edge as two triangles that form a rectangle
 	// Takes the edges to render as the parameter
 	// Also takes the vertex arrays to render as references, triangles get added to either depending on if the edge is in current found path
-	void renderEdges(std::vector<Quadtree::TreeEdge*> new_visible_edges, sf::VertexArray& rendered_edges, sf::VertexArray& rendered_path);
+	void renderEdges(const std::vector<ScreenEdge>& new_visible_edges, sf::VertexArray& rendered_edges, sf::VertexArray& rendered_path);
 
 private:
 	Graph& graph;
-	std::unique_ptr<Quadtree> quadtree;
-
-	// Store all the graph edges as TreeEdge-structs that get used in Quadtree
-	// Access by ID
-	std::unordered_map<uint32_t, std::unique_ptr<Quadtree::TreeEdge>> graph_edges;
+	const Quadtree& quadtree;
+	const LoadProgress& progress;
 
 	// Keep track of current window resolution
 	float window_width;
@@ -95,10 +116,7 @@ private:
 	int64_t target_id;
 
 	std::vector<uint32_t> found_path; // Track the found path
-	std::unordered_set<uint32_t> found_path_lookup; // For fast lookup
-
-	// Mutex for thread safety
-	std::mutex graphics_mutex;
+	std::vector<bool> found_path_lookup; // For fast lookup, indexed by edge ID
 };
 
 #endif
\ No newline at end of file
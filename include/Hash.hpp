@@ -0,0 +1,48 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Fast non-cryptographic hashing for checksums and fingerprints
+// Good at catching accidental changes and corruption, not meant to resist deliberate collisions
+
+
+class Hash {
+public:
+	// Finalizer of MurmurHash3, every input bit affects every output bit
+	static constexpr uint64_t mix(uint64_t x) {
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdULL;
+		x ^= x >> 33;
+		x *= 0xc4ceb9fe1a85ec53ULL;
+		x ^= x >> 33;
+		return x;
+	}
+
+	// Fold a value into a running hash, order matters
+	static constexpr uint64_t combine(uint64_t seed, uint64_t value) {
+		return mix(seed ^ (value + 0x9E3779B97F4A7C15ULL + (seed << 6) + (seed >> 2)));
+	}
+
+	// Hash a byte buffer 8 bytes at a time
+	static uint64_t bytes(const void* data, size_t size, uint64_t seed = 0) {
+		const char* pos = static_cast<const char*>(data);
+		uint64_t h = seed ^ (size * 0x9E3779B97F4A7C15ULL);
+		for (; size >= 8; pos += 8, size -= 8) {
+			uint64_t word;
+			std::memcpy(&word, pos, 8);
+			h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+			h ^= h >> 29;
+		}
+		if (size > 0) {
+			uint64_t word = 0;
+			std::memcpy(&word, pos, size);
+			h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+		}
+		return mix(h);
+	}
+};
+
+#endif
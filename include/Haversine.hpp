@@ -0,0 +1,32 @@
+#ifndef HAVERSINE_H
+#define HAVERSINE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Haversine distances of many point pairs at once, for the edge weights of a graph
+//
+// Works on arrays of fixed-point coordinates as the graph stores them
+// Sine, cosine and arcsine are evaluated with polynomials instead of the math library,
+// so four pairs are done at a time with AVX2 on CPUs that have it and one at a time otherwise
+// Both paths are within 1e-12 of the exact formula relative to the distance, and within TOLERANCE of Graph::getHaversineDistance
+
+
+class Haversine {
+public:
+	// Largest difference to Graph::getHaversineDistance in meters
+	// Nearly all of it is rounding in getHaversineDistance, which subtracts the coordinates after converting them
+	// to radians and loses digits on short edges, the kernel subtracts the exact fixed-point values
+	static constexpr double TOLERANCE = 1e-4;
+
+	// Distances in meters, out[i] is from (lat1[i], lon1[i]) to (lat2[i], lon2[i])
+	// Coordinates are fixed-point in units of 1/COORDINATE_SCALE degrees
+	// use_simd false forces the portable path, for comparing the two
+	static void distances(const int32_t* lat1, const int32_t* lon1, const int32_t* lat2, const int32_t* lon2,
+		size_t count, double* out, bool use_simd = true);
+
+	// True if this CPU runs the AVX2 path
+	static bool hasSimd();
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include "Graph.hpp"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Landmarks for the ALT heuristic of A*: the distances from a few nodes to every node give lower bounds on
+// the distance between any two nodes by the triangle inequality, d(v, t) >= |d(L, t) - d(L, v)| for every landmark L
+// Bounds are tightest for routes heading away from or towards a landmark, so landmarks are picked at the edges of the map
+// Unlike the straight line distance they follow the roads around water and other detours
+//
+// Landmark file format, next to the binary file of the graph:
+//
+// [magic: char[4] = "MVLM"] [version: uint32_t] LANDMARKS_VERSION
+// [graph_hash: uint64_t] Graph::adjacencyFingerprint of the graph the landmarks were picked for
+// [num_nodes: uint64_t] [asked: uint32_t] [strategy: uint32_t] [count: uint32_t]
+// A graph with fewer nodes than asked for gets fewer landmarks
+// [data_hash: uint64_t] Hash::bytes of the arrays below
+// [landmarks: uint32_t] * count, node indices
+// [distances: float] * num_nodes * count, the distances from every landmark to node 0, then to node 1...
+// Integers and floats are stored in the byte order of the machine that wrote the file
+
+constexpr char LANDMARKS_MAGIC[4] = { 'M', 'V', 'L', 'M' };
+constexpr uint32_t LANDMARKS_VERSION = 1; // Increase whenever the layout or the way landmarks are picked changes
+
+enum class LandmarkStrategy {
+	Farthest, // Each landmark as far in a straight line from the ones before as possible, then every table at once
+	Avoid // Each landmark where the bounds of the ones before are weakest, the tables are computed along the way
+};
+
+
+class Landmarks {
+public:
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	// Landmarks usable for a search towards one target and their distances to it
+	// Landmarks that can't reach the target bound nothing and are left out
+	struct Target {
+		std::vector<uint32_t> landmarks;
+		std::vector<float> distances;
+	};
+
+	Landmarks() = default;
+
+	// Pick count landmarks with strategy and compute their distance tables, createAdj must have been called
+	// Landmarks are picked in the largest component if the graph's components are labeled
+	// Reads every node, so tiled graphs loaded on demand are better searched without
+	void build(const Graph& graph, unsigned int count, LandmarkStrategy strategy);
+
+	// Write the landmarks to a file, picked for graph
+	// Returns false if the file can't be written
+	bool save(const std::string& file_path, const Graph& graph) const;
+
+	// Read landmarks written for graph with the same count and strategy
+	// Returns false if the file is missing, damaged, of another version, or written for another graph or setting
+	bool load(const std::string& file_path, const Graph& graph, unsigned int count, LandmarkStrategy strategy);
+
+	size_t getCount() const { return landmarks.size(); }
+	uint32_t getLandmark(size_t i) const { return landmarks[i]; }
+	LandmarkStrategy getStrategy() const { return strategy; }
+
+	// Memory taken by the distance tables in bytes
+	size_t memoryBytes() const;
+
+	// Take the distances from the landmarks to the target of a search
+	void aim(uint32_t target, Target& out) const;
+
+	// Raise bounds[i], a lower bound on the distance from indices[i] to the target, to the landmark bound if that is higher
+	void raiseBounds(const uint32_t* indices, size_t count, const Target& target, double* bounds) const;
+
+private:
+	// Shortest distances from a node to every node, infinity where it can't reach
+	// parents and order, if given, get the node each one is reached from (NONE for the start and unreached nodes)
+	// and the reached nodes in the order they were settled
+	static void distancesFrom(const Graph& graph, uint32_t start, std::vector<float>& out,
+		std::vector<uint32_t>* parents = nullptr, std::vector<uint32_t>* order = nullptr);
+
+	// Pick the landmarks of a strategy from the nodes in candidates, and compute a table of distances for each
+	void pickFarthest(const Graph& graph, unsigned int count, const std::vector<uint32_t>& candidates,
+		std::vector<std::vector<float>>& tables);
+	void pickAvoid(const Graph& graph, unsigned int count, const std::vector<uint32_t>& candidates,
+		std::vector<std::vector<float>>& tables);
+
+	std::vector<uint32_t> landmarks; // Node indices
+	std::vector<float> distances; // Node major, the count distances of node 0, then of node 1...
+	LandmarkStrategy strategy = LandmarkStrategy::Avoid;
+	unsigned int asked = 0; // Landmarks asked for, more than were picked if there are too few nodes
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef LOADPROGRESS_H
+#define LOADPROGRESS_H
+
+#include "Quadtree.hpp"
+#include <atomic>
+#include <chrono>
+
+// Progress of a map loading in the background, shared between the loading thread and the window
+//
+// Loading goes through decoding, creating the adjacency, projecting the edges and building the quadtree
+// Each flag is set once its data is complete, and nothing may be read before it is set:
+// the window draws the projected edges while the quadtree is built, and routes once the graph is ready
+
+struct LoadProgress {
+	std::atomic<bool> graph_ready{ false }; // Adjacency created, the graph can be read and routed on
+	std::atomic<bool> quadtree_ready{ false }; // Quadtree complete, edges can be queried and selected
+	std::atomic<bool> done{ false }; // Loading has finished, also set if it failed
+	Quadtree::Progress projection; // Edges projected before the quadtree is ready
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Milliseconds since loading started
+	double elapsedMs() const {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file
+//
+// Pages are loaded by the OS on first access and shared through the page cache,
+// so several processes mapping the same file use one copy of it
+
+
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Map the file, returns false if it can't be opened or mapped
+	bool open(const std::string& file_path);
+
+	const char* data() const { return begin; }
+	size_t size() const { return length; }
+
+	// Ask the OS to read a range of a mapping ahead of its use
+	static void prefetch(const void* data, size_t size);
+
+	// Let the OS drop the pages of a range of a mapping from memory, they are read from the file again when used
+	// Only whole pages inside the range are dropped, so neighboring data stays loaded
+	static void evict(const void* data, size_t size);
+
+private:
+	const char* begin = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#endif
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+
+
+class Parallel {
+public:
+	// Number of worker threads to use by default, at least one
+	static unsigned threadCount() {
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Call task(i) for every i in [0, count) on a pool of worker threads
+	// Workers pull the next index as they finish, so uneven tasks balance out
+	// The first exception thrown by a task is rethrown after all workers have finished
+	template <typename Task>
+	static void forEach(size_t count, Task task, unsigned threads = 0) {
+		if (threads == 0) threads = threadCount();
+		threads = static_cast<unsigned>(std::min<size_t>(threads, count));
+
+		// Nothing to gain from spawning threads
+		if (threads <= 1) {
+			for (size_t i = 0; i < count; ++i) task(i);
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		std::exception_ptr error;
+		std::mutex error_mutex;
+
+		auto worker = [&]() {
+			for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+				try {
+					task(i);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock(error_mutex);
+					if (!error) error = std::current_exception();
+				}
+			}
+		};
+
+		std::vector<std::thread> pool;
+		pool.reserve(threads - 1);
+		for (unsigned t = 1; t < threads; ++t) {
+			pool.emplace_back(worker);
+		}
+		worker(); // Calling thread works too
+		for (auto& thread : pool) {
+			thread.join();
+		}
+
+		if (error) std::rethrow_exception(error);
+	}
+};
+
+#endif
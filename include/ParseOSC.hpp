@@ -0,0 +1,42 @@
+#ifndef PARSEOSC_H
+#define PARSEOSC_H
+
+#include "Graph.hpp"
+#include <string>
+
+// OpenStreetMap change file format (.osc):
+//
+// <osmChange>
+//   <create> nodes, ways and relations as in .osm files </create>
+//   <modify> new versions of existing elements </modify>
+//   <delete> elements by ID </delete>
+// </osmChange>
+//
+// Blocks may repeat in any order, the last version of an element in the file wins
+// Relations are ignored since the graph doesn't use them
+
+
+class ParseOSC {
+public:
+	// Counts of what applying a change file did to the graph
+	struct Stats {
+		size_t nodes_updated = 0; // Existing nodes moved
+		size_t nodes_added = 0; // New nodes used by new or changed ways
+		size_t nodes_removed = 0;
+		size_t ways_changed = 0; // Created, modified or deleted ways
+		size_t edges_added = 0;
+		size_t edges_removed = 0;
+	};
+
+	// Apply the changes of an .osc file to a loaded graph
+	// The graph must be in the building state, call releaseAdj first and createAdj afterwards
+	// Edges are matched to ways by the way IDs stored with them, so the graph must come from a file that has them
+	// New nodes are only added when a way uses them, like when ingesting with node pruning,
+	// and nodes outside graph.bbox are ignored
+	// Segments using a node that isn't in the graph or the change file are skipped,
+	// so graphs ingested with node pruning can miss edges of changed ways
+	// Returns false if the file can't be read or parsed
+	static bool applyChange(const std::string& file_path, Graph& graph, Stats& stats);
+};
+
+#endif
@@ -3,29 +3,118 @@
 
 #include "Graph.hpp"
 #include <string>
-#include <atomic>
+#include <string_view>
+#include <vector>
+#include <fstream>
+
+// Forward declare rapidxml node used by the element handlers
+namespace rapidxml {
+    template<class Ch> class xml_node;
+}
+
+// How an .osm file gets read into the graph
+enum class ParseMode {
+    DOM, // Read the whole file and build a full XML document tree
+    Streaming, // Read the file in chunks and parse one element at a time
+    Parallel // Split the file into chunks at element boundaries and stream every chunk on its own thread
+};
+
+// Size of a single read in streaming mode
+// Peak memory of streaming parsing is bounded by this plus the largest element
+constexpr size_t STREAM_CHUNK_SIZE = 1 << 20; // 1 MiB
+
+// Smallest part of a file worth parsing on its own thread in parallel mode
+constexpr size_t PARALLEL_MIN_CHUNK_SIZE = 4 << 20; // 4 MiB
 
 
 class ParseOSM {
-private: 
-	static std::atomic<uint32_t> counter; // Counter for generating unique edge IDs
+public:
+    // Everything parsed from a single .osm file before it gets merged into the graph
+    // Files are independent until the merge, so each can be parsed on its own thread
+    struct PartialGraph {
+        Graph::Bounds bbox; // Bounds of the file
+        std::vector<std::pair<int64_t, Graph::Node>> nodes; // Nodes inside the bounds in file order
+        std::vector<Graph::Edge> segments; // Consecutive node pairs of ways that pass our filter
+        std::vector<std::pair<int64_t, uint32_t>> ways; // ID and segment count of the ways in segments, in the same order
+    };
 
 private:
-    // Parse map information from input file to graph
+    friend class ParsePBF; // Shares the way filter
+    friend class ParseOSC; // Shares the way filter and attribute decoding
+
+    // Result of scanning the stream buffer for the next top-level element
+    enum class Scan {
+        Element, // A complete <bounds>, <node>, <way> or <relation> element
+        Skip, // Prolog, comment or the <osm> root tag, nothing to parse
+        Incomplete // Buffer ends before the element does, more data needed
+    };
+
+private:
+    // Parse map information from input file to a partial graph
     // Including nodes, edges and ways
-    void static parseOSM(const std::string& file_path, Graph& graph);
+    void static parseOSM(const std::string& file_path, PartialGraph& partial);
+
+    // Same as parseOSM, but never holds more than a chunk of the file and a single element in memory
+    // Only elements starting inside the byte range [begin, end) are parsed
+    // A range from the middle of a file expects the bounds of the file to be set in partial
+    void static streamOSM(const std::string& file_path, PartialGraph& partial, uint64_t begin = 0, uint64_t end = UINT64_MAX);
+
+    // Read only the <bounds> of a file, returns false if there are none
+    bool static readBounds(const std::string& file_path, Graph::Bounds& bbox);
+
+    // Split a file into at most the given amount of byte ranges which all start at a top-level element
+    // Returns the range offsets, range k is [offsets[k], offsets[k + 1])
+    std::vector<uint64_t> static splitFile(const std::string& file_path, size_t parts);
+
+    // Helper for splitFile to find the first <node>, <way> or <relation> starting at or after offset
+    uint64_t static findElementStart(std::ifstream& file, uint64_t offset);
+
+    // Helper for streamOSM to find the next top-level element starting from pos
+    // On Scan::Element the element text is stored to element, pos is advanced past everything consumed
+    Scan static scanElement(std::string_view buffer, size_t& pos, std::string_view& element);
+
+    // Element handlers shared by both parse modes
+    // Expand bounding box by <bounds>, returns false if the element is invalid
+    bool static parseBounds(const rapidxml::xml_node<char>* bounds_node, PartialGraph& partial);
+
+    // Store a <node> if it is inside the bounding box
+    void static parseNode(const rapidxml::xml_node<char>* node, PartialGraph& partial);
+
+    // Store the segments of a <way> if the way passes our filter
+    void static parseWay(const rapidxml::xml_node<char>* way, PartialGraph& partial);
+
+    // Decode a numeric attribute in place, returns false if it is missing or malformed
+    template <typename T>
+    bool static parseAttribute(const rapidxml::xml_node<char>* node, std::string_view name, T& value);
 
     // Helper for parseOSM to filter out certain ways
     // For example boat ways
-    bool static isValidWay(const std::string& key, const std::string& value);
-
-    // Create unique 32-bit int ID for graph edge
-    uint32_t static generateUniqueID();
+    bool static isValidWay(std::string_view key, std::string_view value);
 
 public:
-    void static loadMap(const std::string& file_path, Graph& graph) {
-        parseOSM(file_path, graph);
+    // Parse a single file straight into graph
+    size_t static loadMap(const std::string& file_path, Graph& graph, ParseMode mode = ParseMode::DOM, bool prune_nodes = false) {
+        return loadMaps({ file_path }, graph, mode, prune_nodes);
     }
+
+    // Parse files into graph on a pool of worker threads (0 uses every core)
+    // Every file, or with ParseMode::Parallel every chunk of a file, is parsed into its own partial graph
+    // .osm.pbf files are decoded blob by blob in parallel regardless of mode
+    // The partials are merged in the order of file_paths once all of them are done
+    // With prune_nodes only nodes used by routable ways are kept, see mergePartials
+    // Returns the number of nodes dropped by pruning
+    size_t static loadMaps(const std::vector<std::string>& file_paths, Graph& graph, ParseMode mode = ParseMode::DOM,
+        bool prune_nodes = false, unsigned threads = 0);
+
+    // Merge partial graphs into graph
+    // Bounding boxes are combined first, then nodes and finally edges of every partial in the order given,
+    // so the result doesn't depend on which file finished parsing first
+    // Nodes and edges shared by several files (along tile boundaries) are only added once
+    // Partials are released while merging
+    // With prune_nodes the node IDs referenced by way segments are collected first and only those nodes are added,
+    // which drops building corners, POIs and landuse vertices that no routable way uses
+    // Returns the number of distinct nodes dropped
+    size_t static mergePartials(std::vector<PartialGraph>& partials, Graph& graph, bool prune_nodes = false);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,53 @@
+#ifndef PARSEPBF_H
+#define PARSEPBF_H
+
+#include "ParseOSM.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+
+// OpenStreetMap PBF file format:
+//
+// [Blob] * n, where every blob is
+// [header_size: int32_t, big endian] [BlobHeader: header_size bytes] [Blob: BlobHeader.datasize bytes]
+//
+// The first blob is an OSMHeader holding the bounding box, the rest are OSMData blobs
+// Blob contents are zlib compressed protobuf messages, every OSMData blob (a PrimitiveBlock)
+// holds a few thousand nodes or ways and can be decoded independently of the others
+//
+// Only the parts of the format needed for the graph are decoded: dense and plain nodes, ways and their tags
+
+
+class ParsePBF {
+public:
+	// Location of a blob's data inside the file
+	struct Blob {
+		uint64_t offset; // File offset of the Blob message
+		uint32_t size; // Size of the Blob message
+	};
+
+	// Returns true if the file name looks like a PBF file
+	static bool isPBF(const std::string& file_path);
+
+	// Read the OSMHeader blob and the locations of all OSMData blobs without decompressing them
+	// bbox is left untouched if the header has no bounding box
+	// Returns false if the file can't be read
+	static bool readIndex(const std::string& file_path, Graph::Bounds& bbox, std::vector<Blob>& blobs);
+
+	// Decode one OSMData blob into a partial graph
+	// Nodes are filtered by partial.bbox if it has been set, otherwise partial.bbox grows to cover every node
+	static void decodeBlob(const std::string& file_path, const Blob& blob, ParseOSM::PartialGraph& partial);
+
+private:
+	// Read and decompress a Blob message into out
+	// Returns false on unsupported compression or corrupted data
+	static bool inflateBlob(std::string_view blob, std::string& out);
+
+	// Decode the OSMHeader block, only the bounding box is of interest
+	static void decodeHeader(std::string_view block, Graph::Bounds& bbox);
+
+	// Decode one PrimitiveBlock of nodes and ways
+	static void decodePrimitiveBlock(std::string_view block, ParseOSM::PartialGraph& partial);
+};
+
+#endif
@@ -1,52 +1,97 @@
 #ifndef QUADTREE_H
 #define	QUADTREE_H
 
-#include <SFML/Graphics.hpp>
-#include <memory>
+#include "Graph.hpp"
+#include "FlatArray.hpp"
 #include <vector>
+#include <cstdint>
+#include <memory>
+#include <atomic>
 
-// Forward declare Graphics
-class Graphics;
+// Spatial index of the graph edges for finding the edges in view
+//
+// The tree works in map space, where the bounding box of the graph spans 0..1 on both axes
+// with y growing southwards, so it doesn't depend on the window size and can be stored in the binary file
+// Cells and their edge lists are kept in flat arrays, children of a cell are stored next to each other
 
 class Quadtree {
 public:
-	struct TreeEdge {
-		uint32_t id; // Edge id
-		sf::Vector2f v1, v2; // Edge endpoints
-		sf::Color color; // Color depending on if in path
-		float thickness; // Thickess of edge (found path appears thicker)
-	};
-
 	struct Bounds {
 		float left, top, right, bottom;
 	};
 
+	// Position in map space
+	struct Point {
+		float x, y;
+	};
+
+	// Edge endpoints projected to map space, indexed by edge ID
+	struct Segment {
+		Point from, to;
+	};
+
+	// Node of the tree
+	struct Cell {
+		Bounds bounds;
+		uint32_t first_child; // Index of the first of four children, 0 if not divided
+		uint32_t begin, end; // Range of the cell's edges in cell_edges
+	};
+
+	// Edges projected so far while the tree is being built
+	// segments is set before projected first grows, and its first projected entries don't change afterwards
+	struct Progress {
+		std::shared_ptr<const std::vector<Segment>> segments;
+		std::atomic<size_t> projected{ 0 };
+	};
+
 public:
-	// Quadtree gets constructed with the bounds calculated by the current window resolution
-	Quadtree(const Bounds& bounds, unsigned int capacity = 4);
+	Quadtree() = default;
+
+	// Project the edges of a graph to map space and build the tree
+	// Edges are projected on another thread in chunks and inserted as they become ready
+	// The adjacency list must have been created
+	// capacity is the number of edges a cell holds before it gets divided
+	// progress, if given, shares the projected edges with a reader before the tree is done, one build per progress
+	void build(const Graph& graph, unsigned int capacity = 4, Progress* progress = nullptr);
+
+	// Use arrays loaded from a binary file
+	void setArrays(FlatArray<Segment> segments, FlatArray<Cell> cells, FlatArray<uint32_t> cell_edges);
+
+	// Recursively query the quadtree for all edges within the bounds given in map space
+	// IDs of all edges fitting the bounds get inserted to the vector passed as a parameter
+	void query(const Bounds& query_bounds, std::vector<uint32_t>& result) const;
 
-	// Insert an edge pointer into the quadtree
-	void insert(TreeEdge* edge);
+	// True if nothing has been built or loaded
+	bool empty() const { return cells.empty(); }
 
-	// Recursively query the quadtree for all edges within the view's bounds
-	// All edges fitting the view's bounds gets inserted to the vector passed as a parameter
-	void query(const Bounds& queryBounds, std::vector<TreeEdge*>& result) const;
+	const FlatArray<Segment>& getSegments() const { return segments; }
+	const FlatArray<Cell>& getCells() const { return cells; }
+	const FlatArray<uint32_t>& getCellEdges() const { return cell_edges; }
+
+	// Project earth coordinates to map space
+	static Point project(const Graph::Bounds& bbox, double lat, double lon);
+
+	// Project nodes of a graph to map space in one batch, out[i] for the node at indices[i]
+	// Reads the fixed-point coordinate arrays directly, the adjacency list must have been created
+	static void project(const Graph& graph, const uint32_t* indices, size_t count, Point* out);
+
+	// Earth coordinates covered by bounds in map space, the inverse of project
+	static Graph::Bounds toEarth(const Graph::Bounds& bbox, const Bounds& map_bounds);
 
 private:
-	Bounds bounds; // Store the bounds of current quadtree for querying
-	unsigned int capacity; // Capasity of a node, aka max children count
-	bool divided; // Keep track if a node is divided
-	std::vector<TreeEdge*> edges; // Store edges of quadtree
-	std::array<std::unique_ptr<Quadtree>, 4> children; // Store children as quadtrees
+	FlatArray<Segment> segments;
+	FlatArray<Cell> cells; // Root first
+	FlatArray<uint32_t> cell_edges;
 
 private:
-	// Subdivide the current quadtree node into four quadrants
-	void subdivide();
+	// Query a cell and its children
+	void query(uint32_t cell, const Bounds& query_bounds, std::vector<uint32_t>& result) const;
 
 	// Check if two bounding boxes intersect
-	bool intersects(const Bounds& a, const Bounds& b) const;
-	// Overload to comparare if an edge intersects with a bounding box
-	bool intersects(const Bounds& a, const TreeEdge& edge) const;
+	static bool intersects(const Bounds& a, const Bounds& b);
+
+	// Bounding box of an edge
+	static Bounds segmentBounds(const Segment& segment);
 };
 
-#endif
\ No newline at end of file
+#endif
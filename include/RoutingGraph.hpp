@@ -0,0 +1,86 @@
+#ifndef ROUTINGGRAPH_H
+#define ROUTINGGRAPH_H
+
+#include "Graph.hpp"
+#include <vector>
+#include <cstdint>
+
+// Graph for route searches with the chains of degree-2 nodes collapsed
+//
+// Ways are split into an edge per node pair, so most nodes of a map only connect the two edges next to them
+// Nodes with any other number of neighbors are junctions, and the edges between two junctions form a chain
+// The routing graph has the junctions as nodes and one edge per chain, weighted by the length of the chain
+// Chains remember their edges in order from their from junction, so a route through them unpacks to the
+// same edge IDs as a search over the full graph
+// Nodes inside a chain know their chain and distance along it, which is where a search starts or ends at them
+
+
+class RoutingGraph {
+public:
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	// Maximal run of edges between two junctions, passing only degree-2 nodes
+	struct Chain {
+		uint32_t from, to; // Junction indices, the same for a loop
+		double weight; // Sum of the edge weights
+		uint32_t edge_begin, edge_end; // Range of the chain's edges in chain_edges
+	};
+
+	// Where a node of the graph is in the routing graph
+	struct Location {
+		uint32_t junction = NONE; // Junction index if the node is a junction
+		uint32_t chain = NONE; // Chain the node is inside of otherwise
+		uint32_t step = 0; // Edges between the chain's from junction and the node
+		double offset = 0; // Meters between the chain's from junction and the node
+	};
+
+	RoutingGraph() = default;
+
+	// Collapse the chains of a graph, its adjacency list must have been created
+	// Reads every node, so tiled graphs loaded on demand are better searched as they are
+	void build(const Graph& graph);
+
+	size_t getJunctionCount() const { return junction_nodes.size(); }
+	size_t getChainCount() const { return chains.size(); }
+
+	// Number of edges in the routing graph, chains that start and end at the same junction have none
+	size_t getEdgeCount() const { return adj_targets.size() / 2; }
+
+	// Memory taken by the routing graph in bytes
+	size_t memoryBytes() const;
+
+	// Node index of a junction in the graph
+	uint32_t getNode(uint32_t junction) const { return junction_nodes[junction]; }
+
+	Location locate(uint32_t node) const;
+
+	const Chain& getChain(uint32_t chain) const { return chains[chain]; }
+
+	// Edge ID of the step:th edge of a chain, counting from its from junction
+	uint32_t getChainEdge(const Chain& chain, uint32_t step) const { return chain_edges[chain.edge_begin + step]; }
+
+	// Neighbors of a junction, Neighbor::index is a junction index and Neighbor::edge_id a chain
+	Graph::Neighbors getNeighbors(uint32_t junction) const {
+		uint32_t begin = adj_offsets[junction];
+		uint32_t end = adj_offsets[junction + 1];
+		return Graph::Neighbors(adj_targets.data() + begin, adj_weights.data() + begin, adj_chains.data() + begin, end - begin);
+	}
+
+private:
+	std::vector<uint32_t> junction_nodes; // Junction index to node index
+	std::vector<uint32_t> node_junctions; // Node index to junction index, NONE inside chains
+	std::vector<uint32_t> node_chains; // Node index to the chain it is inside of, NONE for junctions
+	std::vector<uint32_t> node_steps;
+	std::vector<double> node_offsets;
+
+	std::vector<Chain> chains;
+	std::vector<uint32_t> chain_edges; // Edge IDs of every chain, each edge of the graph is in exactly one
+
+	// Compressed sparse rows over junction indices like in Graph, both directions of a chain share its weight
+	std::vector<uint32_t> adj_offsets;
+	std::vector<uint32_t> adj_targets;
+	std::vector<double> adj_weights;
+	std::vector<uint32_t> adj_chains;
+};
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef TAGFILTER_H
+#define TAGFILTER_H
+
+#include <string_view>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// Compile-time tag classifier for filtering out non-routable ways
+//
+// All rules are placed into a table with a perfect hash, i.e. a hash seed that has been searched at compile time
+// so that no two rules share a slot. Classifying a tag costs one hash of the key, two table probes and
+// at most two string comparisons, without any allocation.
+
+
+class TagFilter {
+public:
+	// A way having this tag is not routable
+	// Empty value matches every value of the key
+	struct Rule {
+		std::string_view key;
+		std::string_view value;
+	};
+
+	static constexpr Rule rules[] = {
+		// Non-routable keys
+		{ "boundary", "" }, { "building", "" }, { "landuse", "" }, { "waterway", "" },
+		{ "vessel", "" }, { "ferry", "" }, { "seamark:type", "" },
+
+		// Exclude area boundaries
+		{ "area", "yes" },
+
+		// Exclude private/proposed access restrictions
+		{ "access", "private" }, { "access", "no" }, { "highway", "proposed" },
+
+		// Exclude boat routes, ferries, and other non-road navigational routes
+		{ "route", "boat" }, { "route", "ferry" }, { "route", "ship" }, { "route", "seaway" },
+		{ "highway", "ferry" }, { "highway", "path" }, { "service", "ferry" },
+		{ "motorboat", "yes" }, { "motorboat", "designated" },
+		{ "transport_mode", "boat" }, { "transport_mode", "ship" },
+
+		// Exclude underground and underwater ways
+		{ "tunnel", "yes" }, { "tunnel", "culvert" }, { "covered", "yes" },
+		{ "location", "underground" }, { "location", "underwater" },
+
+		// Exclude public transport routes
+		{ "route", "bus" }, { "route", "trolleybus" }, { "route", "tram" }, { "route", "subway" },
+		{ "route", "train" }, { "route", "light_rail" }, { "route", "monorail" },
+
+		// Exclude public transport infrastructure
+		{ "public_transport", "platform" }, { "public_transport", "stop_position" },
+
+		// Exclude railway-based public transport
+		{ "railway", "subway" }, { "railway", "tram" }, { "railway", "light_rail" }, { "railway", "monorail" }
+	};
+
+	// Returns false if a way with this tag should be filtered out
+	static constexpr bool isValidTag(std::string_view key, std::string_view value) {
+		uint64_t key_hash = hash(FNV_OFFSET, key);
+		return !matches(key_hash, key, "") && !matches(key_hash, key, value);
+	}
+
+	// Hash of all rules, changes whenever the filter configuration changes
+	static constexpr uint64_t fingerprint() {
+		uint64_t h = FNV_OFFSET;
+		for (const Rule& rule : rules) {
+			h = hash(hash(hash(h, rule.key), "="), rule.value);
+			h = hash(h, ";");
+		}
+		return h;
+	}
+
+private:
+	static constexpr size_t TABLE_BITS = 7; // 128 slots for ~40 rules keeps the seed search short
+	static constexpr size_t TABLE_SIZE = size_t(1) << TABLE_BITS;
+	static constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+	static constexpr uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+	// FNV-1a, continues from a previous hash so the key only gets hashed once per tag
+	static constexpr uint64_t hash(uint64_t h, std::string_view text) {
+		for (char c : text) {
+			h ^= static_cast<uint8_t>(c);
+			h *= FNV_PRIME;
+		}
+		return h;
+	}
+
+	// Slot of a key/value pair given the hash of the key
+	// The separator keeps ("ab", "c") and ("a", "bc") apart
+	static constexpr size_t slot(uint64_t key_hash, std::string_view value, uint64_t seed) {
+		uint64_t h = hash(key_hash ^ 0xFF, value) ^ seed;
+		h *= 0x9E3779B97F4A7C15ULL; // Fibonacci hashing, top bits are the best mixed
+		return static_cast<size_t>(h >> (64 - TABLE_BITS));
+	}
+
+	// Find a seed that gives every rule its own slot
+	static constexpr uint64_t findSeed() {
+		for (uint64_t seed = 1;; ++seed) {
+			std::array<bool, TABLE_SIZE> used{};
+			bool collision = false;
+			for (const Rule& rule : rules) {
+				size_t s = slot(hash(FNV_OFFSET, rule.key), rule.value, seed);
+				if (used[s]) {
+					collision = true;
+					break;
+				}
+				used[s] = true;
+			}
+			if (!collision) return seed;
+		}
+	}
+
+	static const uint64_t SEED; // Defined after the class, the search needs the complete class
+
+	// Table of rule indices by slot, -1 for empty slots
+	static constexpr std::array<int8_t, TABLE_SIZE> buildTable() {
+		std::array<int8_t, TABLE_SIZE> table{};
+		table.fill(-1);
+		for (size_t i = 0; i < std::size(rules); ++i) {
+			table[slot(hash(FNV_OFFSET, rules[i].key), rules[i].value, SEED)] = static_cast<int8_t>(i);
+		}
+		return table;
+	}
+
+	static const std::array<int8_t, TABLE_SIZE> table;
+
+	// Check if key/value is a rule, the single candidate slot decides
+	static constexpr bool matches(uint64_t key_hash, std::string_view key, std::string_view value) {
+		int8_t index = table[slot(key_hash, value, SEED)];
+		return index >= 0 && rules[index].key == key && rules[index].value == value;
+	}
+};
+
+constexpr uint64_t TagFilter::SEED = TagFilter::findSeed();
+constexpr std::array<int8_t, TagFilter::TABLE_SIZE> TagFilter::table = TagFilter::buildTable();
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include "Graph.hpp"
+#include <vector>
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Keeps the tiles of a tiled graph mapped from a file within a memory budget
+//
+// A tile is a range in every array of the file, so loading one means asking the OS to read those ranges
+// and releasing one means letting the OS drop their pages again
+// Tiles are loaded when the view or a route search reaches them, and the least recently used
+// are released once the loaded tiles take more than the budget
+// Arrays the graph owns instead of mapping are always in memory and left alone
+
+class TileCache {
+public:
+	// The graph must be tiled and stay alive as long as the cache
+	TileCache(const Graph& graph, size_t memory_budget);
+
+	// Also load and release a per-edge array mapped from the file, such as the projected edges
+	void addEdgeArray(const void* data, size_t element_size);
+
+	// Make sure the tile holding a node is loaded
+	void useNode(size_t index);
+
+	// Make sure every tile overlapping an area is loaded
+	void useArea(const Graph::Bounds& area);
+
+	// Bytes of the loaded tiles
+	size_t getLoadedBytes() const;
+	size_t getLoadedTiles() const;
+
+private:
+	// Mark a tile as just used, loading it if needed and releasing old tiles over the budget
+	// The mutex must be held
+	void use(uint32_t tile);
+
+	// Memory taken by a tile in the file
+	size_t tileBytes(uint32_t tile) const;
+
+	// Prefetch or evict every range of a tile
+	void advise(uint32_t tile, bool load) const;
+
+	// Tile holding a node
+	uint32_t findTile(size_t index) const;
+
+private:
+	struct EdgeArray {
+		const char* data;
+		size_t element_size;
+	};
+
+	const Graph& graph;
+	size_t memory_budget;
+	std::vector<EdgeArray> edge_arrays;
+
+	std::list<uint32_t> recent; // Loaded tiles, most recently used first
+	std::vector<std::list<uint32_t>::iterator> positions; // Position of each loaded tile in recent
+	std::vector<bool> loaded;
+	size_t loaded_bytes = 0;
+
+	// Route searches stay in one tile for many lookups, so those skip the lock
+	std::atomic<uint32_t> last_tile{ UINT32_MAX };
+	mutable std::mutex mutex;
+};
+
+#endif
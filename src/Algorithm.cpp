@@ -1,20 +1,100 @@
 #include "Algorithm.hpp"
 
+// Nodes settled by the last search of each thread
+static thread_local size_t settled_count = 0;
+
+size_t Algorithm::getSettledCount() {
+	return settled_count;
+}
+
 void Algorithm::runAstar(Graph& graph, int64_t source, int64_t target,
-	std::vector<uint32_t>& path, std::unordered_set<uint32_t>& path_lookup, double& distance) {
+	std::vector<uint32_t>& path, std::vector<bool>& path_lookup, double& distance) {
+	settled_count = 0;
+
+	// Look up the OSM IDs once, the rest of the search works on indices
+	size_t source_index = graph.findIndex(source);
+	size_t target_index = graph.findIndex(target);
+	if (source_index == Graph::NOT_FOUND || target_index == Graph::NOT_FOUND) {
+		return;
+	}
+
+	// Nodes in different components have no route between them, a search would only find that out
+	// after going through every node it can reach
+	if (!graph.connected(static_cast<uint32_t>(source_index), static_cast<uint32_t>(target_index))) {
+		return;
+	}
+	if (EdgeWeights* live = graph.getEdgeWeights()) {
+		// One version of the weights for the whole search, batches applied meanwhile show in the next one
+		EdgeWeights::Snapshot weights(*live);
+		if (const CompressedAdjacency* compressed = graph.getCompressedAdjacency()) {
+			runNodeAstar(graph, [compressed](uint32_t index) { return compressed->getNeighbors(index); },
+				static_cast<uint32_t>(source_index), static_cast<uint32_t>(target_index), path, path_lookup, distance, &*weights);
+			return;
+		}
+		runNodeAstar(graph, [&graph](uint32_t index) { return graph.getNeighborsAt(index); },
+			static_cast<uint32_t>(source_index), static_cast<uint32_t>(target_index), path, path_lookup, distance, &*weights);
+		return;
+	}
+	if (const ContractionHierarchy* hierarchy = graph.getContractionHierarchy()) {
+		runHierarchySearch(graph, *hierarchy, static_cast<uint32_t>(source_index), static_cast<uint32_t>(target_index),
+			path, path_lookup, distance);
+		return;
+	}
+	if (const RoutingGraph* routing = graph.getRoutingGraph()) {
+		runContractedAstar(graph, *routing, static_cast<uint32_t>(source_index), static_cast<uint32_t>(target_index),
+			path, path_lookup, distance);
+		return;
+	}
+	if (const CompressedAdjacency* compressed = graph.getCompressedAdjacency()) {
+		runNodeAstar(graph, [compressed](uint32_t index) { return compressed->getNeighbors(index); },
+			static_cast<uint32_t>(source_index), static_cast<uint32_t>(target_index), path, path_lookup, distance);
+		return;
+	}
+	runNodeAstar(graph, [&graph](uint32_t index) { return graph.getNeighborsAt(index); },
+		static_cast<uint32_t>(source_index), static_cast<uint32_t>(target_index), path, path_lookup, distance);
+}
+
+template <typename GetNeighbors>
+void Algorithm::runNodeAstar(const Graph& graph, GetNeighbors getNeighbors, uint32_t source_index, uint32_t target_index,
+	std::vector<uint32_t>& path, std::vector<bool>& path_lookup, double& distance, const EdgeWeights::Version* weights) {
 	// Priority queue for A* algorithm
 	std::priority_queue<AstarNode> pq;
 
-	// Track visited nodes and their g values
-	std::unordered_map<int64_t, double> dist; // g values
+	// g values and parents of the nodes, one search per thread at a time
+	constexpr double unreached = std::numeric_limits<double>::infinity();
+	static thread_local SearchState state;
+	size_t num_nodes = graph.getNodeCount();
+	if (state.dist.size() != num_nodes) {
+		state.dist.assign(num_nodes, unreached);
+		state.prev_node.resize(num_nodes);
+		state.prev_edge.resize(num_nodes);
+	}
+	std::vector<double>& dist = state.dist;
+
+	// Every edge ID must have a slot in the lookup
+	if (path_lookup.size() < graph.getEdges().size()) {
+		path_lookup.resize(graph.getEdges().size(), false);
+	}
 
-	// Track the path and distances
-	std::unordered_map<int64_t, std::tuple<int64_t, double, uint32_t>> prev; // (parent, weight, edge_id)
+	// Heuristic costs are Haversine distances to the target, or landmark bounds where those are higher
+	const Graph::Node target_node = graph.getNodeAt(target_index);
+	const Landmarks* landmarks = graph.getLandmarks();
+	if (landmarks) {
+		landmarks->aim(target_index, state.landmark_target);
+	}
+	std::vector<uint32_t>& improved = state.improved;
+	std::vector<double>& heuristics = state.heuristics;
 
 	// Add source node to the priority queue
-	AstarNode start(source, 0, heuristic(graph,source,target));
-	pq.push(start);
-	dist[source] = 0;
+	uint32_t start = source_index;
+	double start_h;
+	graph.getHaversineDistances(&start, 1, target_node, &start_h);
+	if (landmarks) {
+		landmarks->raiseBounds(&start, 1, state.landmark_target, &start_h);
+	}
+	pq.push(AstarNode(start, 0, start_h));
+	dist[source_index] = 0;
+	state.touched.push_back(start);
 
 	// A* algorithm to find the shortest path from source to target
 	while (!pq.empty()) {
@@ -22,44 +102,337 @@ void Algorithm::runAstar(Graph& graph, int64_t source, int64_t target,
 		AstarNode current = pq.top();
 		pq.pop();
 
-
-
 		// If target is reached reconstruct the path
-		if (current.id == target) {
-			for (int64_t at = target; at != source; at = std::get<0>(prev[at])) {
-				path.push_back(std::get<2>(prev[at]));
-				path_lookup.insert(std::get<2>(prev[at]));
-				distance += std::get<1>(prev[at]);
+		if (current.index == target_index) {
+			for (uint32_t at = target_index; at != source_index; at = state.prev_node[at]) {
+				path.push_back(state.prev_edge[at]);
+				path_lookup[state.prev_edge[at]] = true;
 			}
-			return;
+			distance += dist[target_index];
+			break;
 		}
 
 		// Skip if shorter path is already found
-		if (current.g > dist[current.id]) {
+		if (current.g > dist[current.index]) {
 			continue;
 		}
+		++settled_count;
 
-		// Visit neighbors of the current node
-		for (const auto& [neighbor, weight, edge_id] : graph.getNeighbors(current.id)) {
-			// Calculate the new distance
-			double g = current.g + weight;
+		// Visit neighbors of the current node, stored next to each other
+		improved.clear();
+		for (const auto& [neighbor, weight, edge_id] : getNeighbors(current.index)) {
+			// Calculate the new distance, closed edges have infinite weight and never give a shorter path
+			double g = current.g + (weights ? weights->get(edge_id) : weight);
 			// Update the distance if a shorter path is found
-			if (dist.find(neighbor) == dist.end() || g < dist[neighbor]) {
+			if (g < dist[neighbor]) {
+				if (dist[neighbor] == unreached) {
+					state.touched.push_back(neighbor);
+				}
 				dist[neighbor] = g; // Update the distance
-				AstarNode next(neighbor, g, heuristic(graph,neighbor,target));
-				pq.push(next);
-				prev[neighbor] = { current.id, weight, edge_id };
+				state.prev_node[neighbor] = current.index;
+				state.prev_edge[neighbor] = edge_id;
+				improved.push_back(neighbor);
+			}
+		}
+
+		// Heuristics of the improved neighbors in one batch
+		heuristics.resize(improved.size());
+		graph.getHaversineDistances(improved.data(), improved.size(), target_node, heuristics.data());
+		if (landmarks) {
+			landmarks->raiseBounds(improved.data(), improved.size(), state.landmark_target, heuristics.data());
+		}
+		for (size_t i = 0; i < improved.size(); ++i) {
+			pq.push(AstarNode(improved[i], dist[improved[i]], heuristics[i]));
+		}
+	}
+	// If no path found distance remains zero
+
+	// Leave the state clean for the next search
+	for (uint32_t index : state.touched) {
+		dist[index] = unreached;
+	}
+	state.touched.clear();
+}
+
+void Algorithm::runContractedAstar(const Graph& graph, const RoutingGraph& routing, uint32_t source, uint32_t target,
+	std::vector<uint32_t>& path, std::vector<bool>& path_lookup, double& distance) {
+	if (source == target) {
+		return; // Found right away with no edges, as on the full graph
+	}
+	if (path_lookup.size() < graph.getEdges().size()) {
+		path_lookup.resize(graph.getEdges().size(), false);
+	}
+
+	// Add edges step_begin .. step_end - 1 of a chain to the path, which runs from target to source
+	// forward is true if the route goes through them from the chain's from junction towards its to junction
+	auto addChainEdges = [&](const RoutingGraph::Chain& chain, uint32_t step_begin, uint32_t step_end, bool forward) {
+		for (uint32_t i = 0; i < step_end - step_begin; ++i) {
+			uint32_t id = routing.getChainEdge(chain, forward ? step_end - 1 - i : step_begin + i);
+			path.push_back(id);
+			path_lookup[id] = true;
+		}
+	};
+
+	// A node inside a chain is reached through either end of its chain
+	// Ends of the search are the junctions it is left from, with the meters still to go
+	RoutingGraph::Location from = routing.locate(source);
+	RoutingGraph::Location to = routing.locate(target);
+	struct End {
+		uint32_t junction;
+		double extra;
+	};
+	End seeds[2], exits[2];
+	size_t seed_count = 0, exit_count = 0;
+	if (from.junction != RoutingGraph::NONE) {
+		seeds[seed_count++] = { from.junction, 0 };
+	}
+	else {
+		const RoutingGraph::Chain& chain = routing.getChain(from.chain);
+		seeds[seed_count++] = { chain.from, from.offset };
+		seeds[seed_count++] = { chain.to, chain.weight - from.offset };
+	}
+	if (to.junction != RoutingGraph::NONE) {
+		exits[exit_count++] = { to.junction, 0 };
+	}
+	else {
+		const RoutingGraph::Chain& chain = routing.getChain(to.chain);
+		exits[exit_count++] = { chain.from, to.offset };
+		exits[exit_count++] = { chain.to, chain.weight - to.offset };
+	}
+
+	// Best complete route so far, ending through exits[best_exit]
+	// Source and target in the same chain are also connected along it without leaving
+	constexpr double unreached = std::numeric_limits<double>::infinity();
+	constexpr size_t ALONG_CHAIN = 2;
+	double best = unreached;
+	size_t best_exit = 0;
+	if (from.chain != RoutingGraph::NONE && from.chain == to.chain) {
+		best = std::abs(from.offset - to.offset);
+		best_exit = ALONG_CHAIN;
+	}
+
+	// g values and parents of the junctions, one search per thread at a time
+	// prev_edge holds the chain the best path came through, NONE at the seeds
+	static thread_local SearchState state;
+	size_t num_junctions = routing.getJunctionCount();
+	if (state.dist.size() != num_junctions) {
+		state.dist.assign(num_junctions, unreached);
+		state.prev_node.resize(num_junctions);
+		state.prev_edge.resize(num_junctions);
+	}
+	std::vector<double>& dist = state.dist;
+
+	// Heuristic costs are Haversine distances to the target, never more than the length of any chain there,
+	// or landmark bounds where those are higher
+	std::priority_queue<AstarNode> pq;
+	const Graph::Node target_node = graph.getNodeAt(target);
+	const Landmarks* landmarks = graph.getLandmarks();
+	if (landmarks) {
+		landmarks->aim(target, state.landmark_target);
+	}
+	std::vector<uint32_t>& improved = state.improved;
+	std::vector<uint32_t>& improved_nodes = state.improved_nodes;
+	std::vector<double>& heuristics = state.heuristics;
+	auto pushImproved = [&]() {
+		improved_nodes.clear();
+		for (uint32_t junction : improved) {
+			improved_nodes.push_back(routing.getNode(junction));
+		}
+		heuristics.resize(improved.size());
+		graph.getHaversineDistances(improved_nodes.data(), improved_nodes.size(), target_node, heuristics.data());
+		if (landmarks) {
+			landmarks->raiseBounds(improved_nodes.data(), improved_nodes.size(), state.landmark_target, heuristics.data());
+		}
+		for (size_t i = 0; i < improved.size(); ++i) {
+			pq.push(AstarNode(improved[i], dist[improved[i]], heuristics[i]));
+		}
+	};
+
+	improved.clear();
+	for (size_t i = 0; i < seed_count; ++i) {
+		uint32_t junction = seeds[i].junction;
+		if (seeds[i].extra < dist[junction]) {
+			if (dist[junction] == unreached) {
+				state.touched.push_back(junction);
+				improved.push_back(junction);
+			}
+			dist[junction] = seeds[i].extra;
+			state.prev_edge[junction] = RoutingGraph::NONE;
+		}
+	}
+	pushImproved();
+
+	while (!pq.empty()) {
+		// Nothing left in the queue can beat the best route, heuristics never overestimate
+		AstarNode current = pq.top();
+		if (current.f() >= best) {
+			break;
+		}
+		pq.pop();
+
+		// Skip if shorter path is already found
+		if (current.g > dist[current.index]) {
+			continue;
+		}
+		++settled_count;
+
+		for (size_t i = 0; i < exit_count; ++i) {
+			if (exits[i].junction == current.index && current.g + exits[i].extra < best) {
+				best = current.g + exits[i].extra;
+				best_exit = i;
+			}
+		}
+
+		improved.clear();
+		for (const auto& [neighbor, weight, chain] : routing.getNeighbors(current.index)) {
+			double g = current.g + weight;
+			if (g < dist[neighbor]) {
+				if (dist[neighbor] == unreached) {
+					state.touched.push_back(neighbor);
+				}
+				dist[neighbor] = g;
+				state.prev_node[neighbor] = current.index;
+				state.prev_edge[neighbor] = chain;
+				improved.push_back(neighbor);
+			}
+		}
+		pushImproved();
+	}
+
+	// Unpack the route into the edges of the graph, from the target back to the source
+	if (best != unreached) {
+		if (best_exit == ALONG_CHAIN) {
+			const RoutingGraph::Chain& chain = routing.getChain(to.chain);
+			addChainEdges(chain, std::min(from.step, to.step), std::max(from.step, to.step), from.step < to.step);
+		}
+		else {
+			// Part of the target's chain from the exit junction, then chains back to a seed
+			uint32_t at = exits[best_exit].junction;
+			if (to.junction == RoutingGraph::NONE) {
+				const RoutingGraph::Chain& chain = routing.getChain(to.chain);
+				if (best_exit == 0) {
+					addChainEdges(chain, 0, to.step, true);
+				}
+				else {
+					addChainEdges(chain, to.step, chain.edge_end - chain.edge_begin, false);
+				}
+			}
+			while (state.prev_edge[at] != RoutingGraph::NONE) {
+				const RoutingGraph::Chain& chain = routing.getChain(state.prev_edge[at]);
+				uint32_t prev = state.prev_node[at];
+				addChainEdges(chain, 0, chain.edge_end - chain.edge_begin, chain.from == prev);
+				at = prev;
+			}
+
+			// Part of the source's chain to the seed junction the route starts from
+			// A loop chain has both seeds at one junction, the shorter one is used
+			if (from.junction == RoutingGraph::NONE) {
+				const RoutingGraph::Chain& chain = routing.getChain(from.chain);
+				bool through_from = chain.from == chain.to ? seeds[0].extra <= seeds[1].extra : at == chain.from;
+				if (through_from) {
+					addChainEdges(chain, 0, from.step, false);
+				}
+				else {
+					addChainEdges(chain, from.step, chain.edge_end - chain.edge_begin, true);
+				}
 			}
 		}
+		distance += best;
 	}
 	// If no path found distance remains zero
+
+	// Leave the state clean for the next search
+	for (uint32_t index : state.touched) {
+		dist[index] = unreached;
+	}
+	state.touched.clear();
 }
 
-double Algorithm::heuristic(Graph& graph, int64_t current, int64_t target) {
-	// Get the current and target node
-	const Graph::Node& current_node = graph.getNode(current);
-	const Graph::Node& target_node = graph.getNode(target);
+void Algorithm::runHierarchySearch(const Graph& graph, const ContractionHierarchy& hierarchy, uint32_t source, uint32_t target,
+	std::vector<uint32_t>& path, std::vector<bool>& path_lookup, double& distance) {
+	if (path_lookup.size() < graph.getEdges().size()) {
+		path_lookup.resize(graph.getEdges().size(), false);
+	}
+
+	// Forward search from the source and backward search from the target, both only going up
+	constexpr double unreached = std::numeric_limits<double>::infinity();
+	static thread_local SearchState states[2];
+	size_t num_nodes = graph.getNodeCount();
+	using Entry = std::pair<double, uint32_t>;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queues[2];
+	uint32_t starts[2] = { source, target };
+	for (int side = 0; side < 2; ++side) {
+		SearchState& state = states[side];
+		if (state.dist.size() != num_nodes) {
+			state.dist.assign(num_nodes, unreached);
+			state.prev_node.resize(num_nodes);
+			state.prev_edge.resize(num_nodes);
+		}
+		state.dist[starts[side]] = 0;
+		state.touched.push_back(starts[side]);
+		queues[side].push({ 0, starts[side] });
+	}
 
-	// Calculate the heuristic cost using Haversine distance
-	return graph.getHaversineDistance(current_node, target_node);
+	// Settle the side with the smaller key until neither side can find a shorter route than the best one meeting so far
+	double best = unreached;
+	uint32_t meeting = ContractionHierarchy::NONE;
+	while (true) {
+		bool open[2] = { !queues[0].empty() && queues[0].top().first < best, !queues[1].empty() && queues[1].top().first < best };
+		if (!open[0] && !open[1]) break;
+		int side = open[0] && (!open[1] || queues[0].top().first <= queues[1].top().first) ? 0 : 1;
+		auto [g, node] = queues[side].top();
+		queues[side].pop();
+		SearchState& state = states[side];
+		if (g > state.dist[node]) continue;
+		++settled_count;
+		double other = states[1 - side].dist[node];
+		if (g + other < best) {
+			best = g + other;
+			meeting = node;
+		}
+		for (uint32_t arc = hierarchy.upBegin(node); arc < hierarchy.upEnd(node); ++arc) {
+			const ContractionHierarchy::Arc& up = hierarchy.getArc(arc);
+			double next = g + up.weight;
+			if (next < state.dist[up.target]) {
+				if (state.dist[up.target] == unreached) {
+					state.touched.push_back(up.target);
+				}
+				state.dist[up.target] = next;
+				state.prev_node[up.target] = node;
+				state.prev_edge[up.target] = arc; // Arc index in the hierarchy
+				queues[side].push({ next, up.target });
+			}
+		}
+	}
+
+	if (meeting != ContractionHierarchy::NONE) {
+		// Unpack the arcs from the source up to the meeting node and down to the target, the path runs from target to source
+		static thread_local std::vector<uint32_t> route, climb;
+		route.clear();
+		climb.clear();
+		for (uint32_t at = meeting; at != source; at = states[0].prev_node[at]) {
+			climb.push_back(at);
+		}
+		for (size_t i = climb.size(); i-- > 0;) {
+			uint32_t at = climb[i];
+			hierarchy.unpack(states[0].prev_edge[at], states[0].prev_node[at], at, route);
+		}
+		for (uint32_t at = meeting; at != target; at = states[1].prev_node[at]) {
+			hierarchy.unpack(states[1].prev_edge[at], at, states[1].prev_node[at], route);
+		}
+		for (size_t i = route.size(); i-- > 0;) {
+			path.push_back(route[i]);
+			path_lookup[route[i]] = true;
+		}
+		distance += best;
+	}
+	// If no path found distance remains zero
+
+	// Leave the state clean for the next search
+	for (SearchState& state : states) {
+		for (uint32_t index : state.touched) {
+			state.dist[index] = unreached;
+		}
+		state.touched.clear();
+	}
 }
@@ -2,14 +2,16 @@
 #include "EventHandler.hpp"
 #include "GraphLoader.hpp"
 #include <iostream>
+#include <iomanip>
 
-App::App(Graph& graph) : 
+App::App(Graph& graph, const Quadtree& quadtree, const LoadProgress& progress) :
+    progress(progress),
     // Get the desktop resolution and initialize window resolution
     window_width(sf::VideoMode::getDesktopMode().size.x * 0.9f),
     window_height(sf::VideoMode::getDesktopMode().size.y * 0.9f)
 {
     // Render with calculated scale
-    renderer = std::make_unique<Graphics>(graph, window_width, window_height);
+    renderer = std::make_unique<Graphics>(graph, quadtree, progress, window_width, window_height);
 }
 
 void App::run() {
@@ -34,10 +36,40 @@ void App::run() {
             event_handler.handleEvent(event);
         }
 
+        // Take what has loaded before drawing, so that the startup report matches what was drawn
+        bool edges_ready = progress.projection.projected > 0 || progress.quadtree_ready;
+        bool graph_ready = progress.graph_ready;
+        bool quadtree_ready = progress.quadtree_ready;
+
         // Apply view and render
         window.setView(view);
         window.clear(BG_COLOR); // Set a dark blue background
         renderer->render(window, view);
         window.display();
+        reportStartup(edges_ready, graph_ready, quadtree_ready);
+    }
+}
+
+void App::reportStartup(bool edges_ready, bool graph_ready, bool quadtree_ready) {
+    if (map_reported) return;
+
+    // Time to first frame is measured from the start of loading, which begins with the program
+    double elapsed = progress.elapsedMs();
+    std::cout << std::fixed << std::setprecision(0);
+    if (!first_frame_reported) {
+        std::cout << "First frame after " << elapsed << " ms\n";
+        first_frame_reported = true;
+    }
+    if (!first_edges_reported && edges_ready) {
+        std::cout << "First edges drawn after " << elapsed << " ms\n";
+        first_edges_reported = true;
+    }
+    if (!routing_reported && graph_ready) {
+        std::cout << "Routing available after " << elapsed << " ms\n";
+        routing_reported = true;
+    }
+    if (quadtree_ready) {
+        std::cout << "Map complete after " << elapsed << " ms" << std::endl;
+        map_reported = true;
     }
 }
\ No newline at end of file
@@ -0,0 +1,1507 @@
+#include "Benchmark.hpp"
+#include "ParseOSM.hpp"
+#include "ParsePBF.hpp"
+#include "Parallel.hpp"
+#include "TagFilter.hpp"
+#include "Binary.hpp"
+#include "Quadtree.hpp"
+#include "TileCache.hpp"
+#include "Algorithm.hpp"
+#include "FlatHash.hpp"
+#include "Haversine.hpp"
+#include "RoutingGraph.hpp"
+#include "CompressedAdjacency.hpp"
+#include "EdgeWeights.hpp"
+#include "ContractionHierarchy.hpp"
+#include "Landmarks.hpp"
+#include "GraphLoader.hpp"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+#include <random>
+#include <charconv>
+#include <thread>
+#include <queue>
+#include <tuple>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+int Benchmark::run(const std::vector<std::string>& args) {
+	if (args.size() >= 2 && args[0] == "ingest") {
+		for (size_t i = 1; i < args.size(); ++i) {
+			ingest(args[i]);
+		}
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "prune") {
+		prune(args[1]);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "load") {
+		load(args[1]);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "startup") {
+		startup(args[1]);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "tiles") {
+		tiles(args[1], args.size() >= 3 ? std::stoul(args[2]) : 16, args.size() >= 4 ? std::stoul(args[3]) : 64);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "hash") {
+		hash(args[1]);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "order") {
+		order(args[1], args.size() >= 3 ? std::stoul(args[2]) : 200);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "compress") {
+		compress(args[1], args.size() >= 3 ? std::stoul(args[2]) : 200);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "live") {
+		live(args[1], args.size() >= 3 ? std::stod(args[2]) : 5.0, args.size() >= 4 ? std::stoul(args[3]) : 1000,
+			args.size() >= 5 ? std::stod(args[4]) : 20.0);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "components") {
+		components(args[1], args.size() >= 3 ? std::stoul(args[2]) : 50);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "hierarchy") {
+		hierarchy(args[1], args.size() >= 3 ? std::stoul(args[2]) : 200);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "landmarks") {
+		landmarks(args[1], args.size() >= 3 ? std::stoul(args[2]) : 200, args.size() >= 4 ? std::stoul(args[3]) : 16);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "chains") {
+		chains(args[1], args.size() >= 3 ? std::stoul(args[2]) : 200);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "weights") {
+		weights(args[1]);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "route") {
+		route(args[1], args.size() >= 3 ? std::stoul(args[2]) : 200);
+		return 0;
+	}
+	if (args.size() >= 1 && args[0] == "tags") {
+		tags(args.size() >= 2 ? std::stoul(args[1]) : 200000);
+		return 0;
+	}
+	if (args.size() >= 2 && args[0] == "scaling") {
+		scaling(args[1], args.size() >= 3 ? std::stoul(args[2]) : Parallel::threadCount());
+		return 0;
+	}
+
+	std::cerr << "Usage: MapViewer --bench <name> [arguments...]\n"
+		<< "  ingest <file.osm>...              Compare DOM, streaming, parallel and PBF ingestion\n"
+		<< "  scaling <file.osm> [max_threads]  Parallel ingestion time from 1 to max_threads threads\n"
+		<< "  prune <file.osm>                  Nodes, graph memory and binary size with and without node pruning\n"
+		<< "  load <file.bin>                   Size, startup time and memory of standard, compact and mapped binary files\n"
+		<< "  startup <file.bin>                Startup phase times with and without the stored adjacency list and quadtree\n"
+		<< "  hash <file.bin>                   Ingest and lookup throughput, memory and probe lengths of the node and edge hash tables\n"
+		<< "  weights <file.bin>                Edge weight throughput and error of the Haversine kernel, portable, AVX2 and threaded\n"
+		<< "  route <file.bin> [queries]        Routing latency and adjacency memory, hash map by OSM ID against CSR by index\n"
+		<< "  chains <file.bin> [queries]       Node and edge counts and routing latency with degree-2 chains collapsed\n"
+		<< "  compress <file.bin> [queries]     Bytes per edge and routing latency of the full and the compressed adjacency\n"
+		<< "  live <file.bin> [seconds] [batch] [rate] Edge weight update throughput and routing latency while updates are applied\n"
+		<< "  components <file.bin> [queries]   Component labeling time and routing latency between components with and without labels\n"
+		<< "  hierarchy <file.bin> [queries]    Contraction hierarchy build time, size and routing latency against A* and chains collapsed\n"
+		<< "  landmarks <file.bin> [queries] [count] Settled nodes and routing latency of A* with Haversine and landmark bounds\n"
+		<< "  order <file.bin> [queries]        Locality, cache misses, routing and panning time with nodes by ID and in Hilbert order\n"
+		<< "  tiles <file.bin> [budget_mb] [grid] Resident memory while panning across and routing through a tiled map\n"
+		<< "  tags [ways]                       Cost per way of tag filtering and number decoding, before and after TagFilter" << std::endl;
+	return 1;
+}
+
+#ifdef _WIN32
+size_t Benchmark::currentMemory() {
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.WorkingSetSize;
+}
+
+size_t Benchmark::peakMemory() {
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize;
+}
+
+bool Benchmark::resetPeakMemory() {
+	return false; // Peak working set can't be reset
+}
+#else
+// Read a "<key>: <value> kB" line from /proc/self/status
+static size_t readProcStatus(const std::string& key) {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.rfind(key + ":", 0) == 0) {
+			return std::stoull(line.substr(key.size() + 1)) * 1024;
+		}
+	}
+	return 0;
+}
+
+size_t Benchmark::currentMemory() {
+	return readProcStatus("VmRSS");
+}
+
+size_t Benchmark::peakMemory() {
+	size_t peak = readProcStatus("VmHWM");
+	if (peak == 0) {
+		// No procfs, fall back to rusage (kilobytes on Linux, bytes on macOS)
+		rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+		peak = usage.ru_maxrss;
+#else
+		peak = usage.ru_maxrss * 1024;
+#endif
+	}
+	return peak;
+}
+
+bool Benchmark::resetPeakMemory() {
+	// Writing 5 to clear_refs resets the peak resident set size (Linux 4.0+)
+	std::ofstream clear_refs("/proc/self/clear_refs");
+	return clear_refs.is_open() && (clear_refs << "5").good();
+}
+#endif
+
+#ifdef __linux__
+Benchmark::CacheMisses::CacheMisses() {
+	perf_event_attr attr{};
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+Benchmark::CacheMisses::~CacheMisses() {
+	if (fd >= 0) close(fd);
+}
+
+long long Benchmark::CacheMisses::count() const {
+	long long misses = 0;
+	if (fd < 0 || read(fd, &misses, sizeof(misses)) != sizeof(misses)) return -1;
+	return misses;
+}
+#else
+Benchmark::CacheMisses::CacheMisses() {}
+
+Benchmark::CacheMisses::~CacheMisses() {}
+
+long long Benchmark::CacheMisses::count() const {
+	return -1;
+}
+#endif
+
+void Benchmark::ingest(const std::string& file_path) {
+	std::error_code ec;
+	uintmax_t file_size = std::filesystem::file_size(file_path, ec);
+	if (ec) {
+		std::cerr << "Error: Could not open file " << file_path << std::endl;
+		return;
+	}
+	double file_mb = file_size / (1024.0 * 1024.0);
+	std::cout << file_path << " (" << std::fixed << std::setprecision(1) << file_mb << " MB)\n";
+
+	// Streaming first, since peak memory can't be reset on every platform
+	// PBF files are always decoded the same way, so they only get one run
+	bool pbf = ParsePBF::isPBF(file_path);
+	std::vector<ParseMode> modes = { ParseMode::Streaming, ParseMode::Parallel, ParseMode::DOM };
+	if (pbf) modes = { ParseMode::Parallel };
+
+	for (ParseMode mode : modes) {
+		bool reset = resetPeakMemory();
+		size_t baseline = currentMemory();
+		size_t nodes, edges;
+		Timer timer;
+		{
+			Graph graph;
+			ParseOSM::loadMap(file_path, graph, mode);
+			nodes = graph.getNodeCount();
+			edges = graph.getEdges().size();
+		}
+		double ms = timer.elapsedMs();
+		size_t peak = peakMemory();
+
+		std::cout << "  " << std::left << std::setw(10) << (pbf ? "PBF" : modeName(mode)) << std::right
+			<< std::setw(9) << std::setprecision(1) << ms << " ms  "
+			<< std::setw(7) << file_mb / (ms / 1000.0) << " MB/s  "
+			<< "read " << file_mb << " MB  "
+			<< "peak +" << std::setw(7) << (peak > baseline ? peak - baseline : 0) / (1024.0 * 1024.0) << " MB"
+			<< (reset ? "" : " (peak not resettable)")
+			<< "  nodes " << nodes << ", edges " << edges << "\n";
+	}
+}
+
+void Benchmark::scaling(const std::string& file_path, unsigned max_threads) {
+	std::cout << file_path << ", parallel ingestion\n";
+	std::cout << "  threads        ms  speedup  efficiency\n";
+
+	// Powers of two up to max_threads, always ending at max_threads
+	std::vector<unsigned> thread_counts;
+	for (unsigned threads = 1; threads < max_threads; threads *= 2) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(std::max(1u, max_threads));
+
+	double single_ms = 0;
+	for (unsigned threads : thread_counts) {
+		Timer timer;
+		size_t edges;
+		{
+			Graph graph;
+			ParseOSM::loadMaps({ file_path }, graph, ParseMode::Parallel, false, threads);
+			edges = graph.getEdges().size();
+		}
+		double ms = timer.elapsedMs();
+		if (threads == 1) single_ms = ms;
+
+		std::cout << "  " << std::setw(7) << threads << std::setw(10) << std::fixed << std::setprecision(1) << ms
+			<< std::setw(8) << std::setprecision(2) << single_ms / ms << "x"
+			<< std::setw(11) << std::setprecision(0) << 100.0 * single_ms / ms / threads << "%"
+			<< "  (" << edges << " edges)\n";
+	}
+}
+
+void Benchmark::prune(const std::string& file_path) {
+	std::cout << file_path << "\n";
+	std::filesystem::path bin_path = std::filesystem::temp_directory_path() / "mapviewer_prune_bench.bin";
+
+	for (bool prune_nodes : { false, true }) {
+		Graph graph;
+		size_t dropped = ParseOSM::loadMap(file_path, graph, ParseMode::Streaming, prune_nodes);
+
+		graph.createAdj();
+		Binary::saveToBinary(bin_path.string(), graph);
+		std::error_code ec;
+		uintmax_t bin_size = std::filesystem::file_size(bin_path, ec);
+
+		std::cout << "  " << std::left << std::setw(10) << (prune_nodes ? "Pruned" : "All nodes") << std::right
+			<< "nodes " << std::setw(9) << graph.getNodeCount() << " (dropped " << dropped << ")  "
+			<< "edges " << graph.getEdges().size() << "  "
+			<< std::fixed << std::setprecision(1)
+			<< "node table " << std::setw(7) << graph.getNodeCount() * Graph::NODE_MEMORY / (1024.0 * 1024.0) << " MB  "
+			<< "binary " << std::setw(7) << bin_size / (1024.0 * 1024.0) << " MB\n";
+	}
+	std::filesystem::remove(bin_path);
+}
+
+void Benchmark::load(const std::string& file_path) {
+	Graph source;
+	if (!Binary::loadFromBinary(file_path, source)) {
+		return;
+	}
+	source.createAdj();
+
+	// Write the same graph in both formats, the files stay in the page cache so no run reads from disk
+	std::filesystem::path temp = std::filesystem::temp_directory_path();
+	std::string standard_path = (temp / "mapviewer_load_bench.bin").string();
+	std::string mapped_path = (temp / "mapviewer_load_bench_mapped.bin").string();
+	std::string compact_path = (temp / "mapviewer_load_bench_compact.bin").string();
+	Binary::saveToBinary(standard_path, source, 0, 0, BinaryFormat::Standard);
+	Binary::saveToBinary(mapped_path, source, 0, 0, BinaryFormat::Mapped);
+	Binary::saveToBinary(compact_path, source, 0, 0, BinaryFormat::Compact);
+	source = Graph();
+
+	std::cout << file_path << ", " << std::fixed << std::setprecision(1)
+		<< "standard " << std::filesystem::file_size(standard_path) / (1024.0 * 1024.0) << " MB, "
+		<< "compact " << std::filesystem::file_size(compact_path) / (1024.0 * 1024.0) << " MB, "
+		<< "mapped " << std::filesystem::file_size(mapped_path) / (1024.0 * 1024.0) << " MB\n";
+	std::cout << "  format               load ms   first traversal ms   resident after load\n";
+
+	struct Run {
+		const char* name;
+		const std::string& path;
+		bool verify;
+	};
+	for (const Run& run : { Run{ "Standard", standard_path, true }, Run{ "Compact", compact_path, true },
+		Run{ "Mapped, verified", mapped_path, true }, Run{ "Mapped", mapped_path, false } }) {
+		size_t baseline = currentMemory();
+		Graph graph;
+		Timer timer;
+		Binary::loadFromBinary(run.path, graph, run.verify);
+		graph.createAdj();
+		double load_ms = timer.elapsedMs();
+		size_t resident = currentMemory();
+
+		// Visit every neighbor once, mapped pages not touched by loading are faulted in here
+		Timer traversal_timer;
+		double total_weight = 0;
+		for (int64_t id : graph.getArrays().node_ids) {
+			for (const auto& [neighbor, weight, edge_id] : graph.getNeighbors(id)) {
+				total_weight += weight;
+			}
+		}
+		double traversal_ms = traversal_timer.elapsedMs();
+
+		std::cout << "  " << std::left << std::setw(18) << run.name << std::right
+			<< std::setw(10) << load_ms << std::setw(21) << traversal_ms
+			<< std::setw(18) << (resident > baseline ? resident - baseline : 0) / (1024.0 * 1024.0) << " MB"
+			<< "  (" << graph.getEdges().size() << " edges, " << std::setprecision(0) << total_weight / 1000.0 << " km)"
+			<< std::setprecision(1) << "\n";
+	}
+	std::filesystem::remove(standard_path);
+	std::filesystem::remove(mapped_path);
+	std::filesystem::remove(compact_path);
+}
+
+void Benchmark::startup(const std::string& file_path) {
+	Graph source;
+	if (!Binary::loadFromBinary(file_path, source)) {
+		return;
+	}
+	source.createAdj();
+	Quadtree source_quadtree;
+	source_quadtree.build(source);
+
+	// Standard files store only the graph, mapped files can also store the adjacency list and quadtree
+	std::filesystem::path temp = std::filesystem::temp_directory_path();
+	std::string standard_path = (temp / "mapviewer_startup_bench.bin").string();
+	std::string graph_only_path = (temp / "mapviewer_startup_bench_graph.bin").string();
+	std::string mapped_path = (temp / "mapviewer_startup_bench_mapped.bin").string();
+	Binary::saveToBinary(standard_path, source, 0, 0, BinaryFormat::Standard);
+	Binary::saveToBinary(graph_only_path, source, 0, 0, BinaryFormat::Mapped);
+	Binary::saveToBinary(mapped_path, source, 0, 0, BinaryFormat::Mapped, &source_quadtree);
+	source = Graph();
+	source_quadtree = Quadtree();
+
+	std::cout << file_path << "\n";
+	std::cout << "  stored data                  load ms   adjacency ms   quadtree ms   total ms   first edges ms\n";
+
+	struct Run {
+		const char* name;
+		const std::string& path;
+	};
+	for (const Run& run : { Run{ "Graph", standard_path }, Run{ "Graph, adjacency", graph_only_path },
+		Run{ "Graph, adjacency, quadtree", mapped_path } }) {
+		Graph graph;
+		Quadtree quadtree;
+		Timer timer;
+		Binary::loadFromBinary(run.path, graph, true, &quadtree);
+		double load_ms = timer.elapsedMs();
+		graph.createAdj();
+		double adjacency_ms = timer.elapsedMs() - load_ms;
+
+		// The window draws edges as soon as the first chunk is projected, watch for it while the tree is built
+		double first_edges_ms = timer.elapsedMs();
+		if (quadtree.empty()) {
+			Quadtree::Progress progress;
+			std::thread builder([&]() { quadtree.build(graph, 4, &progress); });
+			while (progress.projected == 0 && graph.getEdges().size() > 0) {
+				std::this_thread::yield();
+			}
+			first_edges_ms = timer.elapsedMs();
+			builder.join();
+		}
+		double total_ms = timer.elapsedMs();
+
+		std::cout << "  " << std::left << std::setw(26) << run.name << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(10) << load_ms << std::setw(15) << adjacency_ms
+			<< std::setw(14) << total_ms - load_ms - adjacency_ms << std::setw(11) << total_ms
+			<< std::setw(17) << first_edges_ms << "  (" << quadtree.getCells().size() << " cells)\n";
+	}
+	std::filesystem::remove(standard_path);
+	std::filesystem::remove(graph_only_path);
+	std::filesystem::remove(mapped_path);
+}
+
+void Benchmark::tiles(const std::string& file_path, size_t budget_mb, unsigned int grid) {
+	Graph source;
+	if (!Binary::loadFromBinary(file_path, source)) {
+		return;
+	}
+	source.createAdj();
+	source.partitionTiles(grid);
+	Quadtree source_quadtree;
+	source_quadtree.build(source);
+	std::string tiled_path = (std::filesystem::temp_directory_path() / "mapviewer_tiles_bench.bin").string();
+	Binary::saveToBinary(tiled_path, source, 0, 0, BinaryFormat::Tiled, &source_quadtree);
+	size_t num_tiles = source.getArrays().tiles.size();
+	source = Graph();
+	source_quadtree = Quadtree();
+
+	std::cout << file_path << ", " << num_tiles << " tiles, " << std::fixed << std::setprecision(1)
+		<< std::filesystem::file_size(tiled_path) / (1024.0 * 1024.0) << " MB tiled\n";
+	std::cout << "  budget            pan ms   peak resident   loaded tiles   route ms   resident after route\n";
+
+	for (size_t budget : { std::numeric_limits<size_t>::max(), budget_mb * 1024 * 1024 }) {
+		size_t baseline = currentMemory();
+		Graph graph;
+		Quadtree quadtree;
+		Binary::loadFromBinary(tiled_path, graph, verify_mapped, &quadtree); // As the app loads it
+		auto cache = std::make_shared<TileCache>(graph, budget);
+		cache->addEdgeArray(quadtree.getSegments().data(), sizeof(Quadtree::Segment));
+		graph.setTileCache(cache);
+
+		// Pan a view of an eighth of the map row by row, reading every edge in view as drawing does
+		constexpr int steps = 8;
+		size_t peak = 0, drawn = 0;
+		volatile double sink = 0; // Keeps the reads of the coordinates
+		std::vector<uint32_t> ids;
+		Timer pan_timer;
+		for (int row = 0; row < steps; ++row) {
+			for (int col = 0; col < steps; ++col) {
+				Quadtree::Bounds view = { float(col) / steps, float(row) / steps, float(col + 1) / steps, float(row + 1) / steps };
+				graph.loadTiles(Quadtree::toEarth(graph.bbox, view));
+				ids.clear();
+				quadtree.query(view, ids);
+				for (uint32_t id : ids) {
+					const Quadtree::Segment& segment = quadtree.getSegments()[id];
+					const Graph::Edge& edge = graph.getEdge(id);
+					sink = sink + segment.from.x + graph.getNode(edge.from).lat + graph.getNode(edge.to).lon;
+				}
+				drawn += ids.size();
+				peak = std::max(peak, currentMemory());
+			}
+		}
+		double pan_ms = pan_timer.elapsedMs();
+		size_t loaded_tiles = cache->getLoadedTiles();
+
+		// Route between the first and the last tile, which lie in opposite corners of the Z curve
+		const Graph::Arrays& arrays = graph.getArrays();
+		std::vector<uint32_t> path;
+		std::vector<bool> path_lookup(graph.getEdges().size(), false);
+		double distance = 0;
+		Timer route_timer;
+		Algorithm::runAstar(graph, arrays.node_ids[0], arrays.node_ids[arrays.node_ids.size() - 1], path, path_lookup, distance);
+		double route_ms = route_timer.elapsedMs();
+		size_t after_route = currentMemory();
+
+		auto above = [baseline](size_t bytes) { return (bytes > baseline ? bytes - baseline : 0) / (1024.0 * 1024.0); };
+		std::cout << "  " << std::left << std::setw(14);
+		if (budget == std::numeric_limits<size_t>::max()) {
+			std::cout << "none";
+		}
+		else {
+			std::cout << std::to_string(budget_mb) + " MB";
+		}
+		std::cout << std::right << std::setw(10) << pan_ms << std::setw(13) << above(peak) << " MB"
+			<< std::setw(15) << loaded_tiles << std::setw(11) << route_ms << std::setw(20) << above(after_route) << " MB"
+			<< "  (" << drawn << " edges drawn, route " << path.size() << " edges, " << std::setprecision(0) << distance / 1000.0 << " km)"
+			<< std::setprecision(1) << "\n";
+	}
+	std::filesystem::remove(tiled_path);
+}
+
+// Way filter as it was before TagFilter, kept as the baseline of the tags benchmark
+static bool legacyIsValidWay(const std::string& key, const std::string& value) {
+	static const std::unordered_set<std::string> non_routable_keys = {
+		"boundary", "building", "landuse", "waterway", "vessel", "ferry",
+		"seamark:type"
+	};
+
+	if (non_routable_keys.count(key)) return false;
+	if (key == "area" && value == "yes") return false;
+	if (key == "access" && (value == "private" || value == "no")) return false;
+	if (key == "highway" && value == "proposed") return false;
+	if (key == "route" && (value == "boat" || value == "ferry" || value == "ship" || value == "seaway")) return false;
+	if (key == "highway" && (value == "ferry" || value == "path")) return false;
+	if (key == "service" && value == "ferry") return false;
+	if (key == "motorboat" && (value == "yes" || value == "designated")) return false;
+	if (key == "transport_mode" && (value == "boat" || value == "ship")) return false;
+	if ((key == "tunnel" && (value == "yes" || value == "culvert")) ||
+		(key == "covered" && value == "yes") ||
+		(key == "location" && (value == "underground" || value == "underwater"))) {
+		return false;
+	}
+	if (key == "route" && (
+		value == "bus" || value == "trolleybus" || value == "tram" || value == "subway" ||
+		value == "train" || value == "light_rail" || value == "monorail")) {
+		return false;
+	}
+	if (key == "public_transport" && (value == "platform" || value == "stop_position")) return false;
+	if (key == "railway" && (
+		value == "subway" || value == "tram" || value == "light_rail" || value == "monorail")) {
+		return false;
+	}
+	return true;
+}
+
+void Benchmark::tags(size_t way_count) {
+	// Tags commonly found on ways, plus every key and value the filter knows about
+	std::vector<std::pair<std::string, std::string>> tag_pool = {
+		{ "highway", "residential" }, { "highway", "service" }, { "highway", "footway" }, { "highway", "primary" },
+		{ "highway", "tertiary" }, { "highway", "cycleway" }, { "name", "Hämeenkatu" }, { "name", "Satakunnankatu" },
+		{ "surface", "asphalt" }, { "surface", "paved" }, { "maxspeed", "30" }, { "maxspeed", "50" },
+		{ "lanes", "2" }, { "oneway", "yes" }, { "lit", "yes" }, { "sidewalk", "both" }, { "source", "survey" },
+		{ "building", "yes" }, { "building", "apartments" }, { "addr:street", "Hämeenkatu" }, { "addr:housenumber", "12" },
+		{ "landuse", "residential" }, { "natural", "water" }, { "area", "no" }, { "access", "yes" }
+	};
+	for (const auto& rule : TagFilter::rules) {
+		tag_pool.emplace_back(std::string(rule.key), rule.value.empty() ? "yes" : std::string(rule.value));
+	}
+
+	// Filters must agree on every combination of known keys and values
+	size_t mismatches = 0, checked = 0;
+	for (const auto& [key, unused] : tag_pool) {
+		for (const auto& [unused_key, value] : tag_pool) {
+			mismatches += legacyIsValidWay(key, value) != TagFilter::isValidTag(key, value);
+			++checked;
+		}
+	}
+
+	// Build ways of 2-8 tags and 2-20 node references as they appear in the file buffer
+	std::mt19937 rng(42);
+	std::vector<std::vector<std::pair<std::string_view, std::string_view>>> way_tags(way_count);
+	std::vector<std::vector<std::string>> way_refs(way_count);
+	for (size_t i = 0; i < way_count; ++i) {
+		size_t tag_count = 2 + rng() % 7;
+		for (size_t t = 0; t < tag_count; ++t) {
+			const auto& [key, value] = tag_pool[rng() % tag_pool.size()];
+			way_tags[i].emplace_back(key, value);
+		}
+		size_t ref_count = 2 + rng() % 19;
+		for (size_t r = 0; r < ref_count; ++r) {
+			way_refs[i].push_back(std::to_string(20000000 + rng() % 9000000000ULL));
+		}
+	}
+
+	// Before: every tag copied into two strings, references through std::string and std::stoll
+	size_t valid_before = 0;
+	int64_t sink_before = 0;
+	Timer before_timer;
+	for (size_t i = 0; i < way_count; ++i) {
+		bool is_valid = true;
+		for (const auto& [key_view, value_view] : way_tags[i]) {
+			std::string key = std::string(key_view);
+			std::string value = std::string(value_view);
+			if (!legacyIsValidWay(key, value)) {
+				is_valid = false;
+				break;
+			}
+		}
+		if (!is_valid) continue;
+		++valid_before;
+		for (const auto& ref : way_refs[i]) {
+			sink_before += std::stoll(std::string(std::string_view(ref)));
+		}
+	}
+	double before_ms = before_timer.elapsedMs();
+
+	// After: perfect hash lookup on views, references decoded in place
+	size_t valid_after = 0;
+	int64_t sink_after = 0;
+	Timer after_timer;
+	for (size_t i = 0; i < way_count; ++i) {
+		bool is_valid = true;
+		for (const auto& [key, value] : way_tags[i]) {
+			if (!TagFilter::isValidTag(key, value)) {
+				is_valid = false;
+				break;
+			}
+		}
+		if (!is_valid) continue;
+		++valid_after;
+		for (const auto& ref : way_refs[i]) {
+			int64_t value = 0;
+			std::from_chars(ref.data(), ref.data() + ref.size(), value);
+			sink_after += value;
+		}
+	}
+	double after_ms = after_timer.elapsedMs();
+
+	std::cout << way_count << " ways, " << valid_before << " pass the filter\n"
+		<< "  filter check: " << checked << " key/value pairs, " << mismatches << " mismatches\n"
+		<< std::fixed << std::setprecision(1)
+		<< "  before " << std::setw(8) << before_ms * 1e6 / way_count << " ns/way\n"
+		<< "  after  " << std::setw(8) << after_ms * 1e6 / way_count << " ns/way  ("
+		<< std::setprecision(2) << before_ms / after_ms << "x)\n";
+	if (valid_before != valid_after || sink_before != sink_after) {
+		std::cout << "  Results differ!\n";
+	}
+}
+
+// Adjacency and A* as they were before compressed sparse rows, kept as the baseline of the route benchmark
+// Every node had its own neighbor vector in a hash map, and the search hashed OSM IDs at every step
+using LegacyAdjacency = std::unordered_map<int64_t, std::vector<std::tuple<int64_t, double, uint32_t>>>;
+
+static double legacyAstar(const LegacyAdjacency& adj_list, const std::unordered_map<int64_t, Graph::Node>& nodes,
+	const Graph& graph, int64_t source, int64_t target, size_t& path_edges) {
+	using QueueEntry = std::tuple<double, double, int64_t>; // f, g, node ID
+	std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> pq;
+	std::unordered_map<int64_t, double> dist;
+	std::unordered_map<int64_t, std::tuple<int64_t, double, uint32_t>> prev;
+	const Graph::Node& target_node = nodes.at(target);
+
+	pq.push({ graph.getHaversineDistance(nodes.at(source), target_node), 0, source });
+	dist[source] = 0;
+	while (!pq.empty()) {
+		auto [f, g_current, id] = pq.top();
+		pq.pop();
+		if (id == target) {
+			double distance = 0;
+			for (int64_t at = target; at != source; at = std::get<0>(prev[at])) {
+				distance += std::get<1>(prev[at]);
+				++path_edges;
+			}
+			return distance;
+		}
+		if (g_current > dist[id]) continue;
+
+		auto it = adj_list.find(id);
+		if (it == adj_list.end()) continue;
+		for (const auto& [neighbor, weight, edge_id] : it->second) {
+			double g = g_current + weight;
+			if (dist.find(neighbor) == dist.end() || g < dist[neighbor]) {
+				dist[neighbor] = g;
+				pq.push({ g + graph.getHaversineDistance(nodes.at(neighbor), target_node), g, neighbor });
+				prev[neighbor] = { id, weight, edge_id };
+			}
+		}
+	}
+	return 0;
+}
+
+std::vector<std::pair<int64_t, int64_t>> Benchmark::randomPairs(const Graph& graph, size_t queries,
+	const std::vector<uint32_t>& from, const std::vector<uint32_t>& to) {
+	std::vector<std::pair<int64_t, int64_t>> pairs(queries);
+	size_t nodes = graph.getNodeCount();
+	if (nodes == 0) return {};
+	std::mt19937 rng(7);
+	std::uniform_int_distribution<size_t> pick_from(0, (from.empty() ? nodes : from.size()) - 1);
+	std::uniform_int_distribution<size_t> pick_to(0, (to.empty() ? nodes : to.size()) - 1);
+	for (auto& pair : pairs) {
+		size_t first = pick_from(rng);
+		size_t second = pick_to(rng);
+		pair = { graph.getNodeId(static_cast<uint32_t>(from.empty() ? first : from[first])),
+			graph.getNodeId(static_cast<uint32_t>(to.empty() ? second : to[second])) };
+	}
+	return pairs;
+}
+
+std::vector<uint32_t> Benchmark::largestComponent(const Graph& graph) {
+	std::vector<uint32_t> largest;
+	for (uint32_t i = 0; i < graph.getNodeCount(); ++i) {
+		if (graph.getComponent(i) == 0) largest.push_back(i);
+	}
+	return largest;
+}
+
+Benchmark::Routes Benchmark::runRoutes(Graph& graph, const std::vector<std::pair<int64_t, int64_t>>& pairs) {
+	Routes routes;
+	routes.paths.resize(pairs.size());
+	routes.distances.resize(pairs.size());
+	std::vector<bool> path_lookup(graph.getEdges().size(), false);
+	Timer timer;
+	for (size_t i = 0; i < pairs.size(); ++i) {
+		Algorithm::runAstar(graph, pairs[i].first, pairs[i].second, routes.paths[i], path_lookup, routes.distances[i]);
+		routes.settled += Algorithm::getSettledCount();
+		routes.found += !routes.paths[i].empty();
+		for (uint32_t id : routes.paths[i]) path_lookup[id] = false;
+	}
+	routes.ms_per_route = timer.elapsedMs() / std::max<size_t>(pairs.size(), 1);
+	return routes;
+}
+
+size_t Benchmark::countMismatches(const std::vector<double>& expected, const std::vector<double>& distances) {
+	size_t mismatches = 0;
+	for (size_t i = 0; i < expected.size(); ++i) {
+		mismatches += std::abs(expected[i] - distances[i]) > 1e-6 * std::max(1.0, expected[i]);
+	}
+	return mismatches;
+}
+
+void Benchmark::route(const std::string& file_path, size_t queries) {
+	Graph graph;
+	if (!Binary::loadFromBinary(file_path, graph)) {
+		return;
+	}
+	graph.createAdj();
+	const Graph::Arrays& arrays = graph.getArrays();
+	if (arrays.node_ids.empty()) return;
+
+	// Before: nodes and neighbor vectors in hash maps keyed by OSM ID
+	size_t baseline = currentMemory();
+	std::unordered_map<int64_t, Graph::Node> nodes;
+	LegacyAdjacency adj_list;
+	for (uint32_t index = 0; index < arrays.node_ids.size(); ++index) {
+		int64_t id = arrays.node_ids[index];
+		nodes[id] = graph.getNodeAt(index);
+		auto& neighbors = adj_list[id];
+		for (const auto& [neighbor, weight, edge_id] : graph.getNeighborsAt(index)) {
+			neighbors.emplace_back(arrays.node_ids[neighbor], weight, edge_id);
+		}
+	}
+	size_t legacy_bytes = currentMemory() > baseline ? currentMemory() - baseline : 0;
+
+	// After: sorted IDs for lookups, coordinates and the adjacency rows in flat arrays
+	size_t neighbors = arrays.adj_targets.size();
+	size_t csr_bytes = arrays.node_ids.size() * Graph::NODE_MEMORY + sizeof(uint32_t) +
+		neighbors * (sizeof(uint32_t) + sizeof(double) + sizeof(uint32_t));
+	size_t id_target_bytes = neighbors * (sizeof(int64_t) - sizeof(uint32_t));
+
+	auto pairs = randomPairs(graph, queries);
+	std::vector<double> before_distances(queries);
+	size_t before_edges = 0, after_edges = 0;
+	Timer before_timer;
+	for (size_t i = 0; i < queries; ++i) {
+		before_distances[i] = legacyAstar(adj_list, nodes, graph, pairs[i].first, pairs[i].second, before_edges);
+	}
+	double before_ms = before_timer.elapsedMs() / queries;
+
+	Routes after = runRoutes(graph, pairs);
+	for (const auto& path : after.paths) after_edges += path.size();
+	size_t mismatches = countMismatches(before_distances, after.distances);
+
+	std::cout << file_path << ", " << arrays.node_ids.size() << " nodes, " << graph.getEdges().size() << " edges, "
+		<< queries << " routes\n" << std::fixed << std::setprecision(1)
+		<< "  graph memory: hash maps " << legacy_bytes / (1024.0 * 1024.0) << " MB, CSR "
+		<< csr_bytes / (1024.0 * 1024.0) << " MB (" << id_target_bytes / (1024.0 * 1024.0) << " MB more with OSM ID targets)\n"
+		<< std::setprecision(3)
+		<< "  before " << std::setw(9) << before_ms << " ms/route\n"
+		<< "  after  " << std::setw(9) << after.ms_per_route << " ms/route  ("
+		<< std::setprecision(2) << before_ms / after.ms_per_route << "x)\n";
+	if (mismatches > 0 || before_edges != after_edges) {
+		std::cout << "  " << mismatches << " routes differ!\n";
+	}
+}
+
+// Hash functions of Edge for the standard containers in the hash benchmark
+// The XOR one is what Graph used before the flat tables, an edge and its reverse always collide with it
+struct XorEdgeHash {
+	size_t operator()(const Graph::Edge& edge) const {
+		return std::hash<int64_t>()(edge.from) ^ std::hash<int64_t>()(edge.to);
+	}
+};
+struct MixedEdgeHash {
+	size_t operator()(const Graph::Edge& edge) const { return static_cast<size_t>(Graph::EdgeTraits::hash(edge)); }
+};
+
+// Allocator that counts the bytes the standard containers of the hash benchmark hold
+// Allocation overhead of the heap itself isn't included
+static size_t counted_bytes = 0;
+template <typename T>
+struct CountingAllocator {
+	using value_type = T;
+	CountingAllocator() = default;
+	template <typename U>
+	CountingAllocator(const CountingAllocator<U>&) {}
+	T* allocate(size_t n) {
+		counted_bytes += n * sizeof(T);
+		return std::allocator<T>().allocate(n);
+	}
+	void deallocate(T* p, size_t n) {
+		counted_bytes -= n * sizeof(T);
+		std::allocator<T>().deallocate(p, n);
+	}
+	template <typename U>
+	bool operator==(const CountingAllocator<U>&) const { return true; }
+};
+
+void Benchmark::hash(const std::string& file_path) {
+	Graph graph;
+	if (!Binary::loadFromBinary(file_path, graph)) {
+		return;
+	}
+	graph.createAdj();
+	const Graph::Arrays& arrays = graph.getArrays();
+
+	// Nodes are inserted in a shuffled order, as they come from several files and blocks when parsing
+	std::mt19937 rng(7);
+	std::vector<int64_t> ids(arrays.node_ids.begin(), arrays.node_ids.end());
+	std::shuffle(ids.begin(), ids.end(), rng);
+
+	// Edge keys as parsing sees them: every edge, its reverse, and every edge again as a duplicate
+	std::vector<Graph::Edge> edge_keys;
+	for (const Graph::Edge& edge : graph.getEdges()) {
+		edge_keys.push_back(edge);
+		edge_keys.push_back({ edge.to, edge.from });
+	}
+	edge_keys.insert(edge_keys.end(), graph.getEdges().begin(), graph.getEdges().end());
+	std::vector<Graph::Edge> lookups = edge_keys;
+	std::shuffle(lookups.begin(), lookups.end(), rng);
+
+	// Nodes are looked up as the endpoints of the edges, the way edges are checked when they are added
+	std::vector<int64_t> node_lookups;
+	for (const Graph::Edge& edge : graph.getEdges()) {
+		node_lookups.push_back(edge.from);
+		node_lookups.push_back(edge.to);
+	}
+
+	std::cout << file_path << ", " << ids.size() << " nodes, " << edge_keys.size()
+		<< " edge keys (edges, their reverses and every edge again)\n"
+		<< "  table                                 ingest ms   lookups/us   memory   average probe   longest probe\n"
+		<< std::fixed;
+
+	auto report = [](const char* name, double ingest_ms, size_t lookups, double lookup_ms, size_t bytes, double average, size_t longest) {
+		std::cout << "  " << std::left << std::setw(36) << name << std::right << std::setprecision(1)
+			<< std::setw(11) << ingest_ms << std::setw(13) << lookups / (lookup_ms * 1000.0)
+			<< std::setw(6) << bytes / (1024.0 * 1024.0) << " MB" << std::setprecision(2)
+			<< std::setw(16) << average << std::setw(16) << longest << "\n";
+	};
+
+	// Buckets of the standard containers are chains, probing one reads every entry in its bucket
+	auto chain_stats = [](const auto& table, double& average, size_t& longest) {
+		size_t total = 0;
+		longest = 0;
+		for (size_t bucket = 0; bucket < table.bucket_count(); ++bucket) {
+			size_t size = table.bucket_size(bucket);
+			total += size * (size - (size > 0)) / 2; // Entries before each entry of the chain
+			longest = std::max(longest, size > 0 ? size - 1 : 0);
+		}
+		average = table.empty() ? 0 : static_cast<double>(total) / table.size();
+	};
+
+	size_t found = 0;
+	{
+		counted_bytes = 0;
+		Timer ingest_timer;
+		std::unordered_map<int64_t, Graph::FixedNode, std::hash<int64_t>, std::equal_to<int64_t>,
+			CountingAllocator<std::pair<const int64_t, Graph::FixedNode>>> nodes;
+		for (int64_t id : ids) nodes[id] = { 0, 0 };
+		double ingest_ms = ingest_timer.elapsedMs();
+		Timer lookup_timer;
+		for (int64_t id : node_lookups) found += nodes.count(id);
+		double lookup_ms = lookup_timer.elapsedMs();
+		double average;
+		size_t longest;
+		chain_stats(nodes, average, longest);
+		report("nodes  std::unordered_map", ingest_ms, node_lookups.size(), lookup_ms, counted_bytes, average, longest);
+	}
+	{
+		Timer ingest_timer;
+		FlatHashMap<int64_t, Graph::FixedNode, IdTraits> nodes;
+		for (int64_t id : ids) nodes[id] = { 0, 0 };
+		double ingest_ms = ingest_timer.elapsedMs();
+		Timer lookup_timer;
+		for (int64_t id : node_lookups) found += nodes.contains(id);
+		double lookup_ms = lookup_timer.elapsedMs();
+		auto stats = nodes.probeStats();
+		size_t bytes = nodes.capacity() * sizeof(FlatHashMap<int64_t, Graph::FixedNode, IdTraits>::Slot);
+		report("nodes  FlatHashMap", ingest_ms, node_lookups.size(), lookup_ms, bytes, stats.average, stats.longest);
+	}
+
+	auto standard_edges = [&](auto table, const char* name) {
+		counted_bytes = 0;
+		Timer ingest_timer;
+		for (const Graph::Edge& edge : edge_keys) {
+			table.insert(edge);
+		}
+		double ingest_ms = ingest_timer.elapsedMs();
+		size_t bytes = counted_bytes;
+		Timer lookup_timer;
+		for (const Graph::Edge& edge : lookups) found += table.count(edge);
+		double lookup_ms = lookup_timer.elapsedMs();
+		double average;
+		size_t longest;
+		chain_stats(table, average, longest);
+		report(name, ingest_ms, lookups.size(), lookup_ms, bytes, average, longest);
+	};
+	using EdgeAllocator = CountingAllocator<Graph::Edge>;
+	standard_edges(std::unordered_set<Graph::Edge, XorEdgeHash, std::equal_to<Graph::Edge>, EdgeAllocator>(),
+		"edges  std::unordered_set, XOR hash");
+	standard_edges(std::unordered_set<Graph::Edge, MixedEdgeHash, std::equal_to<Graph::Edge>, EdgeAllocator>(),
+		"edges  std::unordered_set, mixed hash");
+	{
+		Timer ingest_timer;
+		FlatHashSet<Graph::Edge, Graph::EdgeTraits> edges;
+		edges.reserve(edge_keys.size());
+		for (const Graph::Edge& edge : edge_keys) {
+			edges.insert(edge);
+		}
+		double ingest_ms = ingest_timer.elapsedMs();
+		Timer lookup_timer;
+		for (const Graph::Edge& edge : lookups) found += edges.contains(edge);
+		double lookup_ms = lookup_timer.elapsedMs();
+		auto stats = edges.probeStats();
+		size_t bytes = edges.capacity() * sizeof(FlatHashSet<Graph::Edge, Graph::EdgeTraits>::Slot);
+		report("edges  FlatHashSet, batch", ingest_ms, lookups.size(), lookup_ms, bytes, stats.average, stats.longest);
+	}
+
+	// Every lookup is of a key that was inserted
+	if (found != 2 * node_lookups.size() + 3 * lookups.size()) {
+		std::cout << "  Lookups missed keys!\n";
+	}
+}
+
+void Benchmark::weights(const std::string& file_path) {
+	Graph graph;
+	if (!Binary::loadFromBinary(file_path, graph)) {
+		return;
+	}
+	graph.createAdj();
+	const Graph::Arrays& arrays = graph.getArrays();
+	const FlatArray<Graph::Edge>& edges = graph.getEdges();
+	if (edges.empty()) return;
+
+	// Endpoint indices as createAdj has them, and gathered coordinates for the kernel on its own
+	std::vector<uint32_t> pairs(edges.size() * 2);
+	std::vector<int32_t> lat1(edges.size()), lon1(edges.size()), lat2(edges.size()), lon2(edges.size());
+	for (size_t i = 0; i < edges.size(); ++i) {
+		pairs[2 * i] = static_cast<uint32_t>(graph.findIndex(edges[i].from));
+		pairs[2 * i + 1] = static_cast<uint32_t>(graph.findIndex(edges[i].to));
+		lat1[i] = arrays.node_lats[pairs[2 * i]];
+		lon1[i] = arrays.node_lons[pairs[2 * i]];
+		lat2[i] = arrays.node_lats[pairs[2 * i + 1]];
+		lon2[i] = arrays.node_lons[pairs[2 * i + 1]];
+	}
+
+	// Repeat small maps so that every timing covers a few million edges
+	size_t rounds = std::max<size_t>(1, 4000000 / edges.size());
+	std::vector<double> reference(edges.size()), out(edges.size());
+
+	// Before: one call per edge with the math library
+	Timer scalar_timer;
+	for (size_t round = 0; round < rounds; ++round) {
+		for (size_t i = 0; i < edges.size(); ++i) {
+			reference[i] = graph.getHaversineDistance(graph.getNodeAt(pairs[2 * i]), graph.getNodeAt(pairs[2 * i + 1]));
+		}
+	}
+	double scalar_ms = scalar_timer.elapsedMs();
+
+	std::cout << file_path << ", " << edges.size() << " edges, " << rounds << " rounds, "
+		<< Parallel::threadCount() << " threads, AVX2 " << (Haversine::hasSimd() ? "yes" : "no") << "\n";
+	auto report = [&](const char* name, double ms) {
+		double largest = 0;
+		for (size_t i = 0; i < edges.size(); ++i) {
+			largest = std::max(largest, std::abs(out[i] - reference[i]));
+		}
+		std::cout << "  " << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(8) << edges.size() * rounds / (ms * 1000.0) << " M edges/s  ("
+			<< std::setprecision(2) << scalar_ms / ms << "x)  max difference "
+			<< std::scientific << std::setprecision(1) << largest << " m" << std::defaultfloat << "\n";
+		if (largest > Haversine::TOLERANCE) {
+			std::cout << "  Above tolerance of " << Haversine::TOLERANCE << " m!\n";
+		}
+	};
+	out = reference;
+	report("getHaversineDistance", scalar_ms);
+
+	// After: the batch kernel, portable and AVX2, then with gathering and threads as createAdj runs it
+	Timer portable_timer;
+	for (size_t round = 0; round < rounds; ++round) {
+		Haversine::distances(lat1.data(), lon1.data(), lat2.data(), lon2.data(), edges.size(), out.data(), false);
+	}
+	report("kernel, portable", portable_timer.elapsedMs());
+
+	if (Haversine::hasSimd()) {
+		Timer simd_timer;
+		for (size_t round = 0; round < rounds; ++round) {
+			Haversine::distances(lat1.data(), lon1.data(), lat2.data(), lon2.data(), edges.size(), out.data());
+		}
+		report("kernel, AVX2", simd_timer.elapsedMs());
+	}
+
+	Timer single_timer;
+	for (size_t round = 0; round < rounds; ++round) {
+		graph.getHaversineDistances(pairs.data(), edges.size(), out.data(), 1);
+	}
+	report("getHaversineDistances, 1 thread", single_timer.elapsedMs());
+
+	Timer parallel_timer;
+	for (size_t round = 0; round < rounds; ++round) {
+		graph.getHaversineDistances(pairs.data(), edges.size(), out.data());
+	}
+	report("getHaversineDistances, all threads", parallel_timer.elapsedMs());
+}
+
+void Benchmark::chains(const std::string& file_path, size_t queries) {
+	Graph graph;
+	if (!Binary::loadFromBinary(file_path, graph)) {
+		return;
+	}
+	graph.createAdj();
+	const Graph::Arrays& arrays = graph.getArrays();
+	if (arrays.node_ids.empty()) return;
+
+	Timer build_timer;
+	auto routing = std::make_shared<RoutingGraph>();
+	routing->build(graph);
+	double build_ms = build_timer.elapsedMs();
+
+	// Route every pair on the full graph, then on the routing graph
+	auto pairs = randomPairs(graph, queries);
+	Routes full = runRoutes(graph, pairs);
+	graph.setRoutingGraph(routing);
+	Routes contracted = runRoutes(graph, pairs);
+
+	// Equal routes may be found in either, so paths only count as different if their lengths differ too
+	size_t mismatches = countMismatches(full.distances, contracted.distances), different_paths = 0;
+	for (size_t i = 0; i < queries; ++i) {
+		std::sort(full.paths[i].begin(), full.paths[i].end());
+		std::sort(contracted.paths[i].begin(), contracted.paths[i].end());
+		different_paths += full.paths[i] != contracted.paths[i];
+	}
+
+	size_t nodes = graph.getNodeCount(), edges = graph.getEdges().size();
+	std::cout << file_path << ", " << queries << " routes\n" << std::fixed << std::setprecision(1)
+		<< "  nodes " << nodes << " -> " << routing->getJunctionCount() << " ("
+		<< 100.0 * routing->getJunctionCount() / std::max<size_t>(nodes, 1) << "%)\n"
+		<< "  edges " << edges << " -> " << routing->getEdgeCount() << " ("
+		<< 100.0 * routing->getEdgeCount() / std::max<size_t>(edges, 1) << "%)\n"
+		<< "  built in " << build_ms << " ms, " << routing->memoryBytes() / (1024.0 * 1024.0) << " MB\n"
+		<< std::setprecision(3)
+		<< "  full graph    " << std::setw(9) << full.ms_per_route << " ms/route\n"
+		<< "  routing graph " << std::setw(9) << contracted.ms_per_route << " ms/route  ("
+		<< std::setprecision(2) << full.ms_per_route / contracted.ms_per_route << "x)\n";
+	if (mismatches > 0) {
+		std::cout << "  " << mismatches << " routes differ in length!\n";
+	}
+	else if (different_paths > 0) {
+		std::cout << "  " << different_paths << " routes took another path of the same length\n";
+	}
+}
+
+void Benchmark::compress(const std::string& file_path, size_t queries) {
+	Graph graph;
+	if (!Binary::loadFromBinary(file_path, graph)) {
+		return;
+	}
+	graph.createAdj();
+	if (graph.isTiled()) {
+		graph.releaseAdj();
+		graph.createAdj();
+	}
+	const Graph::Arrays& arrays = graph.getArrays();
+	if (arrays.node_ids.empty()) return;
+	size_t nodes = graph.getNodeCount(), edges = std::max<size_t>(graph.getEdges().size(), 1);
+
+	// Offsets per node, and a target, weight and edge ID per direction of every edge
+	double full_bytes = (nodes + 1) * sizeof(uint32_t) + arrays.adj_targets.size() * (2 * sizeof(uint32_t) + sizeof(double));
+	std::cout << file_path << ", " << nodes << " nodes, " << edges << " edges\n" << std::fixed << std::setprecision(2)
+		<< "  full adjacency        " << std::setw(6) << full_bytes / edges << " bytes/edge\n";
+
+	// Differences are smaller when neighbors are close in node order
+	auto packed = [&](const char* name) {
+		Timer timer;
+		auto compressed = std::make_shared<CompressedAdjacency>();
+		compressed->build(graph);
+		double build_ms = timer.elapsedMs();
+		std::cout << "  compressed, " << name << std::setw(6) << static_cast<double>(compressed->memoryBytes()) / edges
+			<< " bytes/edge, built in " << std::setprecision(1) << build_ms << " ms\n" << std::setprecision(2);
+		return compressed;
+	};
+	if (graph.isHilbertSorted()) {
+		graph.releaseAdj();
+		graph.createAdj();
+	}
+	packed("by ID   ");
+	graph.sortByHilbert();
+	auto compressed = packed("Hilbert ");
+
+	auto pairs = randomPairs(graph, queries);
+	Routes full = runRoutes(graph, pairs);
+	graph.setCompressedAdjacency(compressed);
+	Routes packed_routes = runRoutes(graph, pairs);
+
+	// Rounded up weights make routes a little longer, and may tip the choice between routes of nearly equal length
+	double longest_extra = 0;
+	size_t different_paths = 0;
+	for (size_t i = 0; i < queries; ++i) {
+		if (full.distances[i] > 0) {
+			longest_extra = std::max(longest_extra, 100.0 * (packed_routes.distances[i] / full.distances[i] - 1));
+		}
+		std::sort(full.paths[i].begin(), full.paths[i].end());
+		std::sort(packed_routes.paths[i].begin(), packed_routes.paths[i].end());
+		different_paths += full.paths[i] != packed_routes.paths[i];
+	}
+	std::cout << "  " << queries << " routes, " << full.found << " found\n" << std::setprecision(3)
+		<< "  full adjacency        " << std::setw(9) << full.ms_per_route << " ms/route\n"
+		<< "  compressed adjacency  " << std::setw(9) << packed_routes.ms_per_route << " ms/route  ("
+		<< std::setprecision(2) << packed_routes.ms_per_route / full.ms_per_route << "x)\n"
+		<< "  distances up to " << std::setprecision(3) << longest_extra << "% longer, "
+		<< different_paths << " routes took another path\n";
+}
+
+void Benchmark::live(const std::string& file_path, double seconds, size_t batch, double rate) {
+	Graph graph;
+	if (!Binary::loadFromBinary(file_path, graph)) {
+		return;
+	}
+	graph.createAdj();
+	graph.labelComponents();
+	const Graph::Arrays& arrays = graph.getArrays();
+	size_t edges = graph.getEdges().size();
+	if (arrays.node_ids.empty() || edges == 0) return;
+	auto weights = std::make_shared<EdgeWeights>(graph);
+	graph.setEdgeWeights(weights);
+
+	// Lengths of the edges, the writer changes weights to between one and three times them and closes some
+	std::vector<double> lengths(edges);
+	{
+		EdgeWeights::Snapshot snapshot(*weights);
+		for (uint32_t id = 0; id < edges; ++id) {
+			lengths[id] = snapshot->get(id);
+		}
+	}
+
+	// Readers route until stop is set, each keeping its latencies
+	unsigned readers = std::max(1u, Parallel::threadCount() - 1);
+	auto routeUntil = [&](std::atomic<bool>& stop, std::vector<std::vector<double>>& latencies) {
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < readers; ++t) {
+			threads.emplace_back([&, t]() {
+				std::mt19937 rng(t + 1);
+				std::uniform_int_distribution<size_t> pick(0, arrays.node_ids.size() - 1);
+				std::vector<uint32_t> path;
+				std::vector<bool> path_lookup(edges, false);
+				while (!stop.load()) {
+					double distance = 0;
+					path.clear();
+					Timer timer;
+					Algorithm::runAstar(graph, arrays.node_ids[pick(rng)], arrays.node_ids[pick(rng)], path, path_lookup, distance);
+					latencies[t].push_back(timer.elapsedMs());
+					for (uint32_t id : path) path_lookup[id] = false;
+				}
+			});
+		}
+		return threads;
+	};
+	auto report = [](const char* name, std::vector<std::vector<double>>& latencies, double elapsed_ms) {
+		std::vector<double> all;
+		for (const auto& thread_latencies : latencies) {
+			all.insert(all.end(), thread_latencies.begin(), thread_latencies.end());
+		}
+		if (all.empty()) return;
+		std::sort(all.begin(), all.end());
+		std::cout << "  " << name << std::setw(7) << all.size() << " routes, " << std::setw(8) << all.size() * 1000.0 / elapsed_ms
+			<< " routes/s, median " << std::setw(7) << all[all.size() / 2] << " ms, p99 " << std::setw(7)
+			<< all[std::min(all.size() - 1, all.size() * 99 / 100)] << " ms\n";
+	};
+
+	std::cout << file_path << ", " << edges << " edges, " << readers << " reader threads, "
+		<< batch << " changes per batch\n" << std::fixed << std::setprecision(3);
+	auto duration = std::chrono::duration<double>(seconds);
+
+	std::atomic<bool> stop{ false };
+	std::vector<std::vector<double>> quiet(readers);
+	Timer quiet_timer;
+	std::vector<std::thread> threads = routeUntil(stop, quiet);
+	std::this_thread::sleep_for(duration);
+	stop = true;
+	for (auto& thread : threads) thread.join();
+	report("no updates    ", quiet, quiet_timer.elapsedMs());
+
+	// Random changes, one in a hundred closes its edge
+	std::mt19937 update_rng(99);
+	std::uniform_int_distribution<uint32_t> pick_edge(0, static_cast<uint32_t>(edges - 1));
+	std::uniform_real_distribution<double> factor(1.0, 3.0);
+	std::vector<EdgeWeights::Update> updates(batch);
+	std::vector<double> apply_ms;
+	size_t most_retired = 0;
+	auto applyBatch = [&]() {
+		for (auto& update : updates) {
+			update.edge_id = pick_edge(update_rng);
+			update.weight = update_rng() % 100 == 0 ? std::numeric_limits<double>::infinity() : lengths[update.edge_id] * factor(update_rng);
+		}
+		Timer timer;
+		weights->apply(updates);
+		apply_ms.push_back(timer.elapsedMs());
+		most_retired = std::max(most_retired, weights->getRetiredCount());
+	};
+
+	// A writer applies batches at the rate while the readers route
+	stop = false;
+	std::vector<std::vector<double>> busy(readers);
+	Timer busy_timer;
+	threads = routeUntil(stop, busy);
+	std::thread writer([&]() {
+		auto next = std::chrono::steady_clock::now();
+		auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / rate));
+		while (!stop.load()) {
+			applyBatch();
+			next += interval;
+			std::this_thread::sleep_until(next);
+		}
+	});
+	std::this_thread::sleep_for(duration);
+	stop = true;
+	writer.join();
+	for (auto& thread : threads) thread.join();
+	report("with updates  ", busy, busy_timer.elapsedMs());
+	std::cout << "  " << apply_ms.size() << " batches applied meanwhile, " << most_retired << " versions waiting for readers at most\n";
+
+	// Batches back to back, apply time includes freeing the versions no reader can see
+	apply_ms.clear();
+	Timer apply_timer;
+	while (apply_timer.elapsedMs() < seconds * 1000) {
+		applyBatch();
+	}
+	double apply_total_ms = apply_timer.elapsedMs();
+	std::sort(apply_ms.begin(), apply_ms.end());
+	std::cout << "  updates alone " << std::setw(7) << apply_ms.size() << " batches, " << std::setprecision(0)
+		<< apply_ms.size() * batch * 1000.0 / apply_total_ms << " changes/s, " << std::setprecision(3)
+		<< "median " << apply_ms[apply_ms.size() / 2] << " ms per batch\n";
+}
+
+void Benchmark::components(const std::string& file_path, size_t queries) {
+	Graph graph;
+	if (!Binary::loadFromBinary(file_path, graph)) {
+		return;
+	}
+	graph.createAdj();
+	const Graph::Arrays& arrays = graph.getArrays();
+	if (arrays.node_ids.empty()) return;
+
+	Timer label_timer;
+	graph.labelComponents();
+	double label_ms = label_timer.elapsedMs();
+
+	size_t nodes = graph.getNodeCount(), count = graph.getComponentCount(), single = 0;
+	for (uint32_t c = 0; c < count; ++c) {
+		single += graph.getComponentSize(c) == 1;
+	}
+	std::cout << file_path << std::fixed << std::setprecision(1) << "\n"
+		<< "  " << count << " components, " << single << " of them single nodes, labeled in " << label_ms << " ms\n"
+		<< "  largest " << graph.getComponentSize(0) << " of " << nodes << " nodes ("
+		<< 100.0 * graph.getComponentSize(0) / nodes << "%)\n";
+
+	// Pairs from the largest component to any other
+	std::vector<uint32_t> largest, others;
+	for (uint32_t i = 0; i < nodes; ++i) {
+		(graph.getComponent(i) == 0 ? largest : others).push_back(i);
+	}
+	if (others.empty()) {
+		std::cout << "  Every node is in one component, no unreachable routes to time\n";
+		return;
+	}
+	auto pairs = randomPairs(graph, queries, largest, others);
+	Routes labeled = runRoutes(graph, pairs);
+
+	// Creating the adjacency again drops the labels, the nodes keep their indices
+	graph.releaseAdj();
+	graph.createAdj();
+	Routes full = runRoutes(graph, pairs);
+	auto routing = std::make_shared<RoutingGraph>();
+	routing->build(graph);
+	graph.setRoutingGraph(routing);
+	Routes contracted = runRoutes(graph, pairs);
+	size_t found = labeled.found + full.found + contracted.found;
+
+	std::cout << std::setprecision(4) << "  " << queries << " routes from the largest component to the others\n"
+		<< "  no labels, full graph    " << std::setw(10) << full.ms_per_route << " ms/route\n"
+		<< "  no labels, routing graph " << std::setw(10) << contracted.ms_per_route << " ms/route\n"
+		<< "  labeled                  " << std::setw(10) << labeled.ms_per_route << " ms/route\n";
+	if (found > 0) {
+		std::cout << "  " << found << " routes were found between components!\n";
+	}
+}
+
+void Benchmark::hierarchy(const std::string& file_path, size_t queries) {
+	Graph graph;
+	if (!Binary::loadFromBinary(file_path, graph)) {
+		return;
+	}
+	graph.createAdj();
+	graph.labelComponents();
+	const Graph::Arrays& arrays = graph.getArrays();
+	if (arrays.node_ids.empty()) return;
+
+	Timer build_timer;
+	auto hierarchy = std::make_shared<ContractionHierarchy>();
+	hierarchy->build(graph);
+	double build_ms = build_timer.elapsedMs();
+
+	std::string hierarchy_path = (std::filesystem::temp_directory_path() / "mapviewer_hierarchy_bench.ch").string();
+	hierarchy->save(hierarchy_path, graph);
+	std::error_code ec;
+	uintmax_t file_size = std::filesystem::file_size(hierarchy_path, ec);
+	Timer load_timer;
+	ContractionHierarchy loaded;
+	bool load_ok = loaded.load(hierarchy_path, graph);
+	double load_ms = load_timer.elapsedMs();
+	std::filesystem::remove(hierarchy_path);
+
+	std::vector<uint32_t> largest = largestComponent(graph);
+	auto pairs = randomPairs(graph, queries, largest, largest);
+	Routes full = runRoutes(graph, pairs);
+	auto routing = std::make_shared<RoutingGraph>();
+	routing->build(graph);
+	graph.setRoutingGraph(routing);
+	Routes routed = runRoutes(graph, pairs);
+	graph.setContractionHierarchy(hierarchy);
+	Routes contracted = runRoutes(graph, pairs);
+
+	// Equal routes may be found in either, so only the lengths are compared
+	size_t mismatches = countMismatches(full.distances, contracted.distances);
+
+	size_t edges = graph.getEdges().size();
+	std::cout << file_path << ", " << graph.getNodeCount() << " nodes, " << edges << " edges, " << queries << " routes\n"
+		<< std::fixed << std::setprecision(1)
+		<< "  built in " << build_ms << " ms, " << hierarchy->getShortcutCount() << " shortcuts ("
+		<< 100.0 * hierarchy->getShortcutCount() / std::max<size_t>(edges, 1) << "% of edges), "
+		<< hierarchy->memoryBytes() / (1024.0 * 1024.0) << " MB\n"
+		<< "  file " << file_size / (1024.0 * 1024.0) << " MB, " << (load_ok ? "loaded in " : "failed to load in ")
+		<< load_ms << " ms\n"
+		<< std::setprecision(3)
+		<< "  A*            " << std::setw(9) << full.ms_per_route << " ms/route\n"
+		<< "  routing graph " << std::setw(9) << routed.ms_per_route << " ms/route  ("
+		<< std::setprecision(2) << full.ms_per_route / routed.ms_per_route << "x)\n" << std::setprecision(3)
+		<< "  hierarchy     " << std::setw(9) << contracted.ms_per_route << " ms/route  ("
+		<< std::setprecision(2) << full.ms_per_route / contracted.ms_per_route << "x)\n";
+	if (mismatches > 0) {
+		std::cout << "  " << mismatches << " routes differ in length!\n";
+	}
+}
+
+void Benchmark::landmarks(const std::string& file_path, size_t queries, unsigned int count) {
+	Graph graph;
+	if (!Binary::loadFromBinary(file_path, graph)) {
+		return;
+	}
+	graph.createAdj();
+	graph.labelComponents();
+	const Graph::Arrays& arrays = graph.getArrays();
+	if (arrays.node_ids.empty()) return;
+
+	Timer farthest_timer;
+	auto farthest = std::make_shared<Landmarks>();
+	farthest->build(graph, count, LandmarkStrategy::Farthest);
+	double farthest_ms = farthest_timer.elapsedMs();
+	Timer avoid_timer;
+	auto avoid = std::make_shared<Landmarks>();
+	avoid->build(graph, count, LandmarkStrategy::Avoid);
+	double avoid_ms = avoid_timer.elapsedMs();
+
+	std::string landmark_path = (std::filesystem::temp_directory_path() / "mapviewer_landmarks_bench.alt").string();
+	avoid->save(landmark_path, graph);
+	std::error_code ec;
+	uintmax_t file_size = std::filesystem::file_size(landmark_path, ec);
+	Timer load_timer;
+	Landmarks loaded;
+	bool load_ok = loaded.load(landmark_path, graph, count, LandmarkStrategy::Avoid);
+	double load_ms = load_timer.elapsedMs();
+	std::filesystem::remove(landmark_path);
+
+	// Same pairs with each heuristic, distances checked against the Haversine runs
+	std::vector<uint32_t> largest = largestComponent(graph);
+	auto pairs = randomPairs(graph, queries, largest, largest);
+	std::vector<double> haversine_distances;
+	auto runWith = [&](const char* name, std::shared_ptr<const Landmarks> set) {
+		graph.setLandmarks(set);
+		Routes routes = runRoutes(graph, pairs);
+		if (!set) {
+			haversine_distances = routes.distances;
+		}
+		size_t mismatches = countMismatches(haversine_distances, routes.distances);
+		std::cout << "  " << std::left << std::setw(10) << name << std::right << std::setprecision(0)
+			<< std::setw(10) << static_cast<double>(routes.settled) / queries << " settled/route "
+			<< std::setprecision(3) << std::setw(9) << routes.ms_per_route << " ms/route\n";
+		if (mismatches > 0) {
+			std::cout << "  " << mismatches << " routes differ in length!\n";
+		}
+	};
+
+	size_t nodes = graph.getNodeCount();
+	std::cout << file_path << ", " << nodes << " nodes, " << queries << " routes in the largest component\n"
+		<< std::fixed << std::setprecision(1)
+		<< "  " << avoid->getCount() << " landmarks, " << avoid->memoryBytes() / (1024.0 * 1024.0) << " MB\n"
+		<< "  farthest computed in " << farthest_ms << " ms, avoid in " << avoid_ms << " ms on "
+		<< Parallel::threadCount() << " threads\n"
+		<< "  file " << file_size / (1024.0 * 1024.0) << " MB, " << (load_ok ? "loaded in " : "failed to load in ")
+		<< load_ms << " ms\n";
+	runWith("Haversine", nullptr);
+	runWith("farthest", farthest);
+	runWith("avoid", avoid);
+}
+
+void Benchmark::order(const std::string& file_path, size_t queries) {
+	// The same map in ID order and in Hilbert order
+	Graph by_id, by_hilbert;
+	if (!Binary::loadFromBinary(file_path, by_id) || !Binary::loadFromBinary(file_path, by_hilbert)) {
+		return;
+	}
+	by_id.createAdj();
+	by_hilbert.createAdj();
+	if (by_id.getNodeCount() == 0) return;
+	Timer sort_timer;
+	by_hilbert.sortByHilbert();
+	double sort_ms = sort_timer.elapsedMs();
+
+	auto pairs = randomPairs(by_id, queries);
+
+	std::cout << file_path << ", " << by_id.getNodeCount() << " nodes, " << by_id.getEdges().size() << " edges, "
+		<< queries << " routes, sorted in " << std::fixed << std::setprecision(1) << sort_ms << " ms\n"
+		<< "  order     neighbors in page   A* ms/route  misses/route   routing graph ms/route   pan ms   misses/view\n";
+	for (Graph* graph : { &by_id, &by_hilbert }) {
+		// Share of neighbors whose coordinates are in the same 4 kB page as the node's own
+		const Graph::Arrays& arrays = graph->getArrays();
+		constexpr size_t page_nodes = 4096 / sizeof(int32_t);
+		size_t near = 0;
+		for (uint32_t i = 0; i < arrays.node_ids.size(); ++i) {
+			for (const Graph::Neighbor& neighbor : graph->getNeighborsAt(i)) {
+				near += neighbor.index / page_nodes == i / page_nodes;
+			}
+		}
+		double near_share = 100.0 * near / std::max<size_t>(arrays.adj_targets.size(), 1);
+
+		CacheMisses route_misses;
+		double route_ms = runRoutes(*graph, pairs).ms_per_route;
+		long long misses = route_misses.count();
+
+		auto routing = std::make_shared<RoutingGraph>();
+		routing->build(*graph);
+		graph->setRoutingGraph(routing);
+		double routing_ms = runRoutes(*graph, pairs).ms_per_route;
+
+		// Pan a view of an eighth of the map row by row, reading the segment of every edge in view as drawing does
+		Quadtree quadtree;
+		quadtree.build(*graph);
+		constexpr int steps = 8;
+		volatile float sink = 0;
+		std::vector<uint32_t> ids;
+		CacheMisses pan_misses;
+		Timer pan_timer;
+		for (int round = 0; round < 4; ++round) {
+			for (int row = 0; row < steps; ++row) {
+				for (int col = 0; col < steps; ++col) {
+					Quadtree::Bounds view = { float(col) / steps, float(row) / steps, float(col + 1) / steps, float(row + 1) / steps };
+					ids.clear();
+					quadtree.query(view, ids);
+					for (uint32_t id : ids) {
+						const Quadtree::Segment& segment = quadtree.getSegments()[id];
+						sink = sink + segment.from.x + segment.to.y;
+					}
+				}
+			}
+		}
+		double pan_ms = pan_timer.elapsedMs() / 4;
+		long long view_misses = pan_misses.count();
+
+		auto perQuery = [](long long count, size_t per) -> std::string {
+			return count < 0 ? "n/a" : std::to_string(count / static_cast<long long>(std::max<size_t>(per, 1)));
+		};
+		std::cout << "  " << std::left << std::setw(10) << (graph == &by_id ? "ID" : "Hilbert") << std::right
+			<< std::setw(16) << near_share << "%" << std::setprecision(3)
+			<< std::setw(14) << route_ms << std::setw(14) << perQuery(misses, queries)
+			<< std::setw(25) << routing_ms << std::setprecision(1)
+			<< std::setw(9) << pan_ms << std::setw(14) << perQuery(view_misses, 4 * steps * steps) << "\n";
+	}
+}
+
+const char* Benchmark::modeName(ParseMode mode) {
+	switch (mode) {
+	case ParseMode::DOM: return "DOM";
+	case ParseMode::Streaming: return "Streaming";
+	case ParseMode::Parallel: return "Parallel";
+	}
+	return "";
+}
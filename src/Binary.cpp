@@ -1,89 +1,678 @@
 #include "Binary.hpp"
+#include "Hash.hpp"
+#include "MappedFile.hpp"
 #include <iostream>
 #include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <cmath>
 
-void Binary::saveToBinary(const std::string& bin_file_path, const Graph& graph) {
-    // Try opening the binary file given as path
-    std::ofstream out_file(bin_file_path, std::ios::binary);
+constexpr size_t FILE_HEADER_SIZE = sizeof(BINARY_MAGIC) + sizeof(uint32_t) + 4 * sizeof(uint64_t);
+
+// Append the bytes of a value to a buffer
+template <typename T>
+static void append(std::vector<char>& buffer, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+// Read a value from a buffer and move past it
+// Sizes are checked by the caller
+template <typename T>
+static T take(const char*& pos) {
+    T value;
+    std::memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+}
+
+// Append an unsigned value as a varint
+static void appendVarint(std::vector<char>& buffer, uint64_t value) {
+    while (value >= 0x80) {
+        buffer.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<char>(value));
+}
+
+// Read a varint and move past it
+// Returns false if it runs past end or is longer than 10 bytes
+static bool takeVarint(const char*& pos, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*pos++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (byte < 0x80) return true;
+    }
+    return false;
+}
+
+static uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+constexpr size_t MAPPED_HEADER_SIZE = 4 * sizeof(double) + 2 * sizeof(uint64_t);
+constexpr size_t GRAPH_SECTIONS = 9;
+constexpr size_t QUADTREE_SECTIONS = 13; // With the quadtree
+constexpr size_t MAPPED_SECTIONS = 16; // With the quadtree and tiles
+constexpr size_t QUADTREE_HEADER_SIZE = 2 * sizeof(uint64_t);
+constexpr size_t TILES_HEADER_SIZE = sizeof(uint64_t);
+
+// Offsets of the arrays of a mapped file from the start of the file
+// counts are the cell, cell edge and tile counts, count is the number of sections in the file
+// Returns the file size
+static size_t mappedLayout(uint64_t num_nodes, uint64_t num_edges, const uint64_t (&counts)[3], size_t count,
+    size_t (&offsets)[MAPPED_SECTIONS], size_t (&sizes)[MAPPED_SECTIONS]) {
+    const uint64_t section_sizes[MAPPED_SECTIONS] = {
+        num_nodes * sizeof(int64_t), // node_ids
+        num_nodes * sizeof(int32_t), // node_lats
+        num_nodes * sizeof(int32_t), // node_lons
+        (num_nodes + 1) * sizeof(uint32_t), // adj_offsets
+        2 * num_edges * sizeof(uint32_t), // adj_targets
+        2 * num_edges * sizeof(double), // adj_weights
+        2 * num_edges * sizeof(uint32_t), // adj_edges
+        num_edges * sizeof(Graph::Edge), // edges
+        num_edges * sizeof(int64_t), // edge_ways
+        QUADTREE_HEADER_SIZE, // num_cells, num_cell_edges
+        num_edges * sizeof(Quadtree::Segment), // segments
+        counts[0] * sizeof(Quadtree::Cell), // cells
+        counts[1] * sizeof(uint32_t), // cell_edges
+        TILES_HEADER_SIZE, // num_tiles
+        num_nodes * sizeof(uint32_t), // id_order
+        counts[2] * sizeof(Graph::Tile) // tiles
+    };
+    size_t end = FILE_HEADER_SIZE + MAPPED_HEADER_SIZE;
+    for (size_t i = 0; i < MAPPED_SECTIONS; ++i) {
+        offsets[i] = (end + MAPPED_ALIGNMENT - 1) / MAPPED_ALIGNMENT * MAPPED_ALIGNMENT;
+        sizes[i] = i < count ? static_cast<size_t>(section_sizes[i]) : 0;
+        if (i < count) end = offsets[i] + sizes[i];
+    }
+    return end;
+}
+
+// Decode a file header from the start of a buffer of at least FILE_HEADER_SIZE bytes
+// Returns false if the buffer doesn't start with any of the magics
+static bool decodeFileHeader(const char* buffer, Binary::FileHeader& header) {
+    if (std::memcmp(buffer, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0) {
+        header.format = BinaryFormat::Standard;
+    }
+    else if (std::memcmp(buffer, MAPPED_MAGIC, sizeof(MAPPED_MAGIC)) == 0) {
+        header.format = BinaryFormat::Mapped;
+    }
+    else if (std::memcmp(buffer, COMPACT_MAGIC, sizeof(COMPACT_MAGIC)) == 0) {
+        header.format = BinaryFormat::Compact;
+    }
+    else if (std::memcmp(buffer, TILED_MAGIC, sizeof(TILED_MAGIC)) == 0) {
+        header.format = BinaryFormat::Tiled;
+    }
+    else {
+        return false;
+    }
+
+    const char* pos = buffer + sizeof(BINARY_MAGIC);
+    header.version = take<uint32_t>(pos);
+    header.source_hash = take<uint64_t>(pos);
+    header.config_hash = take<uint64_t>(pos);
+    header.payload_size = take<uint64_t>(pos);
+    header.payload_hash = take<uint64_t>(pos);
+    return true;
+}
+
+// Version of the layout of a format
+static uint32_t formatVersion(BinaryFormat format) {
+    return format == BinaryFormat::Mapped || format == BinaryFormat::Tiled ? MAPPED_VERSION : BINARY_VERSION;
+}
+
+// Build a file header
+static std::vector<char> encodeFileHeader(const char (&magic)[4], uint32_t version, uint64_t source_hash, uint64_t config_hash,
+    uint64_t payload_size, uint64_t payload_hash) {
+    std::vector<char> header;
+    header.insert(header.end(), std::begin(magic), std::end(magic));
+    append(header, version);
+    append(header, source_hash);
+    append(header, config_hash);
+    append(header, payload_size);
+    append(header, payload_hash);
+    return header;
+}
+
+void Binary::saveToBinary(const std::string& bin_file_path, const Graph& graph, uint64_t source_hash, uint64_t config_hash,
+    BinaryFormat format, const Quadtree* quadtree) {
+    if (graph.getArrays().node_ids.size() != graph.getNodeCount()) {
+        std::cerr << "Error: Adjacency list must be created before saving a binary file." << std::endl;
+        return;
+    }
+
+    // Tiled files need the tiles and the quadtree of the same order, mapped files in Hilbert order the quadtree
+    bool tiled = format == BinaryFormat::Tiled;
+    if (graph.isTiled() != tiled && format != BinaryFormat::Standard) {
+        std::cerr << "Error: " << (tiled ? "Graph must be partitioned into tiles" : "Tiled graphs can't be saved")
+            << " for this binary format." << std::endl;
+        return;
+    }
+    bool ordered = tiled || (format == BinaryFormat::Mapped && graph.isHilbertSorted());
+    if (ordered && (!quadtree || quadtree->empty() || quadtree->getSegments().size() != graph.getEdges().size())) {
+        std::cerr << "Error: " << (tiled ? "Tiled" : "Hilbert sorted") << " binary files need the quadtree of the graph." << std::endl;
+        return;
+    }
+
+    // Write next to the file and replace it when done
+    // The old file may be mapped by the graph being saved, and is left intact if writing fails
+    std::string temp_path = bin_file_path + ".tmp";
+    std::ofstream out_file(temp_path, std::ios::binary);
     if (!out_file.is_open()) {
         std::cerr << "Error: Could not open binary file for writing." << std::endl;
         return;
     }
 
-	// Write bounding box
-	out_file.write(reinterpret_cast<const char*>(&graph.bbox.min_lat), sizeof(graph.bbox.min_lat));
-	out_file.write(reinterpret_cast<const char*>(&graph.bbox.min_lon), sizeof(graph.bbox.min_lon));
-	out_file.write(reinterpret_cast<const char*>(&graph.bbox.max_lat), sizeof(graph.bbox.max_lat));
-	out_file.write(reinterpret_cast<const char*>(&graph.bbox.max_lon), sizeof(graph.bbox.max_lon));
+    if (format == BinaryFormat::Mapped || tiled) {
+        writeMapped(out_file, graph, source_hash, config_hash, quadtree);
+    }
+    else if (format == BinaryFormat::Compact) {
+        writeCompact(out_file, graph, source_hash, config_hash);
+    }
+    else {
+        writeStandard(out_file, graph, source_hash, config_hash);
+    }
 
+    out_file.close();
+    std::error_code ec;
+    if (out_file) {
+        std::filesystem::rename(temp_path, bin_file_path, ec);
+    }
+    if (!out_file || ec) {
+        std::cerr << "Error: Could not write binary file " << bin_file_path << std::endl;
+        std::filesystem::remove(temp_path, ec);
+        return;
+    }
+    std::cout << "Binary file saved: " << bin_file_path << std::endl;
+}
+
+void Binary::writeStandard(std::ofstream& out_file, const Graph& graph, uint64_t source_hash, uint64_t config_hash) {
 	// Get edges and nodes from graph
-	const std::unordered_map<int64_t, Graph::Node>& nodes = graph.getNodes();
-	const std::unordered_map<uint32_t, Graph::Edge>& edges = graph.getEdges();
+	const Graph::Arrays& arrays = graph.getArrays();
+	const FlatArray<Graph::Edge>& edges = graph.getEdges();
+    const FlatArray<int64_t>& edge_ways = graph.getEdgeWays();
+    size_t num_nodes = arrays.node_ids.size();
+
+    // Build the payload in memory first, the file header needs its hash
+    std::vector<char> payload;
+    payload.reserve(4 * sizeof(double) + 2 * sizeof(int32_t) +
+        num_nodes * (sizeof(int64_t) + 2 * sizeof(double)) + edges.size() * (sizeof(uint32_t) + 3 * sizeof(int64_t)));
+
+	// Write bounding box
+	append(payload, graph.bbox.min_lat);
+	append(payload, graph.bbox.min_lon);
+	append(payload, graph.bbox.max_lat);
+	append(payload, graph.bbox.max_lon);
 
     // Write counts
-    int32_t num_nodes = nodes.size();
-    int32_t num_edges = edges.size();
-    out_file.write(reinterpret_cast<char*>(&num_nodes), sizeof(num_nodes));
-    out_file.write(reinterpret_cast<char*>(&num_edges), sizeof(num_edges));
+    append(payload, static_cast<int32_t>(num_nodes));
+    append(payload, static_cast<int32_t>(edges.size()));
 
-    // Write nodes
-    for (const auto& [node_id, node] : nodes) {
-        out_file.write(reinterpret_cast<const char*>(&node_id), sizeof(node_id));
-        out_file.write(reinterpret_cast<const char*>(&node.lat), sizeof(node.lat));
-        out_file.write(reinterpret_cast<const char*>(&node.lon), sizeof(node.lon));
+    // Write nodes in the order of the graph, loading sorts them by ID
+    for (size_t i = 0; i < num_nodes; ++i) {
+        append(payload, arrays.node_ids[i]);
+        append(payload, Graph::toDegrees(arrays.node_lats[i]));
+        append(payload, Graph::toDegrees(arrays.node_lons[i]));
     }
 
-    // Write edges
-    for (const auto& [edge_id, edge] : edges) {
-        out_file.write(reinterpret_cast<const char*>(&edge_id), sizeof(edge_id));
-        out_file.write(reinterpret_cast<const char*>(&edge.from), sizeof(edge.from));
-        out_file.write(reinterpret_cast<const char*>(&edge.to), sizeof(edge.to));
+    // Write edges in ID order
+    for (uint32_t edge_id = 0; edge_id < edges.size(); ++edge_id) {
+        append(payload, edge_id);
+        append(payload, edges[edge_id].from);
+        append(payload, edges[edge_id].to);
     }
 
-    out_file.close();
-    std::cout << "Binary file saved: " << bin_file_path << std::endl;
+    // Write way IDs of edges
+    for (int64_t way_id : edge_ways) {
+        append(payload, way_id);
+    }
+
+    // Write file header and payload
+    std::vector<char> header = encodeFileHeader(BINARY_MAGIC, BINARY_VERSION, source_hash, config_hash,
+        payload.size(), Hash::bytes(payload.data(), payload.size()));
+    out_file.write(header.data(), header.size());
+    out_file.write(payload.data(), payload.size());
 }
 
-void Binary::loadFromBinary(const std::string& bin_file_path, Graph& graph) {
-    // Try opening the binary file given as path
+void Binary::writeMapped(std::ofstream& out_file, const Graph& graph, uint64_t source_hash, uint64_t config_hash,
+    const Quadtree* quadtree) {
+    const Graph::Arrays& arrays = graph.getArrays();
+    const FlatArray<Graph::Edge>& edges = graph.getEdges();
+    uint64_t num_nodes = arrays.node_ids.size();
+    uint64_t num_edges = edges.size();
+
+    std::vector<char> header;
+    append(header, graph.bbox.min_lat);
+    append(header, graph.bbox.min_lon);
+    append(header, graph.bbox.max_lat);
+    append(header, graph.bbox.max_lon);
+    append(header, num_nodes);
+    append(header, num_edges);
+
+    // A quadtree for another graph would point at the wrong edges
+    if (quadtree && (quadtree->empty() || quadtree->getSegments().size() != num_edges)) {
+        quadtree = nullptr;
+    }
+    bool tiled = graph.isTiled();
+    bool ordered = !arrays.id_order.empty();
+    uint64_t counts[3] = {};
+    if (quadtree) {
+        counts[0] = quadtree->getCells().size();
+        counts[1] = quadtree->getCellEdges().size();
+    }
+    counts[2] = arrays.tiles.size();
+
+    // Arrays are written straight from the graph and the quadtree, in the order of mappedLayout
+    const void* sections[MAPPED_SECTIONS] = {
+        arrays.node_ids.data(), arrays.node_lats.data(), arrays.node_lons.data(), arrays.adj_offsets.data(), arrays.adj_targets.data(),
+        arrays.adj_weights.data(), arrays.adj_edges.data(), edges.data(), graph.getEdgeWays().data(),
+        counts,
+        quadtree ? quadtree->getSegments().data() : nullptr,
+        quadtree ? quadtree->getCells().data() : nullptr,
+        quadtree ? quadtree->getCellEdges().data() : nullptr,
+        &counts[2], arrays.id_order.data(), arrays.tiles.data()
+    };
+    size_t count = ordered ? MAPPED_SECTIONS : quadtree ? QUADTREE_SECTIONS : GRAPH_SECTIONS;
+    size_t offsets[MAPPED_SECTIONS], sizes[MAPPED_SECTIONS];
+    size_t file_size = mappedLayout(num_nodes, num_edges, counts, count, offsets, sizes);
+
+    uint64_t payload_hash = Hash::bytes(header.data(), header.size());
+    for (size_t i = 0; i < count; ++i) {
+        payload_hash = Hash::combine(payload_hash, Hash::bytes(sections[i], sizes[i]));
+    }
+
+    std::vector<char> file_header = encodeFileHeader(tiled ? TILED_MAGIC : MAPPED_MAGIC, MAPPED_VERSION, source_hash, config_hash,
+        file_size - FILE_HEADER_SIZE, payload_hash);
+    out_file.write(file_header.data(), file_header.size());
+    out_file.write(header.data(), header.size());
+
+    const char padding[MAPPED_ALIGNMENT] = {};
+    size_t pos = FILE_HEADER_SIZE + MAPPED_HEADER_SIZE;
+    for (size_t i = 0; i < count; ++i) {
+        out_file.write(padding, offsets[i] - pos);
+        out_file.write(static_cast<const char*>(sections[i]), sizes[i]);
+        pos = offsets[i] + sizes[i];
+    }
+}
+
+void Binary::writeCompact(std::ofstream& out_file, const Graph& graph, uint64_t source_hash, uint64_t config_hash) {
+    const Graph::Arrays& arrays = graph.getArrays();
+    const FlatArray<Graph::Edge>& edges = graph.getEdges();
+    const FlatArray<int64_t>& edge_ways = graph.getEdgeWays();
+    size_t num_nodes = arrays.node_ids.size();
+
+    // Most values fit in one or two bytes, reserve for a little over that
+    std::vector<char> payload;
+    payload.reserve(4 * sizeof(double) + 2 * sizeof(uint32_t) + num_nodes * 8 + edges.size() * 4);
+
+    append(payload, graph.bbox.min_lat);
+    append(payload, graph.bbox.min_lon);
+    append(payload, graph.bbox.max_lat);
+    append(payload, graph.bbox.max_lon);
+    append(payload, static_cast<uint32_t>(num_nodes));
+    append(payload, static_cast<uint32_t>(edges.size()));
+
+    // Write nodes in ID order as differences to the previous node
+    // Nodes of a Hilbert sorted graph are visited through id_order, rank gives their position in the file
+    bool ordered = !arrays.id_order.empty();
+    std::vector<uint32_t> rank(ordered ? num_nodes : 0);
+    int64_t prev_id = 0, prev_lat = 0, prev_lon = 0;
+    for (size_t i = 0; i < num_nodes; ++i) {
+        size_t index = ordered ? arrays.id_order[i] : i;
+        if (ordered) rank[index] = static_cast<uint32_t>(i);
+        int64_t lat = arrays.node_lats[index];
+        int64_t lon = arrays.node_lons[index];
+        appendVarint(payload, static_cast<uint64_t>(arrays.node_ids[index] - prev_id));
+        appendVarint(payload, zigzag(lat - prev_lat));
+        appendVarint(payload, zigzag(lon - prev_lon));
+        prev_id = arrays.node_ids[index];
+        prev_lat = lat;
+        prev_lon = lon;
+    }
+
+    // Write edges as positions of their nodes in the file
+    int64_t prev_to = 0, prev_way = 0;
+    for (uint32_t edge_id = 0; edge_id < edges.size(); ++edge_id) {
+        size_t from_index = graph.findIndex(edges[edge_id].from);
+        size_t to_index = graph.findIndex(edges[edge_id].to);
+        int64_t from = ordered ? rank[from_index] : static_cast<int64_t>(from_index);
+        int64_t to = ordered ? rank[to_index] : static_cast<int64_t>(to_index);
+        appendVarint(payload, zigzag(from - prev_to));
+        appendVarint(payload, zigzag(to - from));
+        appendVarint(payload, zigzag(edge_ways[edge_id] - prev_way));
+        prev_to = to;
+        prev_way = edge_ways[edge_id];
+    }
+
+    std::vector<char> header = encodeFileHeader(COMPACT_MAGIC, BINARY_VERSION, source_hash, config_hash,
+        payload.size(), Hash::bytes(payload.data(), payload.size()));
+    out_file.write(header.data(), header.size());
+    out_file.write(payload.data(), payload.size());
+}
+
+bool Binary::readHeader(const std::string& bin_file_path, FileHeader& header) {
     std::ifstream in_file(bin_file_path, std::ios::binary);
+    char buffer[FILE_HEADER_SIZE];
+    if (!in_file.read(buffer, FILE_HEADER_SIZE)) return false;
+    return decodeFileHeader(buffer, header) && header.version == formatVersion(header.format);
+}
+
+bool Binary::loadFromBinary(const std::string& bin_file_path, Graph& graph, bool verify, Quadtree* quadtree) {
+    FileHeader file_header;
+    if (readHeader(bin_file_path, file_header) &&
+        (file_header.format == BinaryFormat::Mapped || file_header.format == BinaryFormat::Tiled)) {
+        return mapBinary(bin_file_path, graph, verify, quadtree);
+    }
+
+    // Try opening the binary file given as path
+    std::ifstream in_file(bin_file_path, std::ios::binary | std::ios::ate);
     if (!in_file.is_open()) {
         std::cerr << "Error: Could not open binary file for reading." << std::endl;
-        return;
+        return false;
     }
 
+    // Read the whole file so that it can be checked before decoding
+    std::vector<char> content(static_cast<size_t>(in_file.tellg()));
+    in_file.seekg(0, std::ios::beg);
+    if (!in_file.read(content.data(), content.size())) {
+        std::cerr << "Error: Could not read binary file " << bin_file_path << std::endl;
+        return false;
+    }
+    in_file.close();
+
+    const char* payload = content.data();
+    size_t payload_size = content.size();
+    FileHeader header;
+    if (content.size() >= FILE_HEADER_SIZE && decodeFileHeader(content.data(), header)) {
+        if (header.version != formatVersion(header.format)) {
+            std::cerr << "Error: " << bin_file_path << " has format version " << header.version
+                << ", expected " << formatVersion(header.format) << std::endl;
+            return false;
+        }
+        payload += FILE_HEADER_SIZE;
+        payload_size -= FILE_HEADER_SIZE;
+        if (header.payload_size != payload_size) {
+            std::cerr << "Error: " << bin_file_path << " is truncated" << std::endl;
+            return false;
+        }
+        if (header.payload_hash != Hash::bytes(payload, payload_size)) {
+            std::cerr << "Error: " << bin_file_path << " is corrupted" << std::endl;
+            return false;
+        }
+    }
+
+    // Decode into a separate graph, so a bad file never leaves a half loaded graph behind
+    Graph loaded;
+    bool compact = header.format == BinaryFormat::Compact;
+    if (!(compact ? decodeCompact(payload, payload_size, loaded) : decodePayload(payload, payload_size, loaded))) {
+        std::cerr << "Error: " << bin_file_path << " is truncated or corrupted" << std::endl;
+        return false;
+    }
+    graph = std::move(loaded);
+
+    std::cout << "Binary file loaded: " << bin_file_path << std::endl;
+    return true;
+}
+
+bool Binary::decodePayload(const char* data, size_t size, Graph& graph) {
+    constexpr size_t counts_size = 4 * sizeof(double) + 2 * sizeof(int32_t);
+    constexpr size_t node_size = sizeof(int64_t) + 2 * sizeof(double);
+    constexpr size_t edge_size = sizeof(uint32_t) + 2 * sizeof(int64_t);
+    if (size < counts_size) return false;
+    const char* pos = data;
+
 	// Read bounding box
-	in_file.read(reinterpret_cast<char*>(&graph.bbox.min_lat), sizeof(graph.bbox.min_lat));
-	in_file.read(reinterpret_cast<char*>(&graph.bbox.min_lon), sizeof(graph.bbox.min_lon));
-	in_file.read(reinterpret_cast<char*>(&graph.bbox.max_lat), sizeof(graph.bbox.max_lat));
-	in_file.read(reinterpret_cast<char*>(&graph.bbox.max_lon), sizeof(graph.bbox.max_lon));
+	graph.bbox.min_lat = take<double>(pos);
+	graph.bbox.min_lon = take<double>(pos);
+	graph.bbox.max_lat = take<double>(pos);
+	graph.bbox.max_lon = take<double>(pos);
 
-    // Read counts
-    int32_t num_nodes, num_edges;
-    in_file.read(reinterpret_cast<char*>(&num_nodes), sizeof(num_nodes));
-    in_file.read(reinterpret_cast<char*>(&num_edges), sizeof(num_edges));
+    // Read counts, the rest of the file must match them exactly
+    // Files from before way IDs were stored end after the edges
+    int32_t num_nodes = take<int32_t>(pos);
+    int32_t num_edges = take<int32_t>(pos);
+    if (num_nodes < 0 || num_edges < 0) return false;
+    size_t without_ways = counts_size + num_nodes * node_size + num_edges * edge_size;
+    size_t with_ways = without_ways + num_edges * sizeof(int64_t);
+    if (size != without_ways && size != with_ways) return false;
+    bool has_ways = size == with_ways;
 
     // Read nodes
     for (int i = 0; i < num_nodes; ++i) {
-        int64_t id;
-        double lat, lon;
-        in_file.read(reinterpret_cast<char*>(&id), sizeof(id));
-        in_file.read(reinterpret_cast<char*>(&lat), sizeof(lat));
-        in_file.read(reinterpret_cast<char*>(&lon), sizeof(lon));
+        int64_t id = take<int64_t>(pos);
+        double lat = take<double>(pos);
+        double lon = take<double>(pos);
         graph.addNode(id, Graph::Node{ lat, lon });
     }
 
-
     // Read edges
+    // Edges get their IDs from their order in the file, so files written with sparse IDs load with dense ones
+    const char* ways = pos + num_edges * edge_size;
     for (int i = 0; i < num_edges; ++i) {
-		uint32_t edge_id;
-        int64_t from, to;
-        in_file.read(reinterpret_cast<char*>(&edge_id), sizeof(edge_id));
-        in_file.read(reinterpret_cast<char*>(&from), sizeof(from));
-        in_file.read(reinterpret_cast<char*>(&to), sizeof(to));
-        graph.addEdge(edge_id, { from, to });
+        take<uint32_t>(pos); // Edge ID
+        int64_t from = take<int64_t>(pos);
+        int64_t to = take<int64_t>(pos);
+        int64_t way_id = has_ways ? take<int64_t>(ways) : 0;
+        graph.addEdge({ from, to }, way_id);
     }
+    return true;
+}
 
-    in_file.close();
-    std::cout << "Binary file loaded: " << bin_file_path << std::endl;
+bool Binary::decodeCompact(const char* data, size_t size, Graph& graph) {
+    constexpr size_t counts_size = 4 * sizeof(double) + 2 * sizeof(uint32_t);
+    if (size < counts_size) return false;
+    const char* pos = data;
+    const char* end = data + size;
+
+    graph.bbox.min_lat = take<double>(pos);
+    graph.bbox.min_lon = take<double>(pos);
+    graph.bbox.max_lat = take<double>(pos);
+    graph.bbox.max_lon = take<double>(pos);
+    uint32_t num_nodes = take<uint32_t>(pos);
+    uint32_t num_edges = take<uint32_t>(pos);
+
+    // Every node and edge takes at least three bytes, this also keeps corrupted counts from allocating
+    if ((static_cast<uint64_t>(num_nodes) + num_edges) * 3 > size - counts_size) return false;
+
+    // Read nodes, IDs must be increasing for lookups by binary search
+    std::vector<int64_t> node_ids(num_nodes);
+    std::vector<int32_t> node_lats(num_nodes);
+    std::vector<int32_t> node_lons(num_nodes);
+    uint64_t id = 0, id_delta, lat_delta, lon_delta;
+    int64_t lat = 0, lon = 0;
+    for (uint32_t i = 0; i < num_nodes; ++i) {
+        if (!takeVarint(pos, end, id_delta) || !takeVarint(pos, end, lat_delta) || !takeVarint(pos, end, lon_delta)) return false;
+        if (i > 0 && id_delta == 0) return false;
+        id += id_delta; // Unsigned, so a negative first ID wraps around instead of overflowing
+        lat += unzigzag(lat_delta);
+        lon += unzigzag(lon_delta);
+        if (lat < INT32_MIN || lat > INT32_MAX || lon < INT32_MIN || lon > INT32_MAX) return false;
+        node_ids[i] = static_cast<int64_t>(id);
+        node_lats[i] = static_cast<int32_t>(lat);
+        node_lons[i] = static_cast<int32_t>(lon);
+    }
+
+    // Read edges, endpoints come as node indices for building the adjacency without lookups
+    std::vector<Graph::Edge> edges(num_edges);
+    std::vector<int64_t> edge_ways(num_edges);
+    std::vector<uint32_t> edge_nodes(2 * static_cast<size_t>(num_edges));
+    uint64_t from_delta, to_delta, way_delta;
+    int64_t to = 0, way_id = 0;
+    for (uint32_t i = 0; i < num_edges; ++i) {
+        if (!takeVarint(pos, end, from_delta) || !takeVarint(pos, end, to_delta) || !takeVarint(pos, end, way_delta)) return false;
+        int64_t from = to + unzigzag(from_delta);
+        to = from + unzigzag(to_delta);
+        way_id += unzigzag(way_delta);
+        if (from < 0 || from >= num_nodes || to < 0 || to >= num_nodes) return false;
+        edges[i] = { node_ids[from], node_ids[to] };
+        edge_ways[i] = way_id;
+        edge_nodes[2 * i] = static_cast<uint32_t>(from);
+        edge_nodes[2 * i + 1] = static_cast<uint32_t>(to);
+    }
+    if (pos != end) return false;
+
+    graph.createAdj(std::move(node_ids), std::move(node_lats), std::move(node_lons), std::move(edges), std::move(edge_ways), edge_nodes);
+    return true;
+}
+
+bool Binary::mapBinary(const std::string& bin_file_path, Graph& graph, bool verify, Quadtree* quadtree) {
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(bin_file_path)) {
+        std::cerr << "Error: Could not map binary file " << bin_file_path << std::endl;
+        return false;
+    }
+
+    FileHeader file_header;
+    if (file->size() < FILE_HEADER_SIZE + MAPPED_HEADER_SIZE || !decodeFileHeader(file->data(), file_header) ||
+        file_header.payload_size != file->size() - FILE_HEADER_SIZE) {
+        std::cerr << "Error: " << bin_file_path << " is truncated" << std::endl;
+        return false;
+    }
+
+    const char* pos = file->data() + FILE_HEADER_SIZE;
+    Graph::Bounds bbox;
+    bbox.min_lat = take<double>(pos);
+    bbox.min_lon = take<double>(pos);
+    bbox.max_lat = take<double>(pos);
+    bbox.max_lon = take<double>(pos);
+    uint64_t num_nodes = take<uint64_t>(pos);
+    uint64_t num_edges = take<uint64_t>(pos);
+
+    // Counts past what the offsets can index can't come from a real graph, and would overflow the layout
+    size_t offsets[MAPPED_SECTIONS], sizes[MAPPED_SECTIONS];
+    if (num_nodes > UINT32_MAX || num_edges > UINT32_MAX / 2) {
+        std::cerr << "Error: " << bin_file_path << " is corrupted" << std::endl;
+        return false;
+    }
+
+    // The quadtree is optional in mapped files and follows the graph, its counts come first
+    // Tiled files always have it, followed by the tiles, and mapped files in Hilbert order by id_order without tiles
+    bool tiled = file_header.format == BinaryFormat::Tiled;
+    uint64_t counts[3] = {};
+    size_t graph_size = mappedLayout(num_nodes, num_edges, counts, GRAPH_SECTIONS, offsets, sizes);
+    bool has_quadtree = file->size() >= offsets[9] + QUADTREE_HEADER_SIZE;
+    if (has_quadtree) {
+        std::memcpy(counts, file->data() + offsets[9], QUADTREE_HEADER_SIZE);
+        has_quadtree = counts[0] <= UINT32_MAX && counts[1] <= UINT32_MAX;
+    }
+    size_t count = GRAPH_SECTIONS;
+    if (has_quadtree) {
+        size_t quadtree_size = mappedLayout(num_nodes, num_edges, counts, QUADTREE_SECTIONS, offsets, sizes);
+        if (file->size() >= offsets[13] + TILES_HEADER_SIZE) {
+            std::memcpy(&counts[2], file->data() + offsets[13], TILES_HEADER_SIZE);
+            if ((tiled ? counts[2] <= num_nodes : counts[2] == 0) &&
+                mappedLayout(num_nodes, num_edges, counts, MAPPED_SECTIONS, offsets, sizes) == file->size()) {
+                count = MAPPED_SECTIONS;
+            }
+        }
+        if (count == GRAPH_SECTIONS && quadtree_size == file->size()) {
+            count = QUADTREE_SECTIONS;
+        }
+    }
+    if ((tiled && count != MAPPED_SECTIONS) || (count == GRAPH_SECTIONS && graph_size != file->size())) {
+        std::cerr << "Error: " << bin_file_path << " is truncated or corrupted" << std::endl;
+        return false;
+    }
+    has_quadtree = count >= QUADTREE_SECTIONS;
+    mappedLayout(num_nodes, num_edges, counts, count, offsets, sizes);
+
+    if (verify) {
+        uint64_t payload_hash = Hash::bytes(file->data() + FILE_HEADER_SIZE, MAPPED_HEADER_SIZE);
+        for (size_t i = 0; i < count; ++i) {
+            payload_hash = Hash::combine(payload_hash, Hash::bytes(file->data() + offsets[i], sizes[i]));
+        }
+        if (payload_hash != file_header.payload_hash) {
+            std::cerr << "Error: " << bin_file_path << " is corrupted" << std::endl;
+            return false;
+        }
+    }
+
+    // Every array points into the mapping and keeps it alive
+    auto section = [&](size_t i) { return file->data() + offsets[i]; };
+    Graph::Arrays arrays;
+    arrays.node_ids = FlatArray<int64_t>(reinterpret_cast<const int64_t*>(section(0)), num_nodes, file);
+    arrays.node_lats = FlatArray<int32_t>(reinterpret_cast<const int32_t*>(section(1)), num_nodes, file);
+    arrays.node_lons = FlatArray<int32_t>(reinterpret_cast<const int32_t*>(section(2)), num_nodes, file);
+    arrays.adj_offsets = FlatArray<uint32_t>(reinterpret_cast<const uint32_t*>(section(3)), num_nodes + 1, file);
+    arrays.adj_targets = FlatArray<uint32_t>(reinterpret_cast<const uint32_t*>(section(4)), 2 * num_edges, file);
+    arrays.adj_weights = FlatArray<double>(reinterpret_cast<const double*>(section(5)), 2 * num_edges, file);
+    arrays.adj_edges = FlatArray<uint32_t>(reinterpret_cast<const uint32_t*>(section(6)), 2 * num_edges, file);
+
+    // The last offset must close the adjacency, otherwise neighbor lookups could read past it
+    if (arrays.adj_offsets[num_nodes] != 2 * num_edges) {
+        std::cerr << "Error: " << bin_file_path << " is corrupted" << std::endl;
+        return false;
+    }
+
+    if (count == MAPPED_SECTIONS) {
+        arrays.id_order = FlatArray<uint32_t>(reinterpret_cast<const uint32_t*>(section(14)), num_nodes, file);
+    }
+    if (tiled) {
+        arrays.tiles = FlatArray<Graph::Tile>(reinterpret_cast<const Graph::Tile*>(section(15)), counts[2], file);
+
+        // Tiles must cover the nodes and edges in order, the tile cache relies on their ranges
+        uint32_t node_end = 0, edge_end = 0;
+        for (const Graph::Tile& tile : arrays.tiles) {
+            if (tile.node_begin != node_end || tile.node_end < tile.node_begin ||
+                tile.edge_begin != edge_end || tile.edge_end < tile.edge_begin) break;
+            node_end = tile.node_end;
+            edge_end = tile.edge_end;
+        }
+        if (node_end != num_nodes || edge_end != num_edges) {
+            std::cerr << "Error: " << bin_file_path << " is corrupted" << std::endl;
+            return false;
+        }
+    }
+
+    graph = Graph();
+    graph.bbox = bbox;
+    graph.setArrays(std::move(arrays),
+        FlatArray<Graph::Edge>(reinterpret_cast<const Graph::Edge*>(section(7)), num_edges, file),
+        FlatArray<int64_t>(reinterpret_cast<const int64_t*>(section(8)), num_edges, file));
+
+    if (quadtree && has_quadtree) {
+        quadtree->setArrays(
+            FlatArray<Quadtree::Segment>(reinterpret_cast<const Quadtree::Segment*>(section(10)), num_edges, file),
+            FlatArray<Quadtree::Cell>(reinterpret_cast<const Quadtree::Cell*>(section(11)), sizes[11] / sizeof(Quadtree::Cell), file),
+            FlatArray<uint32_t>(reinterpret_cast<const uint32_t*>(section(12)), sizes[12] / sizeof(uint32_t), file));
+    }
+
+    std::cout << "Binary file mapped: " << bin_file_path << std::endl;
+    return true;
+}
+
+uint64_t Binary::sourceFingerprint(const std::vector<std::string>& file_paths) {
+    uint64_t fingerprint = Hash::mix(file_paths.size());
+    std::vector<char> sample(FINGERPRINT_SAMPLE_SIZE);
+
+    for (const auto& file_path : file_paths) {
+        // Only the file name counts, so moving the project folder doesn't force a rebuild
+        std::string name = std::filesystem::path(file_path).filename().string();
+        fingerprint = Hash::combine(fingerprint, Hash::bytes(name.data(), name.size()));
+
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(file_path, ec);
+        if (ec) continue; // Missing files only contribute their name
+        auto mtime = std::filesystem::last_write_time(file_path, ec);
+        fingerprint = Hash::combine(fingerprint, size);
+        fingerprint = Hash::combine(fingerprint, static_cast<uint64_t>(mtime.time_since_epoch().count()));
+
+        // Hash samples from the start, middle and end instead of the whole file
+        std::ifstream file(file_path, std::ios::binary);
+        uint64_t sample_size = std::min<uint64_t>(size, FINGERPRINT_SAMPLE_SIZE);
+        for (uint64_t offset : { uint64_t(0), (size - sample_size) / 2, size - sample_size }) {
+            file.seekg(offset);
+            file.read(sample.data(), sample_size);
+            fingerprint = Hash::combine(fingerprint, Hash::bytes(sample.data(), file.gcount()));
+        }
+    }
+    return fingerprint;
 }
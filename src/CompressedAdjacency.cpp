@@ -0,0 +1,55 @@
+#include "CompressedAdjacency.hpp"
+#include <cmath>
+#include <algorithm>
+
+void CompressedAdjacency::appendVarint(std::vector<uint8_t>& out, uint32_t value) {
+	while (value >= 0x80) {
+		out.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+void CompressedAdjacency::build(const Graph& graph) {
+	const Graph::Arrays& arrays = graph.getArrays();
+	node_count = arrays.node_ids.size();
+	const uint32_t* offsets = arrays.adj_offsets.data();
+	const uint32_t* targets = arrays.adj_targets.data();
+	const double* weights = arrays.adj_weights.data();
+	const uint32_t* edge_ids = arrays.adj_edges.data();
+
+	bytes.clear();
+	bytes.reserve(3 * arrays.adj_targets.size() + node_count);
+	sample_offsets.clear();
+	sample_edges.clear();
+	std::vector<uint8_t> record;
+	uint32_t sample_edge = 0;
+	for (uint32_t i = 0; i < node_count; ++i) {
+		if (i % SAMPLE_INTERVAL == 0) {
+			// The first edge in the sample, the records after it mostly have edges with IDs close by
+			uint32_t sample_end = static_cast<uint32_t>(std::min<size_t>(i + SAMPLE_INTERVAL, node_count));
+			if (offsets[i] < offsets[sample_end]) {
+				sample_edge = edge_ids[offsets[i]];
+			}
+			sample_offsets.push_back(bytes.size());
+			sample_edges.push_back(sample_edge);
+		}
+
+		record.clear();
+		uint32_t prev_index = i, prev_edge = sample_edge;
+		for (uint32_t pos = offsets[i]; pos < offsets[i + 1]; ++pos) {
+			appendVarint(record, zigzag(targets[pos] - prev_index));
+			appendVarint(record, static_cast<uint32_t>(std::ceil(weights[pos] / WEIGHT_UNIT)));
+			appendVarint(record, zigzag(edge_ids[pos] - prev_edge));
+			prev_index = targets[pos];
+			prev_edge = edge_ids[pos];
+		}
+		appendVarint(bytes, static_cast<uint32_t>(record.size()));
+		bytes.insert(bytes.end(), record.begin(), record.end());
+	}
+	bytes.shrink_to_fit();
+}
+
+size_t CompressedAdjacency::memoryBytes() const {
+	return bytes.size() + sample_offsets.size() * sizeof(uint64_t) + sample_edges.size() * sizeof(uint32_t);
+}
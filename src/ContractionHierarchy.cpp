@@ -0,0 +1,332 @@
+#include "ContractionHierarchy.hpp"
+#include "Hash.hpp"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <functional>
+#include <queue>
+
+// Witness searches give up after settling this many nodes, the shortcut is then added even if another path may exist
+// Higher limits find more witnesses and fewer shortcuts, but make the contraction slower
+constexpr size_t WITNESS_SETTLE_LIMIT = 500;
+// Lower limit while only counting the shortcuts a node would add to order the nodes
+constexpr size_t SIMULATION_SETTLE_LIMIT = 20;
+
+constexpr double UNREACHED = std::numeric_limits<double>::infinity();
+
+// Original edge or shortcut while contracting, between a and b in either direction
+struct BuildArc {
+	uint32_t a, b;
+	double weight;
+	uint32_t middle; // As in ContractionHierarchy::Arc, with first and second as BuildArc indices for shortcuts
+	uint32_t first, second;
+};
+
+// Graph of the nodes not contracted yet, and the arcs up from the contracted ones
+struct Contraction {
+	std::vector<BuildArc> arcs;
+	std::vector<std::vector<uint32_t>> incident; // Arcs at each node, some of them to nodes contracted since
+	std::vector<std::vector<uint32_t>> up; // Arcs of each contracted node to its neighbors at the time
+	std::vector<bool> contracted;
+	std::vector<int> levels; // Height of the contracted nodes below each node
+	std::vector<int> contracted_neighbors;
+
+	// Neighbors of the node being looked at and the shortest arc to each
+	std::vector<uint32_t> neighbors, neighbor_arcs;
+	std::vector<uint32_t> best_arc; // NONE except while gathering
+
+	// Witness search
+	std::vector<double> dist;
+	std::vector<uint32_t> touched;
+	std::vector<std::pair<double, uint32_t>> heap;
+	std::vector<bool> is_target;
+
+	explicit Contraction(size_t num_nodes) :
+		incident(num_nodes), up(num_nodes), contracted(num_nodes, false), levels(num_nodes, 0), contracted_neighbors(num_nodes, 0),
+		best_arc(num_nodes, ContractionHierarchy::NONE), dist(num_nodes, UNREACHED), is_target(num_nodes, false) {}
+
+	static uint32_t other(const BuildArc& arc, uint32_t node) {
+		return arc.a == node ? arc.b : arc.a;
+	}
+
+	// Collect the remaining neighbors of a node and the shortest arc to each
+	// Arcs to contracted nodes and longer parallel arcs are dropped from its list on the way
+	void gather(uint32_t node) {
+		neighbors.clear();
+		neighbor_arcs.clear();
+		std::vector<uint32_t>& list = incident[node];
+		for (uint32_t id : list) {
+			uint32_t neighbor = other(arcs[id], node);
+			if (contracted[neighbor]) continue;
+			if (best_arc[neighbor] == ContractionHierarchy::NONE) {
+				best_arc[neighbor] = id;
+				neighbors.push_back(neighbor);
+			}
+			else if (arcs[id].weight < arcs[best_arc[neighbor]].weight) {
+				best_arc[neighbor] = id;
+			}
+		}
+		for (uint32_t neighbor : neighbors) {
+			neighbor_arcs.push_back(best_arc[neighbor]);
+			best_arc[neighbor] = ContractionHierarchy::NONE;
+		}
+
+		// Longer arcs between the same two remaining nodes are never on a shortest path, nor part of a shortcut yet
+		list.assign(neighbor_arcs.begin(), neighbor_arcs.end());
+	}
+
+	// Dijkstra from start among the remaining nodes other than skip, until the targets are settled,
+	// or up to max_dist or the settle limit
+	void witnessSearch(uint32_t start, uint32_t skip, double max_dist, size_t targets, size_t settle_limit) {
+		for (uint32_t node : touched) {
+			dist[node] = UNREACHED;
+		}
+		touched.clear();
+		heap.clear();
+		auto later = std::greater<std::pair<double, uint32_t>>();
+		dist[start] = 0;
+		touched.push_back(start);
+		heap.push_back({ 0, start });
+		size_t settled = 0;
+		while (!heap.empty()) {
+			std::pop_heap(heap.begin(), heap.end(), later);
+			auto [d, node] = heap.back();
+			heap.pop_back();
+			if (d > dist[node]) continue;
+			if (d > max_dist || ++settled > settle_limit) break;
+			if (is_target[node] && --targets == 0) break;
+			for (uint32_t id : incident[node]) {
+				uint32_t next = other(arcs[id], node);
+				if (next == skip || contracted[next]) continue;
+				double g = d + arcs[id].weight;
+				if (g < dist[next]) {
+					if (dist[next] == UNREACHED) {
+						touched.push_back(next);
+					}
+					dist[next] = g;
+					heap.push_back({ g, next });
+					std::push_heap(heap.begin(), heap.end(), later);
+				}
+			}
+		}
+	}
+
+	// Shortcuts needed to contract a node, added if add is set
+	// Leaves the node's neighbors and arcs to them in neighbors and neighbor_arcs
+	size_t shortcuts(uint32_t node, bool add) {
+		gather(node);
+		size_t count = 0;
+		for (size_t i = 0; i + 1 < neighbors.size(); ++i) {
+			double from_weight = arcs[neighbor_arcs[i]].weight;
+			double max_dist = 0;
+			for (size_t j = i + 1; j < neighbors.size(); ++j) {
+				max_dist = std::max(max_dist, from_weight + arcs[neighbor_arcs[j]].weight);
+			}
+
+			// A path around the node at most as long as the one through it makes the shortcut unnecessary
+			for (size_t j = i + 1; j < neighbors.size(); ++j) {
+				is_target[neighbors[j]] = true;
+			}
+			witnessSearch(neighbors[i], node, max_dist, neighbors.size() - i - 1, add ? WITNESS_SETTLE_LIMIT : SIMULATION_SETTLE_LIMIT);
+			for (size_t j = i + 1; j < neighbors.size(); ++j) {
+				is_target[neighbors[j]] = false;
+			}
+			for (size_t j = i + 1; j < neighbors.size(); ++j) {
+				double weight = from_weight + arcs[neighbor_arcs[j]].weight;
+				if (dist[neighbors[j]] <= weight) continue;
+				++count;
+				if (add) {
+					uint32_t id = static_cast<uint32_t>(arcs.size());
+					arcs.push_back({ neighbors[i], neighbors[j], weight, node, neighbor_arcs[i], neighbor_arcs[j] });
+					incident[neighbors[i]].push_back(id);
+					incident[neighbors[j]].push_back(id);
+				}
+			}
+		}
+		return count;
+	}
+
+	// Nodes that add fewer shortcuts than they remove arcs go first, spread out over the graph and kept low
+	int priority(uint32_t node) {
+		int added = static_cast<int>(shortcuts(node, false));
+		int removed = static_cast<int>(neighbors.size());
+		return 4 * (added - removed) + 2 * contracted_neighbors[node] + levels[node];
+	}
+};
+
+void ContractionHierarchy::build(const Graph& graph) {
+	const Graph::Arrays& arrays = graph.getArrays();
+	uint32_t num_nodes = static_cast<uint32_t>(arrays.node_ids.size());
+	const uint32_t* offsets = arrays.adj_offsets.data();
+	const uint32_t* targets = arrays.adj_targets.data();
+	const double* weights = arrays.adj_weights.data();
+	const uint32_t* edge_ids = arrays.adj_edges.data();
+
+	// Every edge once, from its end with the lower index, self loops are never on a shortest path
+	Contraction c(num_nodes);
+	c.arcs.reserve(2 * graph.getEdges().size());
+	for (uint32_t i = 0; i < num_nodes; ++i) {
+		for (uint32_t pos = offsets[i]; pos < offsets[i + 1]; ++pos) {
+			if (targets[pos] <= i) continue;
+			uint32_t id = static_cast<uint32_t>(c.arcs.size());
+			c.arcs.push_back({ i, targets[pos], weights[pos], NONE, edge_ids[pos], NONE });
+			c.incident[i].push_back(id);
+			c.incident[targets[pos]].push_back(id);
+		}
+	}
+
+	// Contract by priority, updated lazily: a node whose priority has grown goes back into the queue
+	// Neighbors of a contracted node are only looked at again when they come up, recomputing them all slowed down
+	// dense parts of the graph several times over for a few percent fewer shortcuts
+	using Entry = std::pair<int, uint32_t>;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+	for (uint32_t i = 0; i < num_nodes; ++i) {
+		queue.push({ c.priority(i), i });
+	}
+	while (!queue.empty()) {
+		uint32_t node = queue.top().second;
+		queue.pop();
+		int now = c.priority(node);
+		if (!queue.empty() && now > queue.top().first) {
+			queue.push({ now, node });
+			continue;
+		}
+
+		c.shortcuts(node, true);
+		c.up[node] = c.neighbor_arcs;
+		c.contracted[node] = true;
+		for (uint32_t neighbor : c.neighbors) {
+			++c.contracted_neighbors[neighbor];
+			c.levels[neighbor] = std::max(c.levels[neighbor], c.levels[node] + 1);
+		}
+	}
+
+	// Arcs grouped by their lower end, shortcuts point at the positions of their halves
+	up_offsets.assign(num_nodes + 1, 0);
+	for (uint32_t i = 0; i < num_nodes; ++i) {
+		up_offsets[i + 1] = up_offsets[i] + static_cast<uint32_t>(c.up[i].size());
+	}
+	std::vector<uint32_t> positions(c.arcs.size(), NONE);
+	for (uint32_t i = 0; i < num_nodes; ++i) {
+		for (size_t k = 0; k < c.up[i].size(); ++k) {
+			positions[c.up[i][k]] = up_offsets[i] + static_cast<uint32_t>(k);
+		}
+	}
+	arcs.resize(up_offsets.back());
+	shortcuts = 0;
+	for (uint32_t i = 0; i < num_nodes; ++i) {
+		for (uint32_t id : c.up[i]) {
+			const BuildArc& built = c.arcs[id];
+			Arc& arc = arcs[positions[id]];
+			arc.target = Contraction::other(built, i);
+			arc.middle = built.middle;
+			arc.weight = built.weight;
+			if (built.middle == NONE) {
+				arc.first = built.first;
+				arc.second = NONE;
+			}
+			else {
+				arc.first = positions[built.first];
+				arc.second = positions[built.second];
+				++shortcuts;
+			}
+		}
+	}
+}
+
+void ContractionHierarchy::unpack(uint32_t arc, uint32_t from, uint32_t to, std::vector<uint32_t>& edges) const {
+	struct Step {
+		uint32_t arc, from, to;
+	};
+	std::vector<Step> stack = { { arc, from, to } };
+	while (!stack.empty()) {
+		Step step = stack.back();
+		stack.pop_back();
+		const Arc& current = arcs[step.arc];
+		if (current.middle == NONE) {
+			edges.push_back(current.first);
+			continue;
+		}
+
+		// Both halves go up from the middle node, the one ending at from comes first
+		bool first_at_from = arcs[current.first].target == step.from;
+		uint32_t half_from = first_at_from ? current.first : current.second;
+		uint32_t half_to = first_at_from ? current.second : current.first;
+		stack.push_back({ half_to, current.middle, step.to });
+		stack.push_back({ half_from, step.from, current.middle });
+	}
+}
+
+size_t ContractionHierarchy::memoryBytes() const {
+	return up_offsets.size() * sizeof(uint32_t) + arcs.size() * sizeof(Arc);
+}
+
+// Hash of the arrays, stored in the file to catch damage
+static uint64_t dataHash(const std::vector<uint32_t>& up_offsets, const std::vector<ContractionHierarchy::Arc>& arcs) {
+	return Hash::combine(Hash::bytes(up_offsets.data(), up_offsets.size() * sizeof(uint32_t)),
+		Hash::bytes(arcs.data(), arcs.size() * sizeof(ContractionHierarchy::Arc)));
+}
+
+bool ContractionHierarchy::save(const std::string& file_path, const Graph& graph) const {
+	std::ofstream out_file(file_path, std::ios::binary);
+	if (!out_file) {
+		std::cerr << "Error: Could not write the contraction hierarchy to " << file_path << std::endl;
+		return false;
+	}
+	uint64_t graph_hash = graph.adjacencyFingerprint();
+	uint64_t counts[3] = { getNodeCount(), arcs.size(), shortcuts };
+	uint64_t data_hash = dataHash(up_offsets, arcs);
+	out_file.write(HIERARCHY_MAGIC, sizeof(HIERARCHY_MAGIC));
+	out_file.write(reinterpret_cast<const char*>(&HIERARCHY_VERSION), sizeof(HIERARCHY_VERSION));
+	out_file.write(reinterpret_cast<const char*>(&graph_hash), sizeof(graph_hash));
+	out_file.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+	out_file.write(reinterpret_cast<const char*>(&data_hash), sizeof(data_hash));
+	out_file.write(reinterpret_cast<const char*>(up_offsets.data()), up_offsets.size() * sizeof(uint32_t));
+	out_file.write(reinterpret_cast<const char*>(arcs.data()), arcs.size() * sizeof(Arc));
+	if (!out_file) {
+		std::cerr << "Error: Could not write the contraction hierarchy to " << file_path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool ContractionHierarchy::load(const std::string& file_path, const Graph& graph) {
+	std::ifstream in_file(file_path, std::ios::binary);
+	if (!in_file) return false;
+
+	char magic[4];
+	uint32_t version = 0;
+	uint64_t graph_hash = 0, data_hash = 0;
+	uint64_t counts[3] = {};
+	in_file.read(magic, sizeof(magic));
+	in_file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	in_file.read(reinterpret_cast<char*>(&graph_hash), sizeof(graph_hash));
+	in_file.read(reinterpret_cast<char*>(counts), sizeof(counts));
+	in_file.read(reinterpret_cast<char*>(&data_hash), sizeof(data_hash));
+	if (!in_file || !std::equal(magic, magic + 4, HIERARCHY_MAGIC) || version != HIERARCHY_VERSION) {
+		std::cerr << "Error: " << file_path << " is not a contraction hierarchy of this version" << std::endl;
+		return false;
+	}
+	if (counts[0] != graph.getNodeCount() || graph_hash != graph.adjacencyFingerprint()) {
+		std::cout << file_path << " was built for another graph\n";
+		return false;
+	}
+
+	// Anything short of the sizes in the header is damage
+	std::vector<uint32_t> new_offsets(counts[0] + 1);
+	std::vector<Arc> new_arcs;
+	in_file.read(reinterpret_cast<char*>(new_offsets.data()), new_offsets.size() * sizeof(uint32_t));
+	if (in_file && new_offsets.back() == counts[1]) {
+		new_arcs.resize(counts[1]);
+		in_file.read(reinterpret_cast<char*>(new_arcs.data()), new_arcs.size() * sizeof(Arc));
+	}
+	if (!in_file || new_offsets.back() != counts[1] || dataHash(new_offsets, new_arcs) != data_hash) {
+		std::cerr << "Error: " << file_path << " is truncated or corrupted" << std::endl;
+		return false;
+	}
+	up_offsets = std::move(new_offsets);
+	arcs = std::move(new_arcs);
+	shortcuts = counts[2];
+	return true;
+}
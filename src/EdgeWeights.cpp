@@ -0,0 +1,144 @@
+#include "EdgeWeights.hpp"
+#include "CompressedAdjacency.hpp"
+#include <iostream>
+#include <algorithm>
+
+// Every thread that reads has a slot with the epoch it started reading in, IDLE while it doesn't read
+// Slots are shared by all EdgeWeights and kept in a list that only grows, a thread gives its slot back when it ends
+constexpr uint64_t IDLE = UINT64_MAX;
+
+struct ReaderSlot {
+	std::atomic<uint64_t> epoch{ IDLE };
+	std::atomic<bool> in_use{ false };
+	ReaderSlot* next = nullptr;
+	unsigned depth = 0; // Nested snapshots, only used by the thread holding the slot
+};
+
+static std::atomic<uint64_t> global_epoch{ 0 };
+static std::atomic<ReaderSlot*> reader_slots{ nullptr };
+
+static ReaderSlot* claimSlot() {
+	for (ReaderSlot* slot = reader_slots.load(); slot; slot = slot->next) {
+		bool free = false;
+		if (slot->in_use.compare_exchange_strong(free, true)) return slot;
+	}
+	ReaderSlot* slot = new ReaderSlot();
+	slot->in_use = true;
+	slot->next = reader_slots.load();
+	while (!reader_slots.compare_exchange_weak(slot->next, slot)) {}
+	return slot;
+}
+
+// Slot of the calling thread, claimed on its first snapshot
+static ReaderSlot& threadSlot() {
+	struct Owner {
+		ReaderSlot* slot = claimSlot();
+		~Owner() { slot->in_use.store(false); }
+	};
+	thread_local Owner owner;
+	return *owner.slot;
+}
+
+EdgeWeights::Snapshot::Snapshot(const EdgeWeights& weights) {
+	ReaderSlot& reader = threadSlot();
+	slot = &reader;
+
+	// The epoch is announced before the version is read, so a batch that sees the reader idle has
+	// already published its version, and a batch that sees the epoch keeps every version the reader could read
+	if (reader.depth++ == 0) {
+		reader.epoch.store(global_epoch.load());
+	}
+	version = weights.current.load();
+}
+
+EdgeWeights::Snapshot::~Snapshot() {
+	ReaderSlot& reader = *static_cast<ReaderSlot*>(slot);
+	if (--reader.depth == 0) {
+		reader.epoch.store(IDLE);
+	}
+}
+
+EdgeWeights::EdgeWeights(const Graph& graph) {
+	edge_count = graph.getEdges().size();
+	auto first = std::make_unique<Version>();
+	first->pages.resize((edge_count + PAGE_SIZE - 1) / PAGE_SIZE);
+	for (auto& page : first->pages) {
+		page = std::make_shared<Version::Page>();
+	}
+	auto set = [&](uint32_t edge_id, double weight) {
+		first->pages[edge_id >> PAGE_BITS]->weights[edge_id & (PAGE_SIZE - 1)] = weight;
+	};
+
+	const Graph::Arrays& arrays = graph.getArrays();
+	const CompressedAdjacency* compressed = graph.getCompressedAdjacency();
+	if (arrays.adj_edges.empty() && compressed) {
+		for (uint32_t i = 0; i < compressed->getNodeCount(); ++i) {
+			for (const Graph::Neighbor& neighbor : compressed->getNeighbors(i)) {
+				set(neighbor.edge_id, neighbor.weight);
+			}
+		}
+	}
+	else {
+		for (size_t pos = 0; pos < arrays.adj_edges.size(); ++pos) {
+			set(arrays.adj_edges[pos], arrays.adj_weights[pos]);
+		}
+	}
+	stored = first->pages;
+	current.store(first.release());
+}
+
+EdgeWeights::~EdgeWeights() {
+	delete current.load();
+}
+
+bool EdgeWeights::apply(const std::vector<Update>& updates) {
+	for (const Update& update : updates) {
+		if (update.edge_id >= edge_count) {
+			std::cerr << "Error: Edge weight update for edge " << update.edge_id << ", there are only " << edge_count << " edges" << std::endl;
+			return false;
+		}
+
+		// Lower weights would let the heuristics overestimate and A* return longer routes, NaN fails the check too
+		double lowest = stored[update.edge_id >> PAGE_BITS]->weights[update.edge_id & (PAGE_SIZE - 1)];
+		if (!(update.weight >= lowest)) {
+			std::cerr << "Error: Edge weight update of " << update.weight << " for edge " << update.edge_id
+				<< ", it can't go below its stored weight of " << lowest << std::endl;
+			return false;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(write_mutex);
+	const Version* old = current.load();
+	auto next = std::make_unique<Version>(*old);
+	next->number = old->number + 1;
+
+	// Pages still shared with the old version are copied once before the first change to them
+	for (const Update& update : updates) {
+		uint32_t page = update.edge_id >> PAGE_BITS;
+		if (next->pages[page] == old->pages[page]) {
+			next->pages[page] = std::make_shared<Version::Page>(*old->pages[page]);
+		}
+		next->pages[page]->weights[update.edge_id & (PAGE_SIZE - 1)] = update.weight;
+	}
+
+	// Publish, then move to a new epoch, readers announcing it or later started after the old version was replaced
+	current.store(next.release());
+	uint64_t epoch = global_epoch.fetch_add(1) + 1;
+	retired.push_back({ std::unique_ptr<const Version>(old), epoch });
+	reclaim();
+	return true;
+}
+
+void EdgeWeights::reclaim() {
+	uint64_t oldest = IDLE;
+	for (ReaderSlot* slot = reader_slots.load(); slot; slot = slot->next) {
+		oldest = std::min(oldest, slot->epoch.load());
+	}
+	retired.erase(std::remove_if(retired.begin(), retired.end(), [oldest](const Retired& r) { return r.epoch <= oldest; }),
+		retired.end());
+}
+
+size_t EdgeWeights::getRetiredCount() const {
+	std::lock_guard<std::mutex> lock(write_mutex);
+	return retired.size();
+}
@@ -1,83 +1,579 @@
 #include "Graph.hpp"
+#include "TileCache.hpp"
+#include "Haversine.hpp"
+#include "Parallel.hpp"
+#include "CompressedAdjacency.hpp"
+#include "EdgeWeights.hpp"
+#include "ContractionHierarchy.hpp"
+#include "Landmarks.hpp"
+#include "Hash.hpp"
 #include <cmath>
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
 void Graph::addNode(int64_t id, Node node) {
-	nodes[id] = node;
+	nodes[id] = { toFixed(node.lat), toFixed(node.lon) };
 }
 
-bool Graph::addEdge(uint32_t id, Edge edge) {
-	if (edge_set.find(edge) == edge_set.end()) {
-		edges[id] = edge;
-		edge_set.insert(edge);
+bool Graph::addEdge(Edge edge, int64_t way_id) {
+	if (edge_set.insert(edge).second) {
+		edges.edit().push_back(edge);
+		edge_ways.edit().push_back(way_id);
 		return true;
 	}
 	return false; // Edge already exists
 }
 
-bool Graph::hasNode(int64_t id) {
-	return nodes.find(id) != nodes.end();
+size_t Graph::addEdges(const std::vector<Edge>& new_edges, const std::vector<int64_t>& way_ids) {
+	std::vector<Edge>& edge_list = edges.edit();
+	std::vector<int64_t>& way_list = edge_ways.edit();
+	edge_set.reserve(edge_set.size() + new_edges.size());
+	edge_list.reserve(edge_list.size() + new_edges.size());
+	way_list.reserve(way_list.size() + new_edges.size());
+
+	size_t added = 0;
+	for (size_t i = 0; i < new_edges.size(); ++i) {
+		const Edge& edge = new_edges[i];
+		if (!nodes.contains(edge.from) || !nodes.contains(edge.to)) continue;
+		if (edge_set.insert(edge).second) {
+			edge_list.push_back(edge);
+			way_list.push_back(way_ids[i]);
+			++added;
+		}
+	}
+	return added;
+}
+
+void Graph::updateNode(int64_t id, Node node) {
+	if (FixedNode* stored = nodes.find(id)) {
+		*stored = { toFixed(node.lat), toFixed(node.lon) };
+	}
+}
+
+void Graph::removeNodes(const std::vector<int64_t>& ids) {
+	FlatHashSet<int64_t, IdTraits> removed;
+	removed.reserve(ids.size());
+	for (int64_t id : ids) {
+		removed.insert(id);
+	}
+
+	// Collect connected edges, removing from the highest ID down
+	// so that the last edge moved into a freed ID is never one still waiting for removal
+	for (size_t edge_id = edges.size(); edge_id-- > 0;) {
+		if (removed.contains(edges[edge_id].from) || removed.contains(edges[edge_id].to)) {
+			removeEdge(static_cast<uint32_t>(edge_id));
+		}
+	}
+	for (int64_t id : ids) {
+		nodes.erase(id);
+	}
+}
+
+void Graph::removeEdge(uint32_t id) {
+	if (id >= edges.size()) return;
+
+	std::vector<Edge>& edge_list = edges.edit();
+	std::vector<int64_t>& way_list = edge_ways.edit();
+	edge_set.erase(edge_list[id]);
+
+	// Move the last edge into the freed ID
+	edge_list[id] = edge_list.back();
+	way_list[id] = way_list.back();
+	edge_list.pop_back();
+	way_list.pop_back();
+}
+
+bool Graph::hasNode(int64_t id) const {
+	if (adj_created) return findIndex(id) != NOT_FOUND;
+	return nodes.contains(id);
 }
 
 bool Graph::hasEdge(int64_t from, int64_t to) const {
-	return edge_set.find({ from, to }) != edge_set.end();
+	return edge_set.contains({ from, to });
 }
 
 void Graph::createAdj() {
-	// Iterate over edges
-	for (const auto& [id, edge] : edges) {
-		// Get endpoint nodes and calculate weight
-		const Node& from = nodes[edge.from];
-		const Node& to = nodes[edge.to];
-		double weight = getHaversineDistance(from, to);
+	if (adj_created) return;
+
+	// Sort nodes by ID so that they can be found by binary search
+	std::vector<int64_t> node_ids;
+	node_ids.reserve(nodes.size());
+	for (const auto& [id, node] : nodes) {
+		node_ids.push_back(id);
+	}
+	std::sort(node_ids.begin(), node_ids.end());
+	std::vector<int32_t> node_lats(node_ids.size());
+	std::vector<int32_t> node_lons(node_ids.size());
+	for (size_t i = 0; i < node_ids.size(); ++i) {
+		const FixedNode& node = *nodes.find(node_ids[i]);
+		node_lats[i] = node.lat;
+		node_lons[i] = node.lon;
+	}
+
+	arrays.node_ids = std::move(node_ids);
+	arrays.node_lats = std::move(node_lats);
+	arrays.node_lons = std::move(node_lons);
 
-		// Create adj list entry
-		adj_list[edge.from].emplace_back(edge.to, weight, id);
-		adj_list[edge.to].emplace_back(edge.from, weight, id);
+	// Find endpoint indices
+	std::vector<uint32_t> edge_nodes(edges.size() * 2);
+	for (size_t id = 0; id < edges.size(); ++id) {
+		size_t from = findIndex(edges[id].from);
+		size_t to = findIndex(edges[id].to);
+		if (from == NOT_FOUND || to == NOT_FOUND) {
+			throw std::runtime_error("Edge endpoint not found");
+		}
+		edge_nodes[2 * id] = static_cast<uint32_t>(from);
+		edge_nodes[2 * id + 1] = static_cast<uint32_t>(to);
 	}
+	buildAdjacency(edge_nodes);
+
+	// Building data is no longer needed
+	nodes.clear();
+	edge_set.clear();
 }
 
-const std::unordered_map<uint32_t, Graph::Edge>& Graph::getEdges() const {
-	return edges;
+void Graph::createAdj(std::vector<int64_t> node_ids, std::vector<int32_t> node_lats, std::vector<int32_t> node_lons,
+	std::vector<Edge> new_edges, std::vector<int64_t> new_edge_ways, const std::vector<uint32_t>& edge_nodes) {
+	nodes.clear();
+	edge_set.clear();
+	arrays = Arrays();
+	arrays.node_ids = std::move(node_ids);
+	arrays.node_lats = std::move(node_lats);
+	arrays.node_lons = std::move(node_lons);
+	edges = std::move(new_edges);
+	edge_ways = std::move(new_edge_ways);
+	buildAdjacency(edge_nodes);
 }
 
-const std::unordered_map<int64_t, Graph::Node>& Graph::getNodes() const {
-	return nodes;
+void Graph::buildAdjacency(const std::vector<uint32_t>& edge_nodes) {
+	// Count neighbors of every node
+	std::vector<uint32_t> adj_offsets(arrays.node_ids.size() + 1, 0);
+	for (uint32_t index : edge_nodes) {
+		++adj_offsets[index + 1];
+	}
+	for (size_t i = 1; i < adj_offsets.size(); ++i) {
+		adj_offsets[i] += adj_offsets[i - 1];
+	}
+
+	// Edge lengths in one pass over the coordinates
+	std::vector<double> weights(edges.size());
+	getHaversineDistances(edge_nodes.data(), edges.size(), weights.data());
+
+	// Fill rows in edge ID order, both directions of an edge share its weight
+	std::vector<uint32_t> adj_targets(edges.size() * 2);
+	std::vector<double> adj_weights(edges.size() * 2);
+	std::vector<uint32_t> adj_edges(edges.size() * 2);
+	std::vector<uint32_t> fill(adj_offsets.begin(), adj_offsets.end() - 1);
+	for (uint32_t id = 0; id < edges.size(); ++id) {
+		uint32_t from = edge_nodes[2 * id], to = edge_nodes[2 * id + 1];
+		double weight = weights[id];
+
+		uint32_t pos = fill[from]++;
+		adj_targets[pos] = to;
+		adj_weights[pos] = weight;
+		adj_edges[pos] = id;
+
+		pos = fill[to]++;
+		adj_targets[pos] = from;
+		adj_weights[pos] = weight;
+		adj_edges[pos] = id;
+	}
+
+	arrays.adj_offsets = std::move(adj_offsets);
+	arrays.adj_targets = std::move(adj_targets);
+	arrays.adj_weights = std::move(adj_weights);
+	arrays.adj_edges = std::move(adj_edges);
+	adj_created = true;
+	dropRoutingData();
 }
 
-const Graph::Node& Graph::getNode(int64_t id) const {
+void Graph::releaseAdj() {
+	if (!adj_created) return;
+
+	nodes.reserve(arrays.node_ids.size());
+	for (size_t i = 0; i < arrays.node_ids.size(); ++i) {
+		nodes[arrays.node_ids[i]] = { arrays.node_lats[i], arrays.node_lons[i] };
+	}
+	edges.edit();
+	edge_ways.edit();
+	edge_set.reserve(edges.size());
+	for (const Edge& edge : edges) {
+		edge_set.insert(edge);
+	}
+	arrays = Arrays();
+	adj_created = false;
+	dropRoutingData();
+}
+
+void Graph::setArrays(Arrays new_arrays, FlatArray<Edge> new_edges, FlatArray<int64_t> new_edge_ways) {
+	nodes.clear();
+	edge_set.clear();
+	arrays = std::move(new_arrays);
+	edges = std::move(new_edges);
+	edge_ways = std::move(new_edge_ways);
+	adj_created = true;
+	dropRoutingData();
+}
+
+// Position of a grid cell along a Z curve, interleaving the bits of x and y
+static uint32_t zOrder(uint32_t x, uint32_t y) {
+	uint32_t key = 0;
+	for (unsigned int bit = 0; bit < 16; ++bit) {
+		key |= ((x >> bit) & 1u) << (2 * bit);
+		key |= ((y >> bit) & 1u) << (2 * bit + 1);
+	}
+	return key;
+}
+
+// Position of a cell of a 65536 x 65536 grid along a Hilbert curve
+// Unlike a Z curve it never jumps, consecutive positions are always neighboring cells
+static uint64_t hilbertOrder(uint32_t x, uint32_t y) {
+	uint64_t key = 0;
+	for (uint32_t half = 1u << 15; half > 0; half >>= 1) {
+		uint32_t rx = (x & half) ? 1 : 0;
+		uint32_t ry = (y & half) ? 1 : 0;
+		key += static_cast<uint64_t>(half) * half * ((3 * rx) ^ ry);
+
+		// Rotate the quadrant so that the curve inside it starts and ends next to its neighbors
+		if (ry == 0) {
+			if (rx == 1) {
+				x = half - 1 - (x & (half - 1));
+				y = half - 1 - (y & (half - 1));
+			}
+			std::swap(x, y);
+		}
+	}
+	return key;
+}
+
+std::vector<uint32_t> Graph::gridCells(unsigned int size) const {
+	double lat_range = std::max(bbox.max_lat - bbox.min_lat, 1e-9);
+	double lon_range = std::max(bbox.max_lon - bbox.min_lon, 1e-9);
+	std::vector<uint32_t> cells(2 * arrays.node_ids.size());
+	for (size_t i = 0; i < arrays.node_ids.size(); ++i) {
+		double fx = (toDegrees(arrays.node_lons[i]) - bbox.min_lon) / lon_range * size;
+		double fy = (toDegrees(arrays.node_lats[i]) - bbox.min_lat) / lat_range * size;
+		cells[2 * i] = static_cast<uint32_t>(std::clamp(fx, 0.0, size - 1.0));
+		cells[2 * i + 1] = static_cast<uint32_t>(std::clamp(fy, 0.0, size - 1.0));
+	}
+	return cells;
+}
+
+std::vector<uint32_t> Graph::applyOrder(const std::vector<uint32_t>& node_order) {
+	size_t num_nodes = arrays.node_ids.size();
+
+	// Endpoint indices in the current order
+	std::vector<uint32_t> old_edge_nodes(edges.size() * 2);
+	for (size_t id = 0; id < edges.size(); ++id) {
+		old_edge_nodes[2 * id] = static_cast<uint32_t>(findIndex(edges[id].from));
+		old_edge_nodes[2 * id + 1] = static_cast<uint32_t>(findIndex(edges[id].to));
+	}
+
+	// Move the nodes, edges follow their source node and keep their old order otherwise
+	std::vector<uint32_t> new_index(num_nodes);
+	std::vector<int64_t> node_ids(num_nodes);
+	std::vector<int32_t> node_lats(num_nodes);
+	std::vector<int32_t> node_lons(num_nodes);
+	for (uint32_t i = 0; i < num_nodes; ++i) {
+		new_index[node_order[i]] = i;
+		node_ids[i] = arrays.node_ids[node_order[i]];
+		node_lats[i] = arrays.node_lats[node_order[i]];
+		node_lons[i] = arrays.node_lons[node_order[i]];
+	}
+	std::vector<uint32_t> edge_order(edges.size());
+	for (uint32_t id = 0; id < edges.size(); ++id) edge_order[id] = id;
+	std::stable_sort(edge_order.begin(), edge_order.end(), [&](uint32_t a, uint32_t b) {
+		return new_index[old_edge_nodes[2 * a]] < new_index[old_edge_nodes[2 * b]];
+	});
+	std::vector<Edge> new_edges(edges.size());
+	std::vector<int64_t> new_edge_ways(edges.size());
+	std::vector<uint32_t> edge_nodes(edges.size() * 2);
+	for (uint32_t id = 0; id < edges.size(); ++id) {
+		uint32_t old_id = edge_order[id];
+		new_edges[id] = edges[old_id];
+		new_edge_ways[id] = edge_ways[old_id];
+		edge_nodes[2 * id] = new_index[old_edge_nodes[2 * old_id]];
+		edge_nodes[2 * id + 1] = new_index[old_edge_nodes[2 * old_id + 1]];
+	}
+
+	arrays = Arrays();
+	arrays.node_ids = std::move(node_ids);
+	arrays.node_lats = std::move(node_lats);
+	arrays.node_lons = std::move(node_lons);
+	edges = std::move(new_edges);
+	edge_ways = std::move(new_edge_ways);
+	buildAdjacency(edge_nodes);
+
+	// Node indices in ID order for findIndex
+	std::vector<uint32_t> id_order(num_nodes);
+	for (uint32_t i = 0; i < num_nodes; ++i) id_order[i] = i;
+	std::sort(id_order.begin(), id_order.end(), [&](uint32_t a, uint32_t b) {
+		return arrays.node_ids[a] < arrays.node_ids[b];
+	});
+	arrays.id_order = std::move(id_order);
+	return edge_nodes;
+}
+
+void Graph::sortByHilbert() {
+	if (!adj_created || isTiled() || isHilbertSorted()) return;
+	dropRoutingData(); // Node indices and edge IDs change
+
+	// Key of every node on the finest grid, ties go by node ID
+	std::vector<uint32_t> cells = gridCells(65536);
+	std::vector<uint64_t> keys(arrays.node_ids.size());
+	for (size_t i = 0; i < keys.size(); ++i) {
+		keys[i] = hilbertOrder(cells[2 * i], cells[2 * i + 1]);
+	}
+	std::vector<uint32_t> node_order(keys.size());
+	for (uint32_t i = 0; i < node_order.size(); ++i) node_order[i] = i;
+	std::sort(node_order.begin(), node_order.end(), [&](uint32_t a, uint32_t b) {
+		if (keys[a] != keys[b]) return keys[a] < keys[b];
+		return arrays.node_ids[a] < arrays.node_ids[b];
+	});
+	applyOrder(node_order);
+}
+
+bool Graph::isHilbertSorted() const {
+	return !arrays.id_order.empty() && arrays.tiles.empty();
+}
+
+void Graph::partitionTiles(unsigned int grid) {
+	if (!adj_created) return;
+	dropRoutingData(); // Node indices and edge IDs change
+
+	unsigned int size = 1;
+	while (size < grid && size < 65536) size *= 2;
+
+	// Tile of every node, and its position on the finest grid within the tile
+	size_t num_nodes = arrays.node_ids.size();
+	std::vector<uint32_t> cells = gridCells(65536);
+	std::vector<uint32_t> node_tiles(num_nodes);
+	std::vector<uint64_t> keys(num_nodes);
+	for (size_t i = 0; i < num_nodes; ++i) {
+		uint32_t x = cells[2 * i], y = cells[2 * i + 1];
+		node_tiles[i] = zOrder(x / (65536 / size), y / (65536 / size));
+		keys[i] = hilbertOrder(x, y);
+	}
+
+	// New order: by tile, then along the Hilbert curve and by node ID within a tile
+	std::vector<uint32_t> node_order(num_nodes);
+	for (uint32_t i = 0; i < num_nodes; ++i) node_order[i] = i;
+	std::sort(node_order.begin(), node_order.end(), [&](uint32_t a, uint32_t b) {
+		if (node_tiles[a] != node_tiles[b]) return node_tiles[a] < node_tiles[b];
+		if (keys[a] != keys[b]) return keys[a] < keys[b];
+		return arrays.node_ids[a] < arrays.node_ids[b];
+	});
+	std::vector<uint32_t> edge_nodes = applyOrder(node_order);
+
+	// Ranges and bounds of the non-empty tiles
+	std::vector<Tile> tiles;
+	size_t edge_pos = 0;
+	for (size_t i = 0; i < num_nodes;) {
+		uint32_t key = node_tiles[node_order[i]];
+		Tile tile;
+		tile.node_begin = static_cast<uint32_t>(i);
+		while (i < num_nodes && node_tiles[node_order[i]] == key) {
+			double lat = toDegrees(arrays.node_lats[i]), lon = toDegrees(arrays.node_lons[i]);
+			tile.bounds.expand({ lat, lat, lon, lon });
+			++i;
+		}
+		tile.node_end = static_cast<uint32_t>(i);
+		tile.edge_begin = static_cast<uint32_t>(edge_pos);
+		while (edge_pos < edges.size() && edge_nodes[2 * edge_pos] < tile.node_end) {
+			uint32_t to = edge_nodes[2 * edge_pos + 1];
+			double lat = toDegrees(arrays.node_lats[to]), lon = toDegrees(arrays.node_lons[to]);
+			tile.bounds.expand({ lat, lat, lon, lon });
+			++edge_pos;
+		}
+		tile.edge_end = static_cast<uint32_t>(edge_pos);
+		tiles.push_back(tile);
+	}
+	arrays.tiles = std::move(tiles);
+}
+
+bool Graph::isTiled() const {
+	return !arrays.tiles.empty();
+}
+
+void Graph::setTileCache(std::shared_ptr<TileCache> cache) {
+	tile_cache = std::move(cache);
+}
+
+void Graph::setRoutingGraph(std::shared_ptr<const RoutingGraph> routing) {
+	routing_graph = std::move(routing);
+}
+
+void Graph::setCompressedAdjacency(std::shared_ptr<const CompressedAdjacency> compressed) {
+	compressed_adjacency = std::move(compressed);
+}
+
+void Graph::setContractionHierarchy(std::shared_ptr<const ContractionHierarchy> hierarchy) {
+	contraction_hierarchy.set(std::move(hierarchy));
+}
+
+void Graph::setLandmarks(std::shared_ptr<const Landmarks> new_landmarks) {
+	landmarks.set(std::move(new_landmarks));
+}
+
+void Graph::setEdgeWeights(std::shared_ptr<EdgeWeights> weights) {
+	edge_weights = std::move(weights);
+}
+
+uint64_t Graph::adjacencyFingerprint() const {
+	uint64_t hash = Hash::mix(arrays.node_ids.size());
+	hash = Hash::combine(hash, Hash::bytes(arrays.node_ids.data(), arrays.node_ids.size() * sizeof(int64_t)));
+	hash = Hash::combine(hash, Hash::bytes(arrays.adj_offsets.data(), arrays.adj_offsets.size() * sizeof(uint32_t)));
+	hash = Hash::combine(hash, Hash::bytes(arrays.adj_targets.data(), arrays.adj_targets.size() * sizeof(uint32_t)));
+	hash = Hash::combine(hash, Hash::bytes(arrays.adj_weights.data(), arrays.adj_weights.size() * sizeof(double)));
+	hash = Hash::combine(hash, Hash::bytes(arrays.adj_edges.data(), arrays.adj_edges.size() * sizeof(uint32_t)));
+	return hash;
+}
+
+void Graph::dropAdjArrays() {
+	arrays.adj_offsets = FlatArray<uint32_t>();
+	arrays.adj_targets = FlatArray<uint32_t>();
+	arrays.adj_weights = FlatArray<double>();
+	arrays.adj_edges = FlatArray<uint32_t>();
+}
+
+void Graph::labelComponents() {
+	size_t num_nodes = arrays.node_ids.size();
+	const uint32_t* offsets = arrays.adj_offsets.data();
+	const uint32_t* targets = arrays.adj_targets.data();
+
+	// Breadth first search from every node not labeled yet, the queue holds each node once
+	constexpr uint32_t unlabeled = UINT32_MAX;
+	std::vector<uint32_t> labels(num_nodes, unlabeled);
+	std::vector<uint32_t> sizes;
+	std::vector<uint32_t> queue(num_nodes);
+	for (uint32_t start = 0; start < num_nodes; ++start) {
+		if (labels[start] != unlabeled) continue;
+		uint32_t label = static_cast<uint32_t>(sizes.size());
+		size_t head = 0, tail = 0;
+		queue[tail++] = start;
+		labels[start] = label;
+		while (head < tail) {
+			uint32_t node = queue[head++];
+			for (uint32_t pos = offsets[node]; pos < offsets[node + 1]; ++pos) {
+				if (labels[targets[pos]] == unlabeled) {
+					labels[targets[pos]] = label;
+					queue[tail++] = targets[pos];
+				}
+			}
+		}
+		sizes.push_back(static_cast<uint32_t>(tail));
+	}
+
+	// Renumber by size, largest first
+	std::vector<uint32_t> by_size(sizes.size());
+	for (uint32_t i = 0; i < by_size.size(); ++i) by_size[i] = i;
+	std::stable_sort(by_size.begin(), by_size.end(), [&](uint32_t a, uint32_t b) { return sizes[a] > sizes[b]; });
+	std::vector<uint32_t> renumber(sizes.size());
+	component_sizes.resize(sizes.size());
+	for (uint32_t i = 0; i < by_size.size(); ++i) {
+		renumber[by_size[i]] = i;
+		component_sizes[i] = sizes[by_size[i]];
+	}
+	for (uint32_t& label : labels) {
+		label = renumber[label];
+	}
+	components = std::move(labels);
+}
+
+void Graph::dropRoutingData() {
+	routing_graph.reset();
+	compressed_adjacency.reset();
+	edge_weights.reset();
+	contraction_hierarchy.reset();
+	landmarks.reset();
+	components.clear();
+	component_sizes.clear();
+}
+
+void Graph::loadTiles(const Bounds& area) const {
+	if (tile_cache) tile_cache->useArea(area);
+}
+
+void Graph::loadNodeTile(size_t index) const {
+	tile_cache->useNode(index);
+}
+
+size_t Graph::getNodeCount() const {
+	return adj_created ? arrays.node_ids.size() : nodes.size();
+}
+
+Graph::Node Graph::getNode(int64_t id) const {
 	// Get node by id
-	auto it = nodes.find(id);
-	if (it == nodes.end()) {
+	if (adj_created) {
+		size_t index = findIndex(id);
+		if (index == NOT_FOUND) {
+			throw std::runtime_error("Node not found");
+		}
+		return getNodeAt(static_cast<uint32_t>(index));
+	}
+	const FixedNode* node = nodes.find(id);
+	if (!node) {
 		throw std::runtime_error("Node not found");
 	}
-	return it->second;
+	return { toDegrees(node->lat), toDegrees(node->lon) };
+}
+
+const FlatArray<Graph::Edge>& Graph::getEdges() const {
+	return edges;
+}
+
+const FlatArray<int64_t>& Graph::getEdgeWays() const {
+	return edge_ways;
 }
 
 const Graph::Edge& Graph::getEdge(uint32_t id) const {
 	// Get edge by id
-	auto it = edges.find(id);
-	if (it == edges.end()) {
+	if (id >= edges.size()) {
 		throw std::runtime_error("Edge not found");
 	}
-	return it->second;
+	return edges[id];
 }
 
-const std::vector<std::tuple<int64_t, double, uint32_t>>& Graph::getNeighbors(int64_t id) const {
-	return adj_list.at(id);
+const Graph::Arrays& Graph::getArrays() const {
+	return arrays;
 }
 
-double Graph::getHaversineDistance(const Node& from, const Node& to) {
-	double phi1 = toRadians(from.lat);
-	double phi2 = toRadians(to.lat);
-	double delta_phi = toRadians(to.lat - from.lat);
-	double delta_lambda = toRadians(to.lon - from.lon);
+Graph::Neighbors Graph::getNeighbors(int64_t id) const {
+	size_t index = adj_created ? findIndex(id) : NOT_FOUND;
+	if (index == NOT_FOUND) {
+		return Neighbors(nullptr, nullptr, nullptr, 0);
+	}
+	return getNeighborsAt(static_cast<uint32_t>(index));
+}
+
+size_t Graph::findIndex(int64_t id) const {
+	if (!arrays.id_order.empty()) {
+		// Search the IDs through their sorted order
+		const int64_t* node_ids = arrays.node_ids.data();
+		const uint32_t* begin = arrays.id_order.begin();
+		const uint32_t* end = arrays.id_order.end();
+		const uint32_t* it = std::lower_bound(begin, end, id, [node_ids](uint32_t index, int64_t value) {
+			return node_ids[index] < value;
+		});
+		return it != end && node_ids[*it] == id ? static_cast<size_t>(*it) : NOT_FOUND;
+	}
+
+	const int64_t* begin = arrays.node_ids.begin();
+	const int64_t* end = arrays.node_ids.end();
+	const int64_t* it = std::lower_bound(begin, end, id);
+	return it != end && *it == id ? static_cast<size_t>(it - begin) : NOT_FOUND;
+}
+
+// Haversine distance from latitudes and longitude difference in radians, cos_phi1 and cos_phi2 are the cosines of the latitudes
+static double haversine(double phi1, double phi2, double cos_phi1, double cos_phi2, double delta_lambda) {
+	double delta_phi = phi2 - phi1;
 
 	// a = sin^2(delta_phi / 2) + cos(phi1) * cos(phi2) * sin^2(delta_lambda / 2)
-	double a = std::sin(delta_phi / 2.0) * std::sin(delta_phi / 2.0) +
-		std::cos(phi1) * std::cos(phi2) * 
-		std::sin(delta_lambda / 2.0) * std::sin(delta_lambda / 2.0);
-	
+	double sin_phi = std::sin(delta_phi / 2.0);
+	double sin_lambda = std::sin(delta_lambda / 2.0);
+	double a = sin_phi * sin_phi + cos_phi1 * cos_phi2 * sin_lambda * sin_lambda;
+
 	// c = 2 * atan2(sqrt(a), sqrt(1 - a))
 	double c = 2 * std::atan2(std::sqrt(a), std::sqrt(1 - a));
 
@@ -85,6 +581,53 @@ double Graph::getHaversineDistance(const Node& from, const Node& to) {
 	return R * c;
 }
 
-double Graph::toRadians(double degrees) {
+// Radians per fixed-point unit
+constexpr double FIXED_TO_RADIANS = PI / 180.0 / COORDINATE_SCALE;
+
+// Edges per batch of the weight kernel, the gathered coordinates of a batch stay in L1 cache
+constexpr size_t DISTANCE_BATCH = 2048;
+
+void Graph::getHaversineDistances(const uint32_t* pairs, size_t count, double* out, unsigned threads) const {
+	const int32_t* lats = arrays.node_lats.data();
+	const int32_t* lons = arrays.node_lons.data();
+	size_t batches = (count + DISTANCE_BATCH - 1) / DISTANCE_BATCH;
+	Parallel::forEach(batches, [&](size_t batch) {
+		// Gather the endpoint coordinates into arrays the kernel reads in order
+		int32_t lat1[DISTANCE_BATCH], lon1[DISTANCE_BATCH], lat2[DISTANCE_BATCH], lon2[DISTANCE_BATCH];
+		size_t begin = batch * DISTANCE_BATCH;
+		size_t size = std::min(DISTANCE_BATCH, count - begin);
+		for (size_t i = 0; i < size; ++i) {
+			uint32_t from = pairs[2 * (begin + i)], to = pairs[2 * (begin + i) + 1];
+			lat1[i] = lats[from];
+			lon1[i] = lons[from];
+			lat2[i] = lats[to];
+			lon2[i] = lons[to];
+		}
+		Haversine::distances(lat1, lon1, lat2, lon2, size, out + begin);
+	}, threads);
+}
+
+void Graph::getHaversineDistances(const uint32_t* indices, size_t count, const Node& target, double* out) const {
+	const int32_t* lats = arrays.node_lats.data();
+	const int32_t* lons = arrays.node_lons.data();
+	// The target's side of the formula is the same for every node
+	double phi2 = toRadians(target.lat);
+	double cos_phi2 = std::cos(phi2);
+	double lambda2 = toRadians(target.lon);
+	for (size_t i = 0; i < count; ++i) {
+		useNode(indices[i]);
+		double phi1 = lats[indices[i]] * FIXED_TO_RADIANS;
+		double delta_lambda = lambda2 - lons[indices[i]] * FIXED_TO_RADIANS;
+		out[i] = haversine(phi1, phi2, std::cos(phi1), cos_phi2, delta_lambda);
+	}
+}
+
+double Graph::getHaversineDistance(const Node& from, const Node& to) const {
+	double phi1 = toRadians(from.lat);
+	double phi2 = toRadians(to.lat);
+	return haversine(phi1, phi2, std::cos(phi1), std::cos(phi2), toRadians(to.lon - from.lon));
+}
+
+double Graph::toRadians(double degrees) const {
 	return degrees * PI / 180.0;
 }
@@ -1,19 +1,103 @@
 #include "GraphLoader.hpp"
 #include "ParseOSM.hpp"
 #include "Binary.hpp"
+#include "ParseOSC.hpp"
+#include "TagFilter.hpp"
+#include "Hash.hpp"
+#include "TileCache.hpp"
+#include "RoutingGraph.hpp"
+#include "CompressedAdjacency.hpp"
+#include "ContractionHierarchy.hpp"
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
 
-bool GraphLoader::loadGraph(Graph& graph) {
-	std::ifstream bin_file_stream(bin_file, std::ios::binary);
+bool GraphLoader::loadGraph(Graph& graph, Quadtree& quadtree, LoadProgress* progress) {
+	bool loaded = loadOrBuild(graph, quadtree, progress);
+	if (progress) {
+		progress->done = true;
+	}
+	return loaded;
+}
+
+bool GraphLoader::loadOrBuild(Graph& graph, Quadtree& quadtree, LoadProgress* progress) {
+	// Fingerprints of what the binary file would be built from now
+	uint64_t source_hash = Binary::sourceFingerprint(osm_files);
+	uint64_t config_hash = configFingerprint();
 
 	// Try loading from binary first
-	if (bin_file_stream.good()) {
-		Binary::loadFromBinary(bin_file, graph);
-		graph.createAdj(); // Create adjacency list
+	// With osm_files listed the binary is only used if it was built from the same files and settings,
+	// without them any valid binary is used, such as the prebuilt maps in resources
+	Binary::FileHeader header;
+	bool has_header = Binary::readHeader(bin_file, header);
+	bool up_to_date = osm_files.empty() ||
+		(has_header && header.source_hash == source_hash && header.config_hash == config_hash);
+	auto decode_start = std::chrono::steady_clock::now();
+	if (up_to_date && Binary::loadFromBinary(bin_file, graph, verify_mapped, &quadtree)) {
+		auto adjacency_start = std::chrono::steady_clock::now();
+		graph.createAdj(); // Create adjacency list, mapped and compact files come with it
+
+		// Mapped files come with the quadtree, unless written without one
+		// Tiling and sorting change the edge IDs, so the quadtree is built again after them
+		bool reordered = matchLayout(graph);
+		bool has_quadtree = !quadtree.empty() && !reordered;
+
+		// Tiles of a mapped tiled file are loaded on demand from now on
+		// A converted graph is already in memory as a whole
+		// Set before the graph is shared with the window
+		if (graph.isTiled() && graph.getArrays().node_ids.isMapped()) {
+			auto cache = std::make_shared<TileCache>(graph, tile_memory_budget);
+			if (has_quadtree) {
+				cache->addEdgeArray(quadtree.getSegments().data(), sizeof(Quadtree::Segment));
+			}
+			graph.setTileCache(cache);
+		}
+		prepareRouting(graph);
+
+		// The graph is complete, routing can start while the quadtree is built
+		auto quadtree_start = std::chrono::steady_clock::now();
+		if (progress) {
+			progress->graph_ready = true;
+		}
+		if (!has_quadtree) {
+			buildQuadtree(graph, quadtree, progress);
+		}
+		else if (progress) {
+			progress->quadtree_ready = true;
+		}
+		auto end = std::chrono::steady_clock::now();
+		std::cout << "Loaded in " << std::chrono::duration_cast<std::chrono::milliseconds>(end - decode_start).count() << " ms: "
+			<< "decode " << std::chrono::duration_cast<std::chrono::milliseconds>(adjacency_start - decode_start).count() << " ms, "
+			<< "adjacency " << std::chrono::duration_cast<std::chrono::milliseconds>(quadtree_start - adjacency_start).count() << " ms, "
+			<< "quadtree " << std::chrono::duration_cast<std::chrono::milliseconds>(end - quadtree_start).count() << " ms\n";
+
+		// Convert the file if binary_format has changed, the graph is the same in every format
+		// Mapped files without a quadtree get one added, and are saved again in the order they are used in
+		// Legacy files without a header are converted too, with no fingerprints as their sources are unknown
+		bool mapped = binary_format == BinaryFormat::Mapped || binary_format == BinaryFormat::Tiled;
+		if (!has_header) {
+			Binary::saveToBinary(bin_file, graph, 0, 0, binary_format, &quadtree);
+		}
+		else if (header.format != binary_format || (mapped && (!has_quadtree || reordered))) {
+			Binary::saveToBinary(bin_file, graph, header.source_hash, header.config_hash, binary_format, &quadtree);
+		}
+		prepareRoutingFiles(graph);
+		if (graph.getCompressedAdjacency()) {
+			graph.dropAdjArrays(); // Routes no longer read them
+		}
 		return true;
 	}
 
+	if (osm_files.empty()) {
+		std::cerr << "Error: Could not load " << bin_file << " and there are no .osm files to build it from" << std::endl;
+		return false;
+	}
+	if (has_header && !up_to_date) {
+		std::cout << "Map files or settings have changed since " << bin_file << " was built, rebuilding...\n";
+	}
+
 	// Initialize bbox with extreme values to ensure proper expansion
 	graph.bbox.min_lat = std::numeric_limits<double>::max();
 	graph.bbox.min_lon = std::numeric_limits<double>::max();
@@ -21,13 +105,180 @@ bool GraphLoader::loadGraph(Graph& graph) {
 	graph.bbox.max_lon = std::numeric_limits<double>::lowest();
 	
 	// Load from OSM files
+	// Files are parsed on a worker pool and merged in the order of osm_files
 	for (const auto& osm_file : osm_files) {
 		std::cout << "Loading " << osm_file << "...\n";
-		ParseOSM::loadMap(osm_file, graph);
 	}
+	auto start = std::chrono::steady_clock::now();
+	size_t dropped = ParseOSM::loadMaps(osm_files, graph, parse_mode, prune_nodes);
+	std::cout << "Parsed " << osm_files.size() << " files in "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+
+	if (prune_nodes) {
+		// Every node is an ID with two coordinates in the binary file
+		constexpr size_t node_binary = sizeof(int64_t) + 2 * sizeof(double);
+		size_t kept = graph.getNodeCount();
+		std::cout << "Pruned " << dropped << " of " << kept + dropped << " nodes not used by any way ("
+			<< std::fixed << std::setprecision(1) << 100.0 * dropped / std::max<size_t>(kept + dropped, 1) << "%), saving "
+			<< dropped * Graph::NODE_MEMORY / (1024.0 * 1024.0) << " MB of memory and "
+			<< dropped * node_binary / (1024.0 * 1024.0) << " MB of binary file\n";
+	}
+
 	graph.createAdj(); // Create adjacency list
+	matchLayout(graph);
+	prepareRouting(graph);
+	if (progress) {
+		progress->graph_ready = true;
+	}
+	buildQuadtree(graph, quadtree, progress);
 
 	// Save to binary
-	Binary::saveToBinary(bin_file, graph);
+	Binary::saveToBinary(bin_file, graph, source_hash, config_hash, binary_format, &quadtree);
+	prepareRoutingFiles(graph);
+	if (graph.getCompressedAdjacency()) {
+		graph.dropAdjArrays(); // Routes no longer read them
+	}
 	return false;
 }
+
+bool GraphLoader::applyChanges(const std::vector<std::string>& osc_files) {
+	if (!std::filesystem::exists(bin_file)) {
+		std::cerr << "Error: No binary file " << bin_file << " to update, run the viewer once to create it" << std::endl;
+		return false;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	Graph graph;
+	if (!Binary::loadFromBinary(bin_file, graph)) {
+		return false;
+	}
+	graph.releaseAdj(); // Changes are applied to the building data, mapped arrays get copied
+
+	// The updated map still counts as built from the same files, keep its fingerprints
+	Binary::FileHeader header;
+	Binary::readHeader(bin_file, header);
+
+	// Edges of files without way IDs can't be matched to the ways in the changes
+	const FlatArray<int64_t>& edge_ways = graph.getEdgeWays();
+	if (!edge_ways.empty() && std::all_of(edge_ways.begin(), edge_ways.end(), [](int64_t way_id) { return way_id == 0; })) {
+		std::cerr << "Warning: " << bin_file << " has no way IDs, changed and deleted ways keep their old edges. "
+			<< "Rebuild it from the .osm files to fix this." << std::endl;
+	}
+
+	for (const auto& osc_file : osc_files) {
+		std::cout << "Applying " << osc_file << "...\n";
+		ParseOSC::Stats stats;
+		if (!ParseOSC::applyChange(osc_file, graph, stats)) {
+			continue;
+		}
+		std::cout << "  Ways changed " << stats.ways_changed
+			<< ", edges +" << stats.edges_added << " -" << stats.edges_removed
+			<< ", nodes moved " << stats.nodes_updated << " +" << stats.nodes_added << " -" << stats.nodes_removed << "\n";
+	}
+
+	graph.createAdj();
+	matchLayout(graph);
+	Quadtree quadtree;
+	if (binary_format == BinaryFormat::Mapped || binary_format == BinaryFormat::Tiled) {
+		quadtree.build(graph);
+	}
+	Binary::saveToBinary(bin_file, graph, header.source_hash, header.config_hash, binary_format, &quadtree);
+	std::cout << "Updated in "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+	return true;
+}
+
+void GraphLoader::buildQuadtree(const Graph& graph, Quadtree& quadtree, LoadProgress* progress) {
+	quadtree.build(graph, 4, progress ? &progress->projection : nullptr);
+	if (progress) {
+		progress->quadtree_ready = true;
+	}
+}
+
+void GraphLoader::prepareRouting(Graph& graph) {
+	if (graph.isTiled()) return;
+	if (label_components && graph.getNodeCount() > 0) {
+		auto start = std::chrono::steady_clock::now();
+		graph.labelComponents();
+		std::cout << "Components: " << graph.getComponentCount() << ", largest " << graph.getComponentSize(0)
+			<< " of " << graph.getNodeCount() << " nodes, labeled in "
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+	}
+	if (compress_adjacency) {
+		auto start = std::chrono::steady_clock::now();
+		auto compressed = std::make_shared<CompressedAdjacency>();
+		compressed->build(graph);
+		size_t edges = std::max<size_t>(graph.getEdges().size(), 1);
+		std::cout << "Compressed adjacency: " << std::fixed << std::setprecision(2)
+			<< static_cast<double>(compressed->memoryBytes()) / edges << " bytes per edge, "
+			<< compressed->memoryBytes() / (1024.0 * 1024.0) << " MB in "
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+		graph.setCompressedAdjacency(std::move(compressed));
+	}
+	if (compress_adjacency || !contract_chains) return;
+	auto start = std::chrono::steady_clock::now();
+	auto routing = std::make_shared<RoutingGraph>();
+	routing->build(graph);
+	std::cout << "Routing graph: " << routing->getJunctionCount() << " of " << graph.getNodeCount() << " nodes, "
+		<< routing->getEdgeCount() << " of " << graph.getEdges().size() << " edges in "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+	graph.setRoutingGraph(std::move(routing));
+}
+
+void GraphLoader::prepareRoutingFiles(Graph& graph) {
+	if (graph.isTiled() || graph.getNodeCount() == 0) return;
+	if (contraction_hierarchy && !compress_adjacency) {
+		auto start = std::chrono::steady_clock::now();
+		auto hierarchy = std::make_shared<ContractionHierarchy>();
+		bool loaded = hierarchy->load(hierarchy_file, graph);
+		if (!loaded) {
+			std::cout << "Building contraction hierarchy...\n";
+			hierarchy->build(graph);
+			hierarchy->save(hierarchy_file, graph);
+		}
+		std::cout << "Contraction hierarchy: " << hierarchy->getShortcutCount() << " shortcuts, "
+			<< std::fixed << std::setprecision(1) << hierarchy->memoryBytes() / (1024.0 * 1024.0) << " MB, "
+			<< (loaded ? "loaded in " : "built in ")
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+		graph.setContractionHierarchy(std::move(hierarchy));
+	}
+	else if (landmark_count > 0) {
+		auto start = std::chrono::steady_clock::now();
+		auto landmarks = std::make_shared<Landmarks>();
+		bool loaded = landmarks->load(landmark_file, graph, landmark_count, landmark_strategy);
+		if (!loaded) {
+			landmarks->build(graph, landmark_count, landmark_strategy);
+			landmarks->save(landmark_file, graph);
+		}
+		std::cout << "Landmarks: " << landmarks->getCount() << ", "
+			<< std::fixed << std::setprecision(1) << landmarks->memoryBytes() / (1024.0 * 1024.0) << " MB, "
+			<< (loaded ? "loaded in " : "computed in ")
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+		graph.setLandmarks(std::move(landmarks));
+	}
+}
+
+bool GraphLoader::matchLayout(Graph& graph) {
+	bool tiled = binary_format == BinaryFormat::Tiled;
+	bool sorted = !tiled && hilbert_order;
+	if (graph.isTiled() == tiled && graph.isHilbertSorted() == sorted) return false;
+	if (tiled) {
+		graph.partitionTiles(tile_grid);
+		return true;
+	}
+
+	// Going back to building sorts the nodes by ID again
+	if (graph.isTiled() || graph.isHilbertSorted()) {
+		graph.releaseAdj();
+		graph.createAdj();
+	}
+	if (sorted) {
+		graph.sortByHilbert();
+	}
+	return true;
+}
+
+uint64_t GraphLoader::configFingerprint() {
+	// Parse mode and thread count don't change the graph, so they're left out
+	return Hash::combine(TagFilter::fingerprint(), prune_nodes);
+}
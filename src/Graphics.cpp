@@ -2,49 +2,50 @@
 #include "Algorithm.hpp"
 #include <iostream>
 #include <future>
+#include <algorithm>
 
-Graphics::Graphics(Graph& graph, float window_width, float window_height) : 
-	graph(graph), window_width(window_width), window_height(window_height),
+Graphics::Graphics(Graph& graph, const Quadtree& quadtree, const LoadProgress& progress, float window_width, float window_height) :
+	graph(graph), quadtree(quadtree), progress(progress), window_width(window_width), window_height(window_height),
 	from_id(UNASSIGNED), target_id(UNASSIGNED)
 {
-	// Initialize Quadtree with window bounds
-	Quadtree::Bounds graph_bounds = { 0, 0, window_width, window_height }; 
-	quadtree = std::make_unique<Quadtree>(graph_bounds);
-
-	// Generate edges and insert to quadtree
-	generateEdges();
-
 	// Initialize window elements
 	initWindowElements();
 }
 
-void Graphics::generateEdges() {
-	// Preallocate space
-	// Expected vertex count is amount of edges * 2
-	const std::unordered_map<uint32_t, Graph::Edge>& edges = graph.getEdges();
-	graph_edges.reserve(edges.size() * 2);
-
-	// Iterate over edges and create vertexes
-	// Transform each node to SFML
-	for (const auto& [id, edge] : edges) {
-		// Get nodes
-		const Graph::Node& from = graph.getNode(edge.from);
-		const Graph::Node& target = graph.getNode(edge.to);
-
-		// Create a new TreeEdge pointer
-		auto tree_edge = std::make_unique<Quadtree::TreeEdge>();
-		tree_edge->id = id;
-		// Calculate sfml coordinates of edge endpoint nodes
-		tree_edge->v1 = transformToSFML(from.lat, from.lon);
-		tree_edge->v2 = transformToSFML(target.lat, target.lon);
-		tree_edge->color = MAP_COLOR; // Initialize to default map color
-		tree_edge->thickness = MAP_THICKNESS; // Standard thickness
-
-		// Insert to datastructure and quadtree
-		Quadtree::TreeEdge* edge_ptr = tree_edge.get();
-		quadtree->insert(edge_ptr);
-		graph_edges[id] = std::move(tree_edge);
+Graphics::ScreenEdge Graphics::makeEdge(uint32_t id, const Quadtree::Segment& segment) const {
+	// Edges are projected to map space once by the quadtree, only scaling to the window is left
+	ScreenEdge edge;
+	edge.id = id;
+	edge.v1 = sf::Vector2f(segment.from.x * window_width, segment.from.y * window_height);
+	edge.v2 = sf::Vector2f(segment.to.x * window_width, segment.to.y * window_height);
+	edge.color = onPath(id) ? PATH_COLOR : MAP_COLOR;
+	edge.thickness = onPath(id) ? PATH_THICKNESS : MAP_THICKNESS;
+	return edge;
+}
+
+bool Graphics::onPath(uint32_t id) const {
+	// The lookup is created with the first route
+	return id < found_path_lookup.size() && found_path_lookup[id];
+}
+
+std::vector<Graphics::ScreenEdge> Graphics::previewEdges(const Quadtree::Bounds& window_bounds) const {
+	std::vector<ScreenEdge> result;
+	size_t projected = progress.projection.projected.load(std::memory_order_acquire);
+	if (projected == 0) {
+		return result;
 	}
+
+	// Check every edge projected so far, there is no tree to narrow them down yet
+	Quadtree::Bounds map_bounds = toMapBounds(window_bounds);
+	const Quadtree::Segment* segments = progress.projection.segments->data();
+	for (uint32_t id = 0; id < projected; ++id) {
+		const Quadtree::Segment& segment = segments[id];
+		if (std::max(segment.from.x, segment.to.x) >= map_bounds.left && std::min(segment.from.x, segment.to.x) <= map_bounds.right &&
+			std::max(segment.from.y, segment.to.y) >= map_bounds.top && std::min(segment.from.y, segment.to.y) <= map_bounds.bottom) {
+			result.push_back(makeEdge(id, segment));
+		}
+	}
+	return result;
 }
 
 void Graphics::initWindowElements() {
@@ -62,34 +63,12 @@ void Graphics::initWindowElements() {
 	target_circle.setOutlineColor(sf::Color::White);
 }
 
-sf::Vector2f Graphics::transformToSFML(double lat, double lon) {
-	// Prevent division by zero
-	double lat_range = std::max(graph.bbox.max_lat - graph.bbox.min_lat, 1e-6);
-	double lon_range = std::max(graph.bbox.max_lon - graph.bbox.min_lon, 1e-6);
-
-	// Calculate normalized latitude and longitude for correct graphics coordinates
-	double normalized_y = (graph.bbox.max_lat - lat) / lat_range;
-	double normalized_x = (lon - graph.bbox.min_lon) / lon_range;
-
-	// Scale to window size
-	float x = static_cast<float>(normalized_x * window_width);
-	float y = static_cast<float>(normalized_y * window_height);
-
-	return sf::Vector2f(x, y);
-}
-
-void Graphics::changeEdgeColor(uint32_t id, sf::Color new_color, float new_thickness) {
-	std::lock_guard<std::mutex> lock(graphics_mutex);
-
-	// Find the edge by ID
-	auto it = graph_edges.find(id);
-	if (it == graph_edges.end()) {
-		std::cerr << "Edge with ID " << id << " not found!" << std::endl;
-		return;
-	}
-	// Change the color and thickness
-	it->second->color = new_color;
-	it->second->thickness = new_thickness;
+sf::Vector2f Graphics::transformToSFML(int64_t id) {
+	// Scale the position in map space to window size
+	uint32_t index = static_cast<uint32_t>(graph.findIndex(id));
+	Quadtree::Point point;
+	Quadtree::project(graph, &index, 1, &point);
+	return sf::Vector2f(point.x * window_width, point.y * window_height);
 }
 
 Quadtree::Bounds Graphics::getViewBounds(const sf::View& view) {
@@ -104,24 +83,45 @@ Quadtree::Bounds Graphics::getViewBounds(const sf::View& view) {
 	};
 }
 
-sf::Vector2f* Graphics::getClosestNode(const sf::Vector2f& world_pos, const std::vector<Quadtree::TreeEdge*>& edges, int64_t& selected_id) {
-	sf::Vector2f* closest_node = nullptr;
+Quadtree::Bounds Graphics::toMapBounds(const Quadtree::Bounds& window_bounds) const {
+	// The quadtree works in map space, where the window spans 0..1
+	return {
+		window_bounds.left / window_width, window_bounds.top / window_height,
+		window_bounds.right / window_width, window_bounds.bottom / window_height
+	};
+}
+
+std::vector<Graphics::ScreenEdge> Graphics::queryEdges(const Quadtree::Bounds& window_bounds) {
+	std::vector<uint32_t> ids;
+	quadtree.query(toMapBounds(window_bounds), ids);
+
+	std::vector<ScreenEdge> result;
+	result.reserve(ids.size());
+	const FlatArray<Quadtree::Segment>& segments = quadtree.getSegments();
+	for (uint32_t id : ids) {
+		result.push_back(makeEdge(id, segments[id]));
+	}
+	return result;
+}
+
+const sf::Vector2f* Graphics::getClosestNode(const sf::Vector2f& world_pos, const std::vector<ScreenEdge>& edges, int64_t& selected_id) {
+	const sf::Vector2f* closest_node = nullptr;
 	float min_distance = std::numeric_limits<float>::max();
 	// Iterate over all edges and find the closest node
-	for (auto* edge : edges) {
-		float dist1 = distance(world_pos, edge->v1);
-		float dist2 = distance(world_pos, edge->v2);
+	for (const auto& edge : edges) {
+		float dist1 = distance(world_pos, edge.v1);
+		float dist2 = distance(world_pos, edge.v2);
 		if (dist1 < min_distance) {
 			min_distance = dist1;
-			closest_node = &edge->v1;
-			selected_id = graph.getEdge(edge->id).from;
+			closest_node = &edge.v1;
+			selected_id = graph.getEdge(edge.id).from;
 			// Check if selected id is same as already selected node (from or target). If so, return
 			if (selected_id == from_id || selected_id == target_id) break;
 		}
 		if (dist2 < min_distance) {
 			min_distance = dist2;
-			closest_node = &edge->v2;
-			selected_id = graph.getEdge(edge->id).to;
+			closest_node = &edge.v2;
+			selected_id = graph.getEdge(edge.id).to;
 
 			if (selected_id == from_id || selected_id == target_id) break;
 		}
@@ -129,24 +129,28 @@ sf::Vector2f* Graphics::getClosestNode(const sf::Vector2f& world_pos, const std:
 	return closest_node;
 }
 
+void Graphics::keepLargestComponent(std::vector<ScreenEdge>& edges) const {
+	if (!graph.hasComponents()) return;
+
+	// Both ends of an edge are in the same component, component 0 is the largest
+	auto outside = [&](const ScreenEdge& edge) {
+		return graph.getComponent(static_cast<uint32_t>(graph.findIndex(graph.getEdge(edge.id).from))) != 0;
+	};
+	if (std::all_of(edges.begin(), edges.end(), outside)) return; // Only fragments in reach, they can still be selected
+	edges.erase(std::remove_if(edges.begin(), edges.end(), outside), edges.end());
+}
+
 float Graphics::distance(const sf::Vector2f& p1, const sf::Vector2f& p2) {
 	float dx = p1.x - p2.x;
 	float dy = p1.y - p2.y;
 	return std::sqrt(dx * dx + dy * dy);
 }
 
-void Graphics::highlightPath(const std::vector<uint32_t>& path, sf::Color new_color, float new_thickness) {
-	// Loop over every edge id in current path and change color
-	for (uint32_t id : path) {
-		changeEdgeColor(id, new_color, new_thickness);
-	}
-}
-
-void Graphics::renderEdges(std::vector<Quadtree::TreeEdge*> new_visible_edges, sf::VertexArray& rendered_edges, sf::VertexArray& rendered_path) {
+void Graphics::renderEdges(const std::vector<ScreenEdge>& new_visible_edges, sf::VertexArray& rendered_edges, sf::VertexArray& rendered_path) {
 	// Go over visible edges and create two triangles per edge to add to the vertexarray to render
 	for (const auto& edge : new_visible_edges) {
-		const sf::Vector2f& start = edge->v1;
-		const sf::Vector2f& end = edge->v2;
+		const sf::Vector2f& start = edge.v1;
+		const sf::Vector2f& end = edge.v2;
 
 		sf::Vector2f direction = end - start; // Calculate direction of line
 		float length = std::sqrt(direction.x * direction.x + direction.y * direction.y); // Calculate the length (sqrt(x^2+y^2))
@@ -156,19 +160,19 @@ void Graphics::renderEdges(std::vector<Quadtree::TreeEdge*> new_visible_edges, s
 		// Calculate the offset vector
 		// Offset vector will be the side of the triangle perpendicular to the line rendered
 		// Has length of 1/2 of the desired line thickness since line will be expanded to both sides
-		sf::Vector2f offset = normal * (edge->thickness * 0.5f);
+		sf::Vector2f offset = normal * (edge.thickness * 0.5f);
 
 		// Create the two triangles
-		sf::Vertex triangle1_a(start - offset, edge->color);
-		sf::Vertex triangle1_b(start + offset, edge->color);
-		sf::Vertex triangle1_c(end + offset, edge->color);
+		sf::Vertex triangle1_a(start - offset, edge.color);
+		sf::Vertex triangle1_b(start + offset, edge.color);
+		sf::Vertex triangle1_c(end + offset, edge.color);
 
-		sf::Vertex triangle2_a(start - offset, edge->color);
-		sf::Vertex triangle2_b(end + offset, edge->color);
-		sf::Vertex triangle2_c(end - offset, edge->color);
+		sf::Vertex triangle2_a(start - offset, edge.color);
+		sf::Vertex triangle2_b(end + offset, edge.color);
+		sf::Vertex triangle2_c(end - offset, edge.color);
 
 		// Append to either VertexArray depending on if edge is on path
-		if (found_path_lookup.contains(edge->id)) {
+		if (onPath(edge.id)) {
 			rendered_path.append(triangle1_a);
 			rendered_path.append(triangle1_b);
 			rendered_path.append(triangle1_c);
@@ -196,9 +200,16 @@ void Graphics::render(sf::RenderWindow& window, const sf::View& view) {
 	// Get the bounding box of the current view
 	Quadtree::Bounds view_bounds = getViewBounds(view);
 
-	// Get the visible edges from the quadtree
-	std::vector<Quadtree::TreeEdge*> new_visible_edges;
-	quadtree->query(view_bounds, new_visible_edges);
+	// Get the visible edges from the quadtree, or from the edges projected so far while it is built
+	std::vector<ScreenEdge> new_visible_edges;
+	if (progress.quadtree_ready) {
+		// Load the tiles in view of tiled maps before their edges are read
+		graph.loadTiles(Quadtree::toEarth(graph.bbox, toMapBounds(view_bounds)));
+		new_visible_edges = queryEdges(view_bounds);
+	}
+	else {
+		new_visible_edges = previewEdges(view_bounds);
+	}
 
 	// Update visible edges to queried and calculate triangles (lines) to render
 	renderEdges(new_visible_edges, rendered_edges, rendered_path);
@@ -223,43 +234,25 @@ void Graphics::rescaleGraphics(float new_width, float new_height) {
 
 	// Calculate new coordinates for selection circles
 	if (from_id != UNASSIGNED) {
-		const Graph::Node& from_node = graph.getNode(from_id);
-		sf::Vector2f from_pos = transformToSFML(from_node.lat, from_node.lon);
+		sf::Vector2f from_pos = transformToSFML(from_id);
 		from_circle.setOrigin({ CLICK_RADIUS,CLICK_RADIUS });
 		from_circle.setPosition({ from_pos });
 	}
 	if (target_id != UNASSIGNED) {
-		const Graph::Node& target_node = graph.getNode(target_id);
-		sf::Vector2f target_pos = transformToSFML(target_node.lat, target_node.lon);
+		sf::Vector2f target_pos = transformToSFML(target_id);
 		target_circle.setOrigin({ CLICK_RADIUS,CLICK_RADIUS });
 		target_circle.setPosition({ target_pos });
 	}
 
-	// Initialize new Quadtree with new window bounds
-	Quadtree::Bounds graph_bounds = { 0, 0, window_width, window_height };
-	quadtree = std::make_unique<Quadtree>(graph_bounds);
-
-	// Update nodes graphics coordinates with new window size
-	for (auto& [id, edge_ptr] : graph_edges) {
-		auto& edge = *edge_ptr;  // Dereference the pointer to get the actual edge
-
-		// Get nodes by edge id
-		const Graph::Edge& graph_edge = graph.getEdge(id);
-		const Graph::Node& from = graph.getNode(graph_edge.from);
-		const Graph::Node& target = graph.getNode(graph_edge.to);
-
-		sf::Vector2f pos1 = transformToSFML(from.lat, from.lon);
-		sf::Vector2f pos2 = transformToSFML(target.lat, target.lon);
-
-		edge.v1 = pos1;
-		edge.v2 = pos2;
-
-		// Insert into the new Quadtree
-		quadtree->insert(&edge);
-	};
+	// Edges are scaled to the new size when they are next drawn
 }
 
 void Graphics::selectNode(sf::RenderWindow& window, const sf::View& view, const sf::Vector2i& mouse_pos) {
+	// Nodes can be selected once the quadtree is done
+	if (!progress.quadtree_ready) {
+		return;
+	}
+
 	// Convert pixel coordinates to world coordinates
 	sf::Vector2f world_pos = window.mapPixelToCoords(mouse_pos, view);
 
@@ -267,17 +260,20 @@ void Graphics::selectNode(sf::RenderWindow& window, const sf::View& view, const
 	Quadtree::Bounds query_bounds = { world_pos.x - CLICK_RADIUS, world_pos.y - CLICK_RADIUS, world_pos.x + CLICK_RADIUS, world_pos.y + CLICK_RADIUS };
 
 	// Query the quadtree for edges within the bounding box
-	std::vector<Quadtree::TreeEdge*> result;
-	quadtree->query(query_bounds, result);
+	std::vector<ScreenEdge> result = queryEdges(query_bounds);
 
 	// Check if any edges were within the bounding box
 	if (result.empty()) { 
 		return;
 	}
 
+	if (SNAP_TO_LARGEST_COMPONENT) {
+		keepLargestComponent(result);
+	}
+
 	// Get the closest node to the click position
 	int64_t selected_id = UNASSIGNED;
-	sf::Vector2f* closest_node = getClosestNode(world_pos, result, selected_id);
+	const sf::Vector2f* closest_node = getClosestNode(world_pos, result, selected_id);
 	if (closest_node) {
 		// Check if we have already selected the same node
 		// If so, deselect it
@@ -308,10 +304,19 @@ void Graphics::findRoute() {
 		std::cerr << "Both from and target nodes must be selected!" << std::endl;
 		return;
 	}
+	if (!progress.graph_ready) {
+		std::cerr << "The map is still loading, routing is available once it is ready!" << std::endl;
+		return;
+	}
+	if (found_path_lookup.size() != graph.getEdges().size()) {
+		found_path_lookup.assign(graph.getEdges().size(), false);
+	}
 
-	highlightPath(found_path, MAP_COLOR, MAP_THICKNESS); // Reset edge colors and thickness of previous path
+	// Edges take their color and thickness from the lookup when drawn
+	for (uint32_t id : found_path) {
+		found_path_lookup[id] = false; // Only the previous path is set, no need to clear the whole array
+	}
 	found_path.clear(); // Clear previous path
-	found_path_lookup.clear();
 
 	// Run A* algorithm in a separate thread
 	// This is done to prevent the GUI from freezing
@@ -325,9 +330,7 @@ void Graphics::findRoute() {
 		std::cout << "No route found!" << std::endl;
 		return;
 	}
-	// Highlight the found path
-	highlightPath(found_path, PATH_COLOR, PATH_THICKNESS);
-	
+
 	if (distance < 1000) {
 		// Display full meters if distance is less than a kilometer
 		std::cout << "Distance: " << static_cast<int>(distance) << "m" << std::endl;
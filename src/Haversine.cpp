@@ -0,0 +1,200 @@
+#include "Haversine.hpp"
+#include "Graph.hpp"
+#include <array>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HAVERSINE_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+// Radians per fixed-point unit, halved for the half angles of the formula
+constexpr double HALF_FIXED_TO_RADIANS = PI / 180.0 / COORDINATE_SCALE / 2.0;
+constexpr double FIXED_TO_RADIANS = PI / 180.0 / COORDINATE_SCALE;
+constexpr double HALF_PI = PI / 2.0;
+
+// Taylor series coefficients, lowest power first
+// sin(x) = x * sum SIN[n] x^2n and cos(x) = sum COS[n] x^2n, accurate to about 1e-16 on [-pi/2, pi/2]
+// asin(x) = x * sum ASIN[n] x^2n, accurate to about 1e-16 for x up to sin(pi/12)
+constexpr size_t SIN_TERMS = 10;
+constexpr size_t COS_TERMS = 11;
+constexpr size_t ASIN_TERMS = 13;
+
+constexpr std::array<double, SIN_TERMS> sinCoefficients() {
+	std::array<double, SIN_TERMS> c{};
+	double term = 1;
+	for (size_t n = 0; n < SIN_TERMS; ++n) {
+		c[n] = term;
+		term = -term / ((2.0 * n + 2) * (2.0 * n + 3));
+	}
+	return c;
+}
+
+constexpr std::array<double, COS_TERMS> cosCoefficients() {
+	std::array<double, COS_TERMS> c{};
+	double term = 1;
+	for (size_t n = 0; n < COS_TERMS; ++n) {
+		c[n] = term;
+		term = -term / ((2.0 * n + 1) * (2.0 * n + 2));
+	}
+	return c;
+}
+
+constexpr std::array<double, ASIN_TERMS> asinCoefficients() {
+	// (2n)! / (4^n (n!)^2 (2n + 1))
+	std::array<double, ASIN_TERMS> c{};
+	double central = 1; // (2n)! / (4^n (n!)^2)
+	for (size_t n = 0; n < ASIN_TERMS; ++n) {
+		c[n] = central / (2.0 * n + 1);
+		central *= (2.0 * n + 1) / (2.0 * n + 2);
+	}
+	return c;
+}
+
+constexpr std::array<double, SIN_TERMS> SIN = sinCoefficients();
+constexpr std::array<double, COS_TERMS> COS = cosCoefficients();
+constexpr std::array<double, ASIN_TERMS> ASIN = asinCoefficients();
+
+// Sum of c[n] * z^n by Horner's rule
+template <size_t N>
+static double polynomial(const std::array<double, N>& c, double z) {
+	double sum = c[N - 1];
+	for (size_t n = N - 1; n-- > 0;) {
+		sum = sum * z + c[n];
+	}
+	return sum;
+}
+
+// Arcsine of x in [0, 1]
+// Above 0.5 the reflection asin(x) = pi/2 - 2 asin(sqrt((1 - x) / 2)) brings x down to 0.5,
+// then the half angle formula asin(x) = 2 asin(x / sqrt(2 (1 + sqrt(1 - x^2)))) down to sin(pi/12) for the series
+static double arcsine(double x) {
+	bool reflect = x > 0.5;
+	double t = reflect ? std::sqrt((1 - x) / 2) : x;
+	double u = t / std::sqrt(2 * (1 + std::sqrt(1 - t * t)));
+	double half = 2 * u * polynomial(ASIN, u * u);
+	return reflect ? HALF_PI - 2 * half : half;
+}
+
+static double distanceScalar(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2) {
+	double phi1 = lat1 * FIXED_TO_RADIANS;
+	double phi2 = lat2 * FIXED_TO_RADIANS;
+	double half_phi = (static_cast<double>(lat2) - lat1) * HALF_FIXED_TO_RADIANS;
+
+	// sin^2 is the same for x and pi - |x|, which keeps the longitude half angle within pi/2
+	double half_lambda = std::abs(static_cast<double>(lon2) - lon1) * HALF_FIXED_TO_RADIANS;
+	half_lambda = half_lambda > HALF_PI ? PI - half_lambda : half_lambda;
+
+	double sin_phi = half_phi * polynomial(SIN, half_phi * half_phi);
+	double sin_lambda = half_lambda * polynomial(SIN, half_lambda * half_lambda);
+	double cos_phi1 = polynomial(COS, phi1 * phi1);
+	double cos_phi2 = polynomial(COS, phi2 * phi2);
+
+	// a = sin^2(delta_phi / 2) + cos(phi1) * cos(phi2) * sin^2(delta_lambda / 2), d = 2 * R * asin(sqrt(a))
+	double a = sin_phi * sin_phi + cos_phi1 * cos_phi2 * sin_lambda * sin_lambda;
+	return 2 * R * arcsine(std::sqrt(std::min(a, 1.0)));
+}
+
+#ifdef HAVERSINE_AVX2
+template <size_t N>
+AVX2_TARGET static __m256d polynomial4(const std::array<double, N>& c, __m256d z) {
+	__m256d sum = _mm256_set1_pd(c[N - 1]);
+	for (size_t n = N - 1; n-- > 0;) {
+		sum = _mm256_fmadd_pd(sum, z, _mm256_set1_pd(c[n]));
+	}
+	return sum;
+}
+
+// Four int32 values as doubles
+AVX2_TARGET static __m256d load4(const int32_t* values) {
+	return _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values)));
+}
+
+// distanceScalar on four pairs at a time, both branches of every choice are computed and blended
+AVX2_TARGET static void distancesAvx2(const int32_t* lat1, const int32_t* lon1, const int32_t* lat2, const int32_t* lon2,
+	size_t count, double* out) {
+	const __m256d to_radians = _mm256_set1_pd(FIXED_TO_RADIANS);
+	const __m256d half_to_radians = _mm256_set1_pd(HALF_FIXED_TO_RADIANS);
+	const __m256d half_pi = _mm256_set1_pd(HALF_PI);
+	const __m256d pi = _mm256_set1_pd(PI);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d two = _mm256_set1_pd(2.0);
+	const __m256d half = _mm256_set1_pd(0.5);
+	const __m256d diameter = _mm256_set1_pd(2 * R);
+	const __m256d sign_mask = _mm256_set1_pd(-0.0);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m256d la1 = load4(lat1 + i), la2 = load4(lat2 + i);
+		__m256d lo1 = load4(lon1 + i), lo2 = load4(lon2 + i);
+		__m256d phi1 = _mm256_mul_pd(la1, to_radians);
+		__m256d phi2 = _mm256_mul_pd(la2, to_radians);
+		__m256d half_phi = _mm256_mul_pd(_mm256_sub_pd(la2, la1), half_to_radians);
+		__m256d half_lambda = _mm256_andnot_pd(sign_mask, _mm256_mul_pd(_mm256_sub_pd(lo2, lo1), half_to_radians));
+		half_lambda = _mm256_blendv_pd(half_lambda, _mm256_sub_pd(pi, half_lambda), _mm256_cmp_pd(half_lambda, half_pi, _CMP_GT_OQ));
+
+		__m256d sin_phi = _mm256_mul_pd(half_phi, polynomial4(SIN, _mm256_mul_pd(half_phi, half_phi)));
+		__m256d sin_lambda = _mm256_mul_pd(half_lambda, polynomial4(SIN, _mm256_mul_pd(half_lambda, half_lambda)));
+		__m256d cos_phi1 = polynomial4(COS, _mm256_mul_pd(phi1, phi1));
+		__m256d cos_phi2 = polynomial4(COS, _mm256_mul_pd(phi2, phi2));
+
+		__m256d cos_product = _mm256_mul_pd(cos_phi1, cos_phi2);
+		__m256d a = _mm256_fmadd_pd(_mm256_mul_pd(cos_product, sin_lambda), sin_lambda, _mm256_mul_pd(sin_phi, sin_phi));
+		__m256d x = _mm256_sqrt_pd(_mm256_min_pd(a, one));
+
+		// arcsine
+		__m256d reflect = _mm256_cmp_pd(x, half, _CMP_GT_OQ);
+		__m256d t = _mm256_blendv_pd(x, _mm256_sqrt_pd(_mm256_mul_pd(_mm256_sub_pd(one, x), half)), reflect);
+		__m256d root = _mm256_sqrt_pd(_mm256_fnmadd_pd(t, t, one));
+		__m256d u = _mm256_div_pd(t, _mm256_sqrt_pd(_mm256_mul_pd(two, _mm256_add_pd(one, root))));
+		__m256d angle = _mm256_mul_pd(_mm256_mul_pd(two, u), polynomial4(ASIN, _mm256_mul_pd(u, u)));
+		angle = _mm256_blendv_pd(angle, _mm256_fnmadd_pd(two, angle, half_pi), reflect);
+
+		_mm256_storeu_pd(out + i, _mm256_mul_pd(diameter, angle));
+	}
+	for (; i < count; ++i) {
+		out[i] = distanceScalar(lat1[i], lon1[i], lat2[i], lon2[i]);
+	}
+}
+#endif
+
+bool Haversine::hasSimd() {
+#if defined(HAVERSINE_AVX2) && defined(_MSC_VER) && !defined(__clang__)
+	// AVX2 and FMA flags of the CPU, and the OS saving the AVX registers
+	static const bool supported = []() {
+		int info[4];
+		__cpuid(info, 1);
+		bool fma = (info[2] & (1 << 12)) != 0;
+		bool os_saves = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0;
+		return fma && os_saves && avx2;
+	}();
+	return supported;
+#elif defined(HAVERSINE_AVX2)
+	static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	return supported;
+#else
+	return false;
+#endif
+}
+
+void Haversine::distances(const int32_t* lat1, const int32_t* lon1, const int32_t* lat2, const int32_t* lon2,
+	size_t count, double* out, bool use_simd) {
+#ifdef HAVERSINE_AVX2
+	if (use_simd && hasSimd()) {
+		distancesAvx2(lat1, lon1, lat2, lon2, count, out);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; ++i) {
+		out[i] = distanceScalar(lat1[i], lon1[i], lat2[i], lon2[i]);
+	}
+}
@@ -0,0 +1,295 @@
+#include "Landmarks.hpp"
+#include "Parallel.hpp"
+#include "Hash.hpp"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <functional>
+#include <queue>
+#include <random>
+#include <cmath>
+
+constexpr float UNREACHED = std::numeric_limits<float>::infinity();
+
+// Distances are stored as floats, each rounded by at most this fraction of itself
+// Bounds give up that much of the two distances they come from, so that they never overestimate
+constexpr double FLOAT_ROUNDING = 6e-8;
+
+// Fixed seed for the random roots of the avoid strategy, the same graph gets the same landmarks
+constexpr unsigned int AVOID_SEED = 1;
+
+void Landmarks::build(const Graph& graph, unsigned int count, LandmarkStrategy new_strategy) {
+	strategy = new_strategy;
+	asked = count;
+	landmarks.clear();
+	distances.clear();
+	size_t num_nodes = graph.getNodeCount();
+	if (num_nodes == 0 || count == 0) return;
+
+	// Landmarks outside the largest component would only bound the routes in their own
+	std::vector<uint32_t> candidates;
+	candidates.reserve(graph.hasComponents() ? graph.getComponentSize(0) : num_nodes);
+	for (uint32_t i = 0; i < num_nodes; ++i) {
+		if (!graph.hasComponents() || graph.getComponent(i) == 0) {
+			candidates.push_back(i);
+		}
+	}
+	count = static_cast<unsigned int>(std::min<size_t>(count, candidates.size()));
+
+	std::vector<std::vector<float>> tables;
+	if (strategy == LandmarkStrategy::Farthest) {
+		pickFarthest(graph, count, candidates, tables);
+	}
+	else {
+		pickAvoid(graph, count, candidates, tables);
+	}
+
+	// Node major, so that the bounds of one node read one cache line
+	size_t stored = landmarks.size();
+	distances.resize(num_nodes * stored);
+	for (size_t l = 0; l < stored; ++l) {
+		for (size_t i = 0; i < num_nodes; ++i) {
+			distances[i * stored + l] = tables[l][i];
+		}
+	}
+}
+
+void Landmarks::distancesFrom(const Graph& graph, uint32_t start, std::vector<float>& out,
+	std::vector<uint32_t>* parents, std::vector<uint32_t>* order) {
+	size_t num_nodes = graph.getNodeCount();
+	std::vector<double> dist(num_nodes, std::numeric_limits<double>::infinity());
+	if (parents) {
+		parents->assign(num_nodes, NONE);
+	}
+	if (order) {
+		order->clear();
+	}
+
+	using Entry = std::pair<double, uint32_t>;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+	dist[start] = 0;
+	queue.push({ 0, start });
+	while (!queue.empty()) {
+		auto [d, node] = queue.top();
+		queue.pop();
+		if (d > dist[node]) continue;
+		if (order) {
+			order->push_back(node);
+		}
+		for (const auto& [neighbor, weight, edge_id] : graph.getNeighborsAt(node)) {
+			double g = d + weight;
+			if (g < dist[neighbor]) {
+				dist[neighbor] = g;
+				if (parents) {
+					(*parents)[neighbor] = node;
+				}
+				queue.push({ g, neighbor });
+			}
+		}
+	}
+
+	out.resize(num_nodes);
+	for (size_t i = 0; i < num_nodes; ++i) {
+		out[i] = static_cast<float>(dist[i]);
+	}
+}
+
+void Landmarks::pickFarthest(const Graph& graph, unsigned int count, const std::vector<uint32_t>& candidates,
+	std::vector<std::vector<float>>& tables) {
+	// Straight line distances stand in for road distances while picking, so no table is needed before the last pick
+	// The first landmark is the candidate farthest from the first one, every next one the farthest from its closest landmark
+	std::vector<double> closest(candidates.size(), std::numeric_limits<double>::infinity());
+	std::vector<double> from_node(candidates.size());
+	graph.getHaversineDistances(candidates.data(), candidates.size(), graph.getNodeAt(candidates[0]), from_node.data());
+	uint32_t next = candidates[std::max_element(from_node.begin(), from_node.end()) - from_node.begin()];
+	while (landmarks.size() < count) {
+		landmarks.push_back(next);
+		graph.getHaversineDistances(candidates.data(), candidates.size(), graph.getNodeAt(next), from_node.data());
+		for (size_t i = 0; i < candidates.size(); ++i) {
+			closest[i] = std::min(closest[i], from_node[i]);
+		}
+		next = candidates[std::max_element(closest.begin(), closest.end()) - closest.begin()];
+	}
+
+	// Every table on its own thread
+	tables.resize(landmarks.size());
+	Parallel::forEach(landmarks.size(), [&](size_t l) {
+		distancesFrom(graph, landmarks[l], tables[l]);
+	});
+}
+
+void Landmarks::pickAvoid(const Graph& graph, unsigned int count, const std::vector<uint32_t>& candidates,
+	std::vector<std::vector<float>>& tables) {
+	// Grow a shortest path tree from a random root and weigh every node by how much the distance from the root
+	// exceeds the best landmark bound, then follow the heaviest subtrees without a landmark down to a leaf
+	// Routes into that part of the tree are bounded worst, so the leaf becomes the next landmark
+	size_t num_nodes = graph.getNodeCount();
+	std::mt19937 rng(AVOID_SEED);
+	std::uniform_int_distribution<size_t> pick(0, candidates.size() - 1);
+	std::vector<float> tree_dist, table;
+	std::vector<uint32_t> parents, order, heaviest_child(num_nodes);
+	std::vector<double> subtree(num_nodes);
+	std::vector<bool> is_landmark(num_nodes, false), holds_landmark(num_nodes);
+	uint32_t pending = NONE; // Picked in the last round, its table not computed yet
+
+	// Roots whose tree ends at a landmark give nothing, so there are a few more tries than landmarks
+	for (size_t tries = 0; landmarks.size() < count && tries < 4 * size_t(count); ++tries) {
+		uint32_t root = landmarks.empty() ? candidates[0] : candidates[pick(rng)];
+
+		// The tree of this round doesn't depend on the last landmark, so its table is computed alongside
+		Parallel::forEach(pending == NONE ? 1 : 2, [&](size_t task) {
+			if (task == 0) {
+				distancesFrom(graph, root, tree_dist, &parents, &order);
+			}
+			else {
+				distancesFrom(graph, pending, table);
+			}
+		});
+		if (pending != NONE) {
+			tables.push_back(std::move(table));
+			pending = NONE;
+		}
+
+		// Children are settled after their parents, so going backwards every subtree is complete before its parent
+		for (uint32_t node : order) {
+			double bound = 0;
+			for (const std::vector<float>& from_landmark : tables) {
+				if (from_landmark[node] == UNREACHED || from_landmark[root] == UNREACHED) continue;
+				bound = std::max(bound, std::abs(static_cast<double>(from_landmark[node]) - from_landmark[root]));
+			}
+			subtree[node] = std::max(0.0, tree_dist[node] - bound);
+			heaviest_child[node] = NONE;
+			holds_landmark[node] = is_landmark[node];
+		}
+		for (size_t i = order.size(); i-- > 1;) {
+			uint32_t node = order[i], parent = parents[node];
+			if (holds_landmark[node]) {
+				holds_landmark[parent] = true;
+				continue;
+			}
+			subtree[parent] += subtree[node];
+			if (subtree[node] > 0 && (heaviest_child[parent] == NONE || subtree[node] > subtree[heaviest_child[parent]])) {
+				heaviest_child[parent] = node;
+			}
+		}
+
+		uint32_t leaf = root;
+		while (heaviest_child[leaf] != NONE) {
+			leaf = heaviest_child[leaf];
+		}
+		if (is_landmark[leaf]) continue;
+		is_landmark[leaf] = true;
+		landmarks.push_back(leaf);
+		pending = leaf;
+	}
+	if (pending != NONE) {
+		distancesFrom(graph, pending, table);
+		tables.push_back(std::move(table));
+	}
+}
+
+void Landmarks::aim(uint32_t target, Target& out) const {
+	out.landmarks.clear();
+	out.distances.clear();
+	size_t count = landmarks.size();
+	for (size_t l = 0; l < count; ++l) {
+		float distance = distances[target * count + l];
+		if (distance == UNREACHED) continue;
+		out.landmarks.push_back(static_cast<uint32_t>(l));
+		out.distances.push_back(distance);
+	}
+}
+
+void Landmarks::raiseBounds(const uint32_t* indices, size_t count, const Target& target, double* bounds) const {
+	size_t stride = landmarks.size();
+	for (size_t i = 0; i < count; ++i) {
+		const float* row = &distances[indices[i] * stride];
+		double bound = bounds[i];
+		for (size_t k = 0; k < target.landmarks.size(); ++k) {
+			// A node the landmark can't reach while it reaches the target has no route to it, the bound is infinite
+			double to_node = row[target.landmarks[k]], to_target = target.distances[k];
+			double difference = std::abs(to_target - to_node) - FLOAT_ROUNDING * (to_target + to_node);
+			bound = std::max(bound, difference);
+		}
+		bounds[i] = bound;
+	}
+}
+
+size_t Landmarks::memoryBytes() const {
+	return landmarks.size() * sizeof(uint32_t) + distances.size() * sizeof(float);
+}
+
+// Hash of the arrays, stored in the file to catch damage
+static uint64_t dataHash(const std::vector<uint32_t>& landmarks, const std::vector<float>& distances) {
+	return Hash::combine(Hash::bytes(landmarks.data(), landmarks.size() * sizeof(uint32_t)),
+		Hash::bytes(distances.data(), distances.size() * sizeof(float)));
+}
+
+bool Landmarks::save(const std::string& file_path, const Graph& graph) const {
+	std::ofstream out_file(file_path, std::ios::binary);
+	if (!out_file) {
+		std::cerr << "Error: Could not write the landmarks to " << file_path << std::endl;
+		return false;
+	}
+	uint64_t graph_hash = graph.adjacencyFingerprint();
+	uint64_t num_nodes = graph.getNodeCount();
+	uint32_t setting[3] = { asked, static_cast<uint32_t>(strategy), static_cast<uint32_t>(landmarks.size()) };
+	uint64_t data_hash = dataHash(landmarks, distances);
+	out_file.write(LANDMARKS_MAGIC, sizeof(LANDMARKS_MAGIC));
+	out_file.write(reinterpret_cast<const char*>(&LANDMARKS_VERSION), sizeof(LANDMARKS_VERSION));
+	out_file.write(reinterpret_cast<const char*>(&graph_hash), sizeof(graph_hash));
+	out_file.write(reinterpret_cast<const char*>(&num_nodes), sizeof(num_nodes));
+	out_file.write(reinterpret_cast<const char*>(setting), sizeof(setting));
+	out_file.write(reinterpret_cast<const char*>(&data_hash), sizeof(data_hash));
+	out_file.write(reinterpret_cast<const char*>(landmarks.data()), landmarks.size() * sizeof(uint32_t));
+	out_file.write(reinterpret_cast<const char*>(distances.data()), distances.size() * sizeof(float));
+	if (!out_file) {
+		std::cerr << "Error: Could not write the landmarks to " << file_path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Landmarks::load(const std::string& file_path, const Graph& graph, unsigned int count, LandmarkStrategy expected) {
+	std::ifstream in_file(file_path, std::ios::binary);
+	if (!in_file) return false;
+
+	char magic[4];
+	uint32_t version = 0;
+	uint64_t graph_hash = 0, num_nodes = 0, data_hash = 0;
+	uint32_t setting[3] = {};
+	in_file.read(magic, sizeof(magic));
+	in_file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	in_file.read(reinterpret_cast<char*>(&graph_hash), sizeof(graph_hash));
+	in_file.read(reinterpret_cast<char*>(&num_nodes), sizeof(num_nodes));
+	in_file.read(reinterpret_cast<char*>(setting), sizeof(setting));
+	in_file.read(reinterpret_cast<char*>(&data_hash), sizeof(data_hash));
+	if (!in_file || !std::equal(magic, magic + 4, LANDMARKS_MAGIC) || version != LANDMARKS_VERSION) {
+		std::cerr << "Error: " << file_path << " is not a landmark file of this version" << std::endl;
+		return false;
+	}
+	if (num_nodes != graph.getNodeCount() || graph_hash != graph.adjacencyFingerprint()) {
+		std::cout << file_path << " was built for another graph\n";
+		return false;
+	}
+
+	if (setting[0] != count || setting[1] != static_cast<uint32_t>(expected)) {
+		std::cout << file_path << " has other landmarks than asked for\n";
+		return false;
+	}
+
+	std::vector<uint32_t> new_landmarks(setting[2]);
+	std::vector<float> new_distances(num_nodes * setting[2]);
+	in_file.read(reinterpret_cast<char*>(new_landmarks.data()), new_landmarks.size() * sizeof(uint32_t));
+	in_file.read(reinterpret_cast<char*>(new_distances.data()), new_distances.size() * sizeof(float));
+	if (!in_file || dataHash(new_landmarks, new_distances) != data_hash) {
+		std::cerr << "Error: " << file_path << " is truncated or corrupted" << std::endl;
+		return false;
+	}
+	landmarks = std::move(new_landmarks);
+	distances = std::move(new_distances);
+	strategy = expected;
+	asked = count;
+	return true;
+}
@@ -0,0 +1,113 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <cstdint>
+
+// Size of a memory page
+static size_t pageSize() {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwPageSize;
+#else
+	return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string& file_path) {
+	file_handle = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_handle == INVALID_HANDLE_VALUE) {
+		file_handle = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0) {
+		return false;
+	}
+	length = static_cast<size_t>(file_size.QuadPart);
+
+	mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping_handle) {
+		return false;
+	}
+	begin = static_cast<const char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	return begin != nullptr;
+}
+
+void MappedFile::prefetch(const void* data, size_t size) {
+	if (size == 0) return;
+	WIN32_MEMORY_RANGE_ENTRY range = { const_cast<void*>(data), size };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+void MappedFile::evict(const void* data, size_t size) {
+	// Pages of a read-only mapping leave the working set when unlocked, and the page cache drops them when needed
+	size_t page = pageSize();
+	uintptr_t first = (reinterpret_cast<uintptr_t>(data) + page - 1) / page * page;
+	uintptr_t last = (reinterpret_cast<uintptr_t>(data) + size) / page * page;
+	if (last > first) {
+		VirtualUnlock(reinterpret_cast<void*>(first), last - first);
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (begin) UnmapViewOfFile(begin);
+	if (mapping_handle) CloseHandle(mapping_handle);
+	if (file_handle) CloseHandle(file_handle);
+}
+#else
+bool MappedFile::open(const std::string& file_path) {
+	int fd = ::open(file_path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	length = static_cast<size_t>(file_stat.st_size);
+
+	// The mapping stays valid after the descriptor is closed
+	void* address = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (address == MAP_FAILED) {
+		length = 0;
+		return false;
+	}
+	begin = static_cast<const char*>(address);
+	return true;
+}
+
+void MappedFile::prefetch(const void* data, size_t size) {
+	if (size == 0) return;
+	// madvise needs a page aligned start
+	size_t page = pageSize();
+	uintptr_t first = reinterpret_cast<uintptr_t>(data) / page * page;
+	uintptr_t last = reinterpret_cast<uintptr_t>(data) + size;
+	madvise(reinterpret_cast<void*>(first), last - first, MADV_WILLNEED);
+}
+
+void MappedFile::evict(const void* data, size_t size) {
+	size_t page = pageSize();
+	uintptr_t first = (reinterpret_cast<uintptr_t>(data) + page - 1) / page * page;
+	uintptr_t last = (reinterpret_cast<uintptr_t>(data) + size) / page * page;
+	if (last > first) {
+		madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (begin) munmap(const_cast<char*>(begin), length);
+}
+#endif
@@ -0,0 +1,152 @@
+#include "ParseOSC.hpp"
+#include "ParseOSM.hpp"
+#include "rapidxml.hpp"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <functional>
+
+bool ParseOSC::applyChange(const std::string& file_path, Graph& graph, Stats& stats) {
+	// Change files are small compared to the map, read the whole file
+	std::ifstream file(file_path, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Error: Could not open file " << file_path << std::endl;
+		return false;
+	}
+	std::streamsize file_size = file.tellg();
+	file.seekg(0, std::ios::beg);
+	std::vector<char> content(file_size + 1);
+	file.read(content.data(), file_size);
+	content[file_size] = '\0';
+	file.close();
+
+	rapidxml::xml_document<> doc;
+	try {
+		doc.parse<0>(content.data());
+	}
+	catch (const rapidxml::parse_error& e) {
+		std::cerr << "Error: Invalid OSC file " << file_path << ": " << e.what() << std::endl;
+		return false;
+	}
+	auto root = doc.first_node("osmChange");
+	if (!root) {
+		std::cerr << "Error: No <osmChange> found in " << file_path << std::endl;
+		return false;
+	}
+
+	// Latest version of every way in the file, refs are left empty for deleted or filtered out ways
+	struct WayChange {
+		bool keep = false; // Way exists after the change and passes our filter
+		std::vector<int64_t> refs;
+	};
+	std::unordered_map<int64_t, WayChange> way_changes;
+	std::unordered_map<int64_t, Graph::Node> new_nodes; // Nodes not in the graph yet, added when a way uses them
+	std::vector<int64_t> deleted_nodes;
+
+	// Collect changes in file order, so later versions replace earlier ones
+	for (auto action = root->first_node(); action; action = action->next_sibling()) {
+		std::string_view action_name = action->name();
+		bool is_delete = action_name == "delete";
+		if (!is_delete && action_name != "create" && action_name != "modify") continue;
+
+		for (auto element = action->first_node(); element; element = element->next_sibling()) {
+			std::string_view element_name = element->name();
+			int64_t id;
+			if (!ParseOSM::parseAttribute(element.get(), "id", id)) continue;
+
+			if (element_name == "node") {
+				Graph::Node node;
+				if (is_delete) {
+					deleted_nodes.push_back(id);
+					new_nodes.erase(id);
+				}
+				else if (ParseOSM::parseAttribute(element.get(), "lat", node.lat) &&
+					ParseOSM::parseAttribute(element.get(), "lon", node.lon)) {
+					// Moving a node only overwrites its coordinates, createAdj computes the edge weights once the changes are in
+					// Nodes moved outside the bounds get dropped with their edges, same as when parsing
+					bool inside = graph.bbox.contains(node.lat, node.lon);
+					if (graph.hasNode(id) && inside) {
+						graph.updateNode(id, node);
+						++stats.nodes_updated;
+					}
+					else if (graph.hasNode(id)) {
+						deleted_nodes.push_back(id);
+					}
+					else if (inside) {
+						new_nodes[id] = node;
+					}
+				}
+			}
+			else if (element_name == "way") {
+				WayChange& change = way_changes[id];
+				change.keep = !is_delete;
+				change.refs.clear();
+				if (is_delete) continue;
+
+				// Check all tags in the way to make sure way passes our filter
+				for (auto tag = element->first_node("tag"); tag && change.keep; tag = tag->next_sibling("tag")) {
+					auto key = tag->first_attribute("k");
+					auto value = tag->first_attribute("v");
+					if (key && value) change.keep = ParseOSM::isValidWay(key->value(), value->value());
+				}
+				for (auto nd = element->first_node("nd"); nd && change.keep; nd = nd->next_sibling("nd")) {
+					int64_t ref;
+					if (ParseOSM::parseAttribute(nd.get(), "ref", ref)) change.refs.push_back(ref);
+				}
+			}
+		}
+	}
+
+	// Remove the old edges of every changed way
+	// Highest ID first, so the last edge moved into a freed ID is never one still waiting for removal
+	if (!way_changes.empty()) {
+		const FlatArray<int64_t>& edge_ways = graph.getEdgeWays();
+		std::vector<uint32_t> removed;
+		for (uint32_t edge_id = 0; edge_id < edge_ways.size(); ++edge_id) {
+			if (way_changes.count(edge_ways[edge_id])) removed.push_back(edge_id);
+		}
+		for (auto it = removed.rbegin(); it != removed.rend(); ++it) {
+			graph.removeEdge(*it);
+		}
+		stats.edges_removed += removed.size();
+		stats.ways_changed += way_changes.size();
+	}
+
+	// Add the new edges of created and modified ways
+	for (const auto& [way_id, change] : way_changes) {
+		for (size_t i = 1; i < change.refs.size(); ++i) {
+			int64_t from = change.refs[i - 1], to = change.refs[i];
+
+			// Bring in new nodes the first time they're used
+			bool has_endpoints = true;
+			for (int64_t node_id : { from, to }) {
+				if (graph.hasNode(node_id)) continue;
+				auto it = new_nodes.find(node_id);
+				if (it == new_nodes.end()) {
+					has_endpoints = false;
+					break;
+				}
+				graph.addNode(node_id, it->second);
+				new_nodes.erase(it);
+				++stats.nodes_added;
+			}
+			if (has_endpoints && graph.addEdge({ from, to }, way_id)) {
+				++stats.edges_added;
+			}
+		}
+	}
+
+	// Delete nodes last, a way releasing a node is usually in the same file
+	std::vector<int64_t> removed_nodes;
+	for (int64_t node_id : deleted_nodes) {
+		if (graph.hasNode(node_id)) removed_nodes.push_back(node_id);
+	}
+	size_t edge_count = graph.getEdges().size();
+	graph.removeNodes(removed_nodes);
+	stats.edges_removed += edge_count - graph.getEdges().size();
+	stats.nodes_removed += removed_nodes.size();
+	return true;
+}
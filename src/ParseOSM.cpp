@@ -1,15 +1,15 @@
 #include "ParseOSM.hpp"
+#include "ParsePBF.hpp"
+#include "Parallel.hpp"
 #include "rapidxml.hpp"
-#include <unordered_set>
+#include "TagFilter.hpp"
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include <vector>
-#include <chrono>
+#include <algorithm>
+#include <charconv>
 
-std::atomic<uint32_t> ParseOSM::counter(0); // Initialize counter to 0
-
-void ParseOSM::parseOSM(const std::string& filePath, Graph& graph) {
+void ParseOSM::parseOSM(const std::string& filePath, PartialGraph& partial) {
     // Read the file into a dynamically allocated buffer
     std::ifstream file(filePath, std::ios::ate | std::ios::binary);
     if (!file.is_open()) {
@@ -40,153 +40,504 @@ void ParseOSM::parseOSM(const std::string& filePath, Graph& graph) {
 
     // Find map bounds
     rapidxml::optional_ptr<rapidxml::xml_node<char>> bounds_node_opt = root_opt->first_node("bounds");
-    if (bounds_node_opt) {
-        try {
-            rapidxml::xml_node<>* bounds_node = bounds_node_opt.get();  // Extract raw pointer
-            // Extract and convert attributes
-            double min_lat = std::stod(std::string(bounds_node->first_attribute("minlat")->value()));
-            double min_lon = std::stod(std::string(bounds_node->first_attribute("minlon")->value()));
-            double max_lat = std::stod(std::string(bounds_node->first_attribute("maxlat")->value()));
-            double max_lon = std::stod(std::string(bounds_node->first_attribute("maxlon")->value()));
-
-            // Expand bounding box to include new file's bounds
-            graph.bbox.min_lat = std::min(graph.bbox.min_lat, min_lat);
-            graph.bbox.min_lon = std::min(graph.bbox.min_lon, min_lon);
-            graph.bbox.max_lat = std::max(graph.bbox.max_lat, max_lat);
-            graph.bbox.max_lon = std::max(graph.bbox.max_lon, max_lon);
-        }
-        catch (const std::exception& e) {
-            std::cerr << "Error: Invalid <bounds> in OSM file." << std::endl;
-            return;
-        }
-    }
-    else {
+    if (!bounds_node_opt) {
         std::cerr << "Error: No <bounds> found in OSM file." << std::endl;
         return;
     }
+    if (!parseBounds(bounds_node_opt.get(), partial)) {
+        return;
+    }
 
     // Iterate over child nodes
     for (auto node = root->first_node(); node; node = node->next_sibling()) {
-        std::string nodeName(node->name());
+        std::string_view nodeName = node->name();
 
         // Parse Node elements
         if (nodeName == "node") {
-            if (!node->first_attribute("id") || !node->first_attribute("lat") || !node->first_attribute("lon")) {
-                continue;  // Skip invalid nodes
+            parseNode(node.get(), partial);
+        }
+
+        // Parse Way elements
+        else if (nodeName == "way") {
+            parseWay(node.get(), partial);
+        }
+    }
+}
+
+void ParseOSM::streamOSM(const std::string& file_path, PartialGraph& partial, uint64_t begin, uint64_t end) {
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file " << file_path << std::endl;
+        return;
+    }
+    file.seekg(begin);
+
+    // Buffer holds the unparsed tail of the previous chunk followed by the next chunk
+    // Only the part starting from pos is still unparsed
+    std::string buffer;
+    std::vector<char> chunk(STREAM_CHUNK_SIZE);
+    size_t pos = 0;
+    uint64_t buffer_offset = begin; // File offset of the start of buffer
+
+    // Bounds are already known when parsing a chunk from the middle of a file
+    bool has_bounds = partial.bbox.min_lat <= partial.bbox.max_lat;
+
+    // A single document is reused for every element
+    // Clearing it releases the nodes of the previous element
+    auto doc = std::make_unique<rapidxml::xml_document<>>();
+
+    while (true) {
+        std::string_view element;
+        Scan scan = scanElement(buffer, pos, element);
+
+        if (scan == Scan::Incomplete) {
+            // Drop consumed data and read the next chunk behind the unfinished element
+            buffer_offset += pos;
+            buffer.erase(0, pos);
+            pos = 0;
+            if (buffer_offset >= end) {
+                break; // Rest belongs to the next range
             }
+            file.read(chunk.data(), chunk.size());
+            if (file.gcount() == 0) {
+                break; // End of file
+            }
+            buffer.append(chunk.data(), file.gcount());
+            continue;
+        }
+        if (scan == Scan::Skip) {
+            continue;
+        }
 
-            Graph::Node n;
-            int64_t node_id = std::stoll(std::string(node->first_attribute("id")->value())); // Cast id to int64_t
-            // Cast coordinates to double
-            n.lat = std::stod(std::string(node->first_attribute("lat")->value()));
-            n.lon = std::stod(std::string(node->first_attribute("lon")->value()));
+        // Elements starting at the end of the range belong to the next range
+        if (buffer_offset + (element.data() - buffer.data()) >= end) {
+            break;
+        }
 
-            // Add to graph if passes filter
-            if (graph.bbox.contains(n.lat, n.lon)) {
-                graph.addNode(node_id, n);
+        // Parse the single element with rapidxml and pass it to the shared handlers
+        doc->clear();
+        doc->parse<0>(element);
+        rapidxml::xml_node<>* node = doc->first_node().get();
+        std::string_view node_name = node->name();
+
+        if (node_name == "bounds") {
+            if (!parseBounds(node, partial)) {
+                return;
+            }
+            has_bounds = true;
+        }
+        else if (node_name == "node" || node_name == "way") {
+            // <bounds> always precedes the data in a valid file
+            if (!has_bounds) {
+                std::cerr << "Error: No <bounds> found in OSM file." << std::endl;
+                return;
+            }
+            if (node_name == "node") {
+                parseNode(node, partial);
+            }
+            else {
+                parseWay(node, partial);
             }
         }
+    }
 
-        // Parse Way elements
-        else if (nodeName == "way") {
-            if (!node->first_attribute("id")) continue;  // Skip invalid ways
-
-            // Check all tags in the way to make sure way passes our filter
-            bool isValid = true; // Flag to detect invalid way
-            for (auto tag = node->first_node("tag"); tag; tag = tag->next_sibling("tag")) {
-                std::string key = std::string(tag->first_attribute("k")->value());
-                std::string value = std::string(tag->first_attribute("v")->value());
-
-                // Use helper function to determine if this way is invalid
-                if (!isValidWay(key, value)) {
-                    isValid = false;
-                    break;
-                }
+    if (!has_bounds) {
+        std::cerr << "Error: No <bounds> found in OSM file." << std::endl;
+    }
+}
+
+bool ParseOSM::readBounds(const std::string& file_path, Graph::Bounds& bbox) {
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file " << file_path << std::endl;
+        return false;
+    }
+
+    // <bounds> is one of the first elements, so reading a chunk at a time is plenty
+    std::string buffer;
+    std::vector<char> chunk(64 * 1024);
+    size_t pos = 0;
+    PartialGraph header;
+    auto doc = std::make_unique<rapidxml::xml_document<>>();
+
+    while (true) {
+        std::string_view element;
+        Scan scan = scanElement(buffer, pos, element);
+
+        if (scan == Scan::Incomplete) {
+            buffer.erase(0, pos);
+            pos = 0;
+            file.read(chunk.data(), chunk.size());
+            if (file.gcount() == 0) {
+                break;
+            }
+            buffer.append(chunk.data(), file.gcount());
+            continue;
+        }
+        if (scan == Scan::Skip) {
+            continue;
+        }
+
+        doc->clear();
+        doc->parse<0>(element);
+        rapidxml::xml_node<>* node = doc->first_node().get();
+        if (node->name() != "bounds") {
+            break; // Data started without bounds
+        }
+        if (!parseBounds(node, header)) {
+            return false;
+        }
+        bbox = header.bbox;
+        return true;
+    }
+
+    std::cerr << "Error: No <bounds> found in OSM file." << std::endl;
+    return false;
+}
+
+std::vector<uint64_t> ParseOSM::splitFile(const std::string& file_path, size_t parts) {
+    std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+    uint64_t file_size = file.is_open() ? static_cast<uint64_t>(file.tellg()) : 0;
+
+    // Keep chunks large enough to be worth a task
+    parts = std::max<size_t>(1, std::min<size_t>(parts, file_size / PARALLEL_MIN_CHUNK_SIZE));
+
+    std::vector<uint64_t> offsets = { 0 };
+    for (size_t k = 1; k < parts; ++k) {
+        uint64_t offset = findElementStart(file, file_size * k / parts);
+        if (offset > offsets.back() && offset < file_size) {
+            offsets.push_back(offset);
+        }
+    }
+    offsets.push_back(file_size);
+    return offsets;
+}
+
+uint64_t ParseOSM::findElementStart(std::ifstream& file, uint64_t offset) {
+    // Only these elements appear at the top level of an .osm file
+    // '<' is always escaped inside attribute values, so any '<' starts markup
+    static const std::string_view top_level[] = { "node", "way", "relation" };
+
+    file.clear();
+    file.seekg(offset);
+    std::string window;
+    std::vector<char> chunk(64 * 1024);
+    size_t pos = 0;
+
+    while (true) {
+        file.read(chunk.data(), chunk.size());
+        size_t read = file.gcount();
+        window.append(chunk.data(), read);
+
+        for (pos = window.find('<', pos); pos != std::string::npos; pos = window.find('<', pos + 1)) {
+            // Need the name and one character after it
+            if (pos + 10 > window.size() && read > 0) {
+                break;
             }
-            if (!isValid) continue;
-
-            // Get all node references in the way
-            auto node_refs = std::make_unique<std::vector<int64_t>>();  // Heap allocation
-            for (auto nd = node->first_node("nd"); nd; nd = nd->next_sibling("nd")) {
-                node_refs->push_back(std::stoll(std::string(nd->first_attribute("ref")->value())));
-            }
-
-            for (size_t i = 1; i < node_refs->size(); ++i) {
-				// Get source and target nodes for edge
-				int64_t from = (*node_refs)[i - 1];
-                int64_t to = (*node_refs)[i];
-                
-                // Ensure both source and target nodes of the edge exists
-                // Meaning neither have been filtered out
-				// Also check that the edge does not already exist
-                if (graph.hasNode(from) && graph.hasNode(to) && !graph.hasEdge(from,to)) {
-                    // Generate id for edge
-                    uint32_t edge_id = generateUniqueID();
-					graph.addEdge(edge_id, {from,to}); // Add edge to graph
+            for (std::string_view name : top_level) {
+                size_t after = pos + 1 + name.size();
+                if (window.compare(pos + 1, name.size(), name) == 0 && after < window.size() &&
+                    std::string_view(" \t\r\n/>").find(window[after]) != std::string_view::npos) {
+                    return offset + pos;
                 }
             }
         }
+        if (read == 0) {
+            return offset + window.size(); // No element after offset
+        }
+        if (pos == std::string::npos) {
+            pos = window.size();
+        }
     }
 }
 
-bool ParseOSM::isValidWay(const std::string& key, const std::string& value) {
-    static const std::unordered_set<std::string> non_routable_keys = {
-        "boundary", "building", "landuse", "waterway", "vessel", "ferry",
-        "seamark:type"
-    };
+ParseOSM::Scan ParseOSM::scanElement(std::string_view buffer, size_t& pos, std::string_view& element) {
+    size_t start = buffer.find('<', pos);
+    if (start == std::string_view::npos || start + 1 >= buffer.size()) {
+        // Keep a trailing '<' for the next round
+        pos = (start == std::string_view::npos) ? buffer.size() : start;
+        return Scan::Incomplete;
+    }
+    pos = start;
 
-    if (non_routable_keys.count(key)) return false;
+    // Prolog (<?xml ... ?>), comments and doctype
+    if (buffer[start + 1] == '?' || buffer[start + 1] == '!') {
+        std::string_view terminator = buffer.substr(start).starts_with("<!--") ? "-->" : ">";
+        size_t end = buffer.find(terminator, start);
+        if (end == std::string_view::npos) {
+            return Scan::Incomplete;
+        }
+        pos = end + terminator.size();
+        return Scan::Skip;
+    }
 
-    // Exclude area boundaries
-    if (key == "area" && value == "yes") return false;
+    // Closing tag of the root (</osm>)
+    if (buffer[start + 1] == '/') {
+        size_t end = buffer.find('>', start);
+        if (end == std::string_view::npos) {
+            return Scan::Incomplete;
+        }
+        pos = end + 1;
+        return Scan::Skip;
+    }
 
-    // Exclude private/proposed access restrictions
-    if (key == "access" && (value == "private" || value == "no")) return false;
-    if (key == "highway" && value == "proposed") return false;
+    // Find the end of the start tag, '>' is allowed inside quoted attribute values
+    size_t tag_end = start + 1;
+    char quote = 0;
+    for (; tag_end < buffer.size(); ++tag_end) {
+        char c = buffer[tag_end];
+        if (quote) {
+            if (c == quote) quote = 0;
+        }
+        else if (c == '"' || c == '\'') {
+            quote = c;
+        }
+        else if (c == '>') {
+            break;
+        }
+    }
+    if (tag_end == buffer.size()) {
+        return Scan::Incomplete;
+    }
 
-    // Exclude boat routes, ferries, and other non-road navigational routes
-    if (key == "route" && (value == "boat" || value == "ferry" || value == "ship" || value == "seaway")) return false;
-    if (key == "highway" && (value == "ferry" || value == "path")) return false;
-    if (key == "service" && value == "ferry") return false;
-    if (key == "motorboat" && (value == "yes" || value == "designated")) return false;
-    if (key == "transport_mode" && (value == "boat" || value == "ship")) return false;
+    // Element name ends at whitespace, '/' or '>'
+    size_t name_end = buffer.find_first_of(" \t\r\n/>", start + 1);
+    std::string_view name = buffer.substr(start + 1, name_end - start - 1);
 
-    // Exclude underground and underwater ways
-    if ((key == "tunnel" && (value == "yes" || value == "culvert")) ||
-        (key == "covered" && value == "yes") ||
-        (key == "location" && (value == "underground" || value == "underwater"))) {
-        return false;
+    // Step inside the root element instead of treating it as one huge element
+    if (name == "osm") {
+        pos = tag_end + 1;
+        return Scan::Skip;
     }
 
-    // Exclude public transport routes
-    if (key == "route" && (
-        value == "bus" || value == "trolleybus" || value == "tram" || value == "subway" ||
-        value == "train" || value == "light_rail" || value == "monorail")) {
-        return false;
+    size_t end = tag_end + 1;
+    if (buffer[tag_end - 1] != '/') {
+        // Element has children, find the matching closing tag
+        // OSM elements never nest inside an element of the same name
+        size_t close = tag_end;
+        while (true) {
+            close = buffer.find("</", close);
+            if (close == std::string_view::npos) {
+                return Scan::Incomplete;
+            }
+            if (buffer.substr(close + 2, name.size()) == name &&
+                close + 2 + name.size() < buffer.size() && buffer[close + 2 + name.size()] == '>') {
+                break;
+            }
+            close += 2;
+        }
+        end = close + 2 + name.size() + 1;
     }
 
-    // Exclude public transport infrastructure
-    if (key == "public_transport" && (value == "platform" || value == "stop_position")) return false;
+    element = buffer.substr(start, end - start);
+    pos = end;
+    return Scan::Element;
+}
+
+template <typename T>
+bool ParseOSM::parseAttribute(const rapidxml::xml_node<char>* node, std::string_view name, T& value) {
+    auto attribute = node->first_attribute(name);
+    if (!attribute) return false;
 
-    // Exclude railway-based public transport
-    if (key == "railway" && (
-        value == "subway" || value == "tram" || value == "light_rail" || value == "monorail")) {
+    // Attribute value points into the file buffer, no copies
+    std::string_view text = attribute->value();
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc();
+}
+
+// ParseOSC decodes the same attribute types
+template bool ParseOSM::parseAttribute<int64_t>(const rapidxml::xml_node<char>*, std::string_view, int64_t&);
+template bool ParseOSM::parseAttribute<double>(const rapidxml::xml_node<char>*, std::string_view, double&);
+
+bool ParseOSM::parseBounds(const rapidxml::xml_node<char>* bounds_node, PartialGraph& partial) {
+    // Extract and convert attributes
+    double min_lat, min_lon, max_lat, max_lon;
+    if (!parseAttribute(bounds_node, "minlat", min_lat) || !parseAttribute(bounds_node, "minlon", min_lon) ||
+        !parseAttribute(bounds_node, "maxlat", max_lat) || !parseAttribute(bounds_node, "maxlon", max_lon)) {
+        std::cerr << "Error: Invalid <bounds> in OSM file." << std::endl;
         return false;
     }
 
+    // Expand bounding box to include the file's bounds
+    partial.bbox.expand({ min_lat, max_lat, min_lon, max_lon });
     return true;
 }
 
-uint32_t ParseOSM::generateUniqueID() {
-    // Get the current time in nanoseconds since the epoch
-    auto now = std::chrono::high_resolution_clock::now();
-    auto nanos = std::chrono::time_point_cast<std::chrono::nanoseconds>(now).time_since_epoch().count();
+void ParseOSM::parseNode(const rapidxml::xml_node<char>* node, PartialGraph& partial) {
+    // Numbers are decoded straight from the file buffer
+    Graph::Node n;
+    int64_t node_id;
+    if (!parseAttribute(node, "id", node_id) || !parseAttribute(node, "lat", n.lat) || !parseAttribute(node, "lon", n.lon)) {
+        return;  // Skip invalid nodes
+    }
 
-    // Use only the lower 32 bits of the timestamp
-    uint32_t nanos_32 = static_cast<uint32_t>(nanos & 0xFFFFFFFF);
+    // Store if passes filter
+    if (partial.bbox.contains(n.lat, n.lon)) {
+        partial.nodes.emplace_back(node_id, n);
+    }
+}
 
-    // Combine the lower 16 bits of the counter with the lower 32 bits of the timestamp
-    uint32_t unique_ID = ((nanos_32 & 0xFFFF) << 16) | (counter.fetch_add(1, std::memory_order_relaxed) & 0xFFFF);
+void ParseOSM::parseWay(const rapidxml::xml_node<char>* way, PartialGraph& partial) {
+    int64_t way_id;
+    if (!parseAttribute(way, "id", way_id)) return;  // Skip invalid ways
+
+    // Check all tags in the way to make sure way passes our filter
+    for (auto tag = way->first_node("tag"); tag; tag = tag->next_sibling("tag")) {
+        auto key = tag->first_attribute("k");
+        auto value = tag->first_attribute("v");
+        if (!key || !value) continue;
+
+        // Use helper function to determine if this way is invalid
+        if (!isValidWay(key->value(), value->value())) {
+            return;
+        }
+    }
+
+    // Store every consecutive pair of node references as a segment
+    // Segments become edges in the merge once all nodes are known
+    int64_t prev_ref = 0;
+    bool has_prev = false;
+    uint32_t segment_count = 0;
+    for (auto nd = way->first_node("nd"); nd; nd = nd->next_sibling("nd")) {
+        int64_t ref;
+        if (!parseAttribute(nd.get(), "ref", ref)) continue;
+        if (has_prev) {
+            partial.segments.push_back({ prev_ref, ref });
+            ++segment_count;
+        }
+        prev_ref = ref;
+        has_prev = true;
+    }
+    if (segment_count > 0) {
+        partial.ways.emplace_back(way_id, segment_count);
+    }
+}
+
+size_t ParseOSM::mergePartials(std::vector<PartialGraph>& partials, Graph& graph, bool prune_nodes) {
+    // Combine bounding boxes
+    for (const auto& partial : partials) {
+        graph.bbox.expand(partial.bbox);
+    }
 
-    return unique_ID;
-}
\ No newline at end of file
+    // First pass: collect every node referenced by a segment of a valid way
+    // A sorted vector takes a third of the memory of a hash set for the same IDs
+    std::vector<int64_t> referenced;
+    if (prune_nodes) {
+        for (const auto& partial : partials) {
+            for (const auto& [from, to] : partial.segments) {
+                referenced.push_back(from);
+                referenced.push_back(to);
+            }
+        }
+        std::sort(referenced.begin(), referenced.end());
+        referenced.erase(std::unique(referenced.begin(), referenced.end()), referenced.end());
+    }
+
+    // Second pass: add nodes, boundary nodes present in several files are stored once
+    std::vector<int64_t> dropped;
+    for (auto& partial : partials) {
+        for (const auto& [node_id, node] : partial.nodes) {
+            if (prune_nodes && !std::binary_search(referenced.begin(), referenced.end(), node_id)) {
+                dropped.push_back(node_id);
+                continue;
+            }
+            graph.addNode(node_id, node);
+        }
+        std::vector<std::pair<int64_t, Graph::Node>>().swap(partial.nodes); // Release memory
+    }
+    std::vector<int64_t>().swap(referenced);
+
+    // Count a node dropped from several overlapping files only once
+    std::sort(dropped.begin(), dropped.end());
+    size_t dropped_count = std::unique(dropped.begin(), dropped.end()) - dropped.begin();
+
+    // Resolve segments to edges now that every node is known
+    // Edge IDs are handed out in merge order, so they are dense and the same on every run
+    std::vector<int64_t> way_ids;
+    for (auto& partial : partials) {
+        size_t way = 0; // Way of the current segment
+        uint32_t way_left = partial.ways.empty() ? 0 : partial.ways[0].second;
+        way_ids.resize(partial.segments.size());
+        for (size_t i = 0; i < partial.segments.size(); ++i) {
+            while (way_left == 0 && way + 1 < partial.ways.size()) {
+                way_left = partial.ways[++way].second;
+            }
+            way_ids[i] = way < partial.ways.size() ? partial.ways[way].first : 0;
+            --way_left;
+        }
+
+        // Segments with a node that has been filtered out are skipped, as are duplicates
+        graph.addEdges(partial.segments, way_ids);
+        std::vector<Graph::Edge>().swap(partial.segments);
+        std::vector<std::pair<int64_t, uint32_t>>().swap(partial.ways);
+    }
+    return dropped_count;
+}
+
+size_t ParseOSM::loadMaps(const std::vector<std::string>& file_paths, Graph& graph, ParseMode mode, bool prune_nodes, unsigned threads) {
+    if (threads == 0) threads = Parallel::threadCount();
+
+    // A task parses the byte range [begin, end) of a file into its own partial graph
+    // For PBF files the range is a single compressed blob
+    struct Task {
+        const std::string* file_path;
+        uint64_t begin, end;
+        bool pbf;
+    };
+    std::vector<Task> tasks;
+    std::vector<PartialGraph> partials;
+
+    for (const auto& file_path : file_paths) {
+        if (ParsePBF::isPBF(file_path)) {
+            // Every blob is independent, so PBF files are always decoded in parallel
+            Graph::Bounds bbox;
+            std::vector<ParsePBF::Blob> blobs;
+            if (!ParsePBF::readIndex(file_path, bbox, blobs)) {
+                continue;
+            }
+            for (const auto& blob : blobs) {
+                tasks.push_back({ &file_path, blob.offset, blob.offset + blob.size, true });
+                partials.emplace_back().bbox = bbox;
+            }
+        }
+        else if (mode == ParseMode::Parallel) {
+            // Every chunk needs the bounds of the file to filter its nodes
+            Graph::Bounds bbox;
+            if (!readBounds(file_path, bbox)) {
+                continue;
+            }
+            // Split at element boundaries, a few chunks per thread to balance uneven chunks
+            std::vector<uint64_t> offsets = splitFile(file_path, threads * 4);
+            for (size_t k = 0; k + 1 < offsets.size(); ++k) {
+                tasks.push_back({ &file_path, offsets[k], offsets[k + 1], false });
+                partials.emplace_back().bbox = bbox;
+            }
+        }
+        else {
+            tasks.push_back({ &file_path, 0, UINT64_MAX, false });
+            partials.emplace_back();
+        }
+    }
+
+    // Decode nodes and ways on all threads
+    Parallel::forEach(tasks.size(), [&](size_t i) {
+        const Task& task = tasks[i];
+        if (task.pbf) {
+            ParsePBF::decodeBlob(*task.file_path, { task.begin, static_cast<uint32_t>(task.end - task.begin) }, partials[i]);
+        }
+        else if (mode == ParseMode::DOM) {
+            parseOSM(*task.file_path, partials[i]);
+        }
+        else {
+            streamOSM(*task.file_path, partials[i], task.begin, task.end);
+        }
+    }, threads);
+
+    // Ways get resolved to edges only after the node table is complete
+    return mergePartials(partials, graph, prune_nodes);
+}
+
+bool ParseOSM::isValidWay(std::string_view key, std::string_view value) {
+    // Rules and their perfect hash table are in TagFilter
+    return TagFilter::isValidTag(key, value);
+}
@@ -0,0 +1,359 @@
+#include "ParsePBF.hpp"
+#include <iostream>
+#include <fstream>
+
+#ifdef MAPVIEWER_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+// Size limits from the PBF specification, anything larger means a corrupted file
+constexpr uint32_t MAX_BLOB_HEADER_SIZE = 64 * 1024;
+constexpr uint32_t MAX_BLOB_SIZE = 32 * 1024 * 1024;
+
+// Minimal protobuf wire format reader over a byte buffer
+// Call next() to move to the following field, then read its value with the function matching its type
+struct ProtoReader {
+	const uint8_t* pos;
+	const uint8_t* end;
+	uint32_t field = 0; // Field number of current field
+	uint32_t wire_type = 0; // Wire type of current field
+
+	explicit ProtoReader(std::string_view data) :
+		pos(reinterpret_cast<const uint8_t*>(data.data())), end(pos + data.size()) {}
+
+	// Move to the next field, returns false at the end of the buffer
+	bool next() {
+		if (pos >= end) return false;
+		uint64_t key = varint();
+		field = static_cast<uint32_t>(key >> 3);
+		wire_type = static_cast<uint32_t>(key & 0x7);
+		return true;
+	}
+
+	bool empty() const {
+		return pos >= end;
+	}
+
+	uint64_t varint() {
+		uint64_t value = 0;
+		for (int shift = 0; pos < end && shift < 64; shift += 7) {
+			uint8_t byte = *pos++;
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) break;
+		}
+		return value;
+	}
+
+	// Zigzag decoded signed varint (sint32/sint64)
+	int64_t svarint() {
+		uint64_t value = varint();
+		return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+	}
+
+	// Length delimited field (bytes, strings, messages and packed arrays)
+	std::string_view bytes() {
+		uint64_t size = varint();
+		if (size > static_cast<uint64_t>(end - pos)) size = end - pos; // Truncated field
+		std::string_view view(reinterpret_cast<const char*>(pos), size);
+		pos += size;
+		return view;
+	}
+
+	// Skip the value of current field
+	void skip() {
+		switch (wire_type) {
+		case 0: varint(); break;
+		case 1: pos += 8; break;
+		case 2: bytes(); break;
+		case 5: pos += 4; break;
+		default: pos = end; break; // Groups are deprecated and never used by OSM
+		}
+	}
+};
+
+bool ParsePBF::isPBF(const std::string& file_path) {
+	return file_path.size() >= 4 && file_path.compare(file_path.size() - 4, 4, ".pbf") == 0;
+}
+
+bool ParsePBF::readIndex(const std::string& file_path, Graph::Bounds& bbox, std::vector<Blob>& blobs) {
+	std::ifstream file(file_path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Error: Could not open file " << file_path << std::endl;
+		return false;
+	}
+
+	std::string header;
+	while (true) {
+		// Blob header size is stored as big endian
+		uint8_t size_bytes[4];
+		if (!file.read(reinterpret_cast<char*>(size_bytes), 4)) {
+			break; // End of file
+		}
+		uint32_t header_size = (size_bytes[0] << 24) | (size_bytes[1] << 16) | (size_bytes[2] << 8) | size_bytes[3];
+		if (header_size > MAX_BLOB_HEADER_SIZE) {
+			std::cerr << "Error: Corrupted PBF file " << file_path << std::endl;
+			return false;
+		}
+
+		header.resize(header_size);
+		if (!file.read(header.data(), header_size)) {
+			std::cerr << "Error: Truncated PBF file " << file_path << std::endl;
+			return false;
+		}
+
+		// BlobHeader: type = 1, datasize = 3
+		std::string_view type;
+		uint32_t data_size = 0;
+		ProtoReader reader(header);
+		while (reader.next()) {
+			if (reader.field == 1 && reader.wire_type == 2) type = reader.bytes();
+			else if (reader.field == 3 && reader.wire_type == 0) data_size = static_cast<uint32_t>(reader.varint());
+			else reader.skip();
+		}
+		if (data_size > MAX_BLOB_SIZE) {
+			std::cerr << "Error: Corrupted PBF file " << file_path << std::endl;
+			return false;
+		}
+
+		uint64_t offset = static_cast<uint64_t>(file.tellg());
+		if (type == "OSMHeader") {
+			// Header is tiny, decode it right away for the bounding box
+			std::string blob(data_size, '\0');
+			std::string block;
+			if (!file.read(blob.data(), data_size) || !inflateBlob(blob, block)) {
+				std::cerr << "Error: Invalid OSMHeader in " << file_path << std::endl;
+				return false;
+			}
+			decodeHeader(block, bbox);
+		}
+		else {
+			// Only OSMData blobs get decoded, unknown blob types are skipped as the format requires
+			if (type == "OSMData") {
+				blobs.push_back({ offset, data_size });
+			}
+			file.seekg(data_size, std::ios::cur);
+		}
+	}
+	return true;
+}
+
+void ParsePBF::decodeBlob(const std::string& file_path, const Blob& blob, ParseOSM::PartialGraph& partial) {
+	std::ifstream file(file_path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Error: Could not open file " << file_path << std::endl;
+		return;
+	}
+
+	std::string data(blob.size, '\0');
+	file.seekg(blob.offset);
+	if (!file.read(data.data(), blob.size)) {
+		std::cerr << "Error: Truncated PBF file " << file_path << std::endl;
+		return;
+	}
+
+	std::string block;
+	if (!inflateBlob(data, block)) {
+		std::cerr << "Error: Could not decompress blob at offset " << blob.offset << " in " << file_path << std::endl;
+		return;
+	}
+	std::string().swap(data); // Compressed data is not needed anymore
+
+	decodePrimitiveBlock(block, partial);
+}
+
+bool ParsePBF::inflateBlob(std::string_view blob, std::string& out) {
+	// Blob: raw = 1, raw_size = 2, zlib_data = 3, other fields are other compression methods
+	std::string_view raw, zlib_data;
+	uint64_t raw_size = 0;
+	bool unsupported = false;
+	ProtoReader reader(blob);
+	while (reader.next()) {
+		if (reader.field == 1 && reader.wire_type == 2) raw = reader.bytes();
+		else if (reader.field == 2 && reader.wire_type == 0) raw_size = reader.varint();
+		else if (reader.field == 3 && reader.wire_type == 2) zlib_data = reader.bytes();
+		else if (reader.wire_type == 2 && reader.field >= 4) {
+			unsupported = true; // lzma, lz4 or zstd
+			reader.skip();
+		}
+		else reader.skip();
+	}
+
+	if (!raw.empty()) {
+		out.assign(raw);
+		return true;
+	}
+	if (zlib_data.empty() || raw_size > MAX_BLOB_SIZE) {
+		if (unsupported) {
+			std::cerr << "Error: Only zlib compressed PBF files are supported." << std::endl;
+		}
+		return false;
+	}
+
+#ifdef MAPVIEWER_HAS_ZLIB
+	out.resize(raw_size);
+	uLongf out_size = static_cast<uLongf>(raw_size);
+	int result = uncompress(reinterpret_cast<Bytef*>(out.data()), &out_size,
+		reinterpret_cast<const Bytef*>(zlib_data.data()), static_cast<uLong>(zlib_data.size()));
+	return result == Z_OK && out_size == raw_size;
+#else
+	std::cerr << "Error: MapViewer was built without zlib, compressed PBF files can't be read." << std::endl;
+	return false;
+#endif
+}
+
+void ParsePBF::decodeHeader(std::string_view block, Graph::Bounds& bbox) {
+	// HeaderBlock: bbox = 1, required_features = 4
+	ProtoReader reader(block);
+	while (reader.next()) {
+		if (reader.field == 1 && reader.wire_type == 2) {
+			// HeaderBBox in nanodegrees: left = 1, right = 2, top = 3, bottom = 4
+			int64_t left = 0, right = 0, top = 0, bottom = 0;
+			ProtoReader box(reader.bytes());
+			while (box.next()) {
+				switch (box.field) {
+				case 1: left = box.svarint(); break;
+				case 2: right = box.svarint(); break;
+				case 3: top = box.svarint(); break;
+				case 4: bottom = box.svarint(); break;
+				default: box.skip(); break;
+				}
+			}
+			bbox.expand({ bottom / 1e9, top / 1e9, left / 1e9, right / 1e9 });
+		}
+		else if (reader.field == 4 && reader.wire_type == 2) {
+			std::string_view feature = reader.bytes();
+			if (feature != "OsmSchema-V0.6" && feature != "DenseNodes") {
+				std::cerr << "Warning: Unsupported PBF feature " << feature << ", map may be incomplete." << std::endl;
+			}
+		}
+		else {
+			reader.skip();
+		}
+	}
+}
+
+void ParsePBF::decodePrimitiveBlock(std::string_view block, ParseOSM::PartialGraph& partial) {
+	// PrimitiveBlock: stringtable = 1, primitivegroup = 2, granularity = 17, lat_offset = 19, lon_offset = 20
+	// Groups get decoded only after the whole block is read, since granularity and offsets come after them
+	std::vector<std::string_view> strings;
+	std::vector<std::string_view> groups;
+	int64_t granularity = 100, lat_offset = 0, lon_offset = 0;
+
+	ProtoReader reader(block);
+	while (reader.next()) {
+		switch (reader.field) {
+		case 1: {
+			ProtoReader table(reader.bytes());
+			while (table.next()) {
+				if (table.field == 1) strings.push_back(table.bytes());
+				else table.skip();
+			}
+			break;
+		}
+		case 2: groups.push_back(reader.bytes()); break;
+		case 17: granularity = static_cast<int64_t>(reader.varint()); break;
+		case 19: lat_offset = static_cast<int64_t>(reader.varint()); break;
+		case 20: lon_offset = static_cast<int64_t>(reader.varint()); break;
+		default: reader.skip(); break;
+		}
+	}
+
+	// Filter by the file's bounds if the header had them, otherwise bounds are taken from the nodes
+	bool has_bounds = partial.bbox.min_lat <= partial.bbox.max_lat;
+	auto addNode = [&](int64_t id, int64_t lat, int64_t lon) {
+		// Integer nanodegrees divided exactly once, which rounds the same way as parsing the decimal text
+		Graph::Node n{ (lat_offset + granularity * lat) / 1e9, (lon_offset + granularity * lon) / 1e9 };
+		if (!has_bounds) {
+			partial.bbox.expand({ n.lat, n.lat, n.lon, n.lon });
+		}
+		else if (!partial.bbox.contains(n.lat, n.lon)) {
+			return;
+		}
+		partial.nodes.emplace_back(id, n);
+	};
+	auto string = [&](uint64_t index) {
+		return index < strings.size() ? strings[index] : std::string_view();
+	};
+
+	std::vector<int64_t> refs;
+	for (std::string_view group_data : groups) {
+		// PrimitiveGroup: nodes = 1, dense = 2, ways = 3
+		ProtoReader group(group_data);
+		while (group.next()) {
+			if (group.field == 1 && group.wire_type == 2) {
+				// Node: id = 1, lat = 8, lon = 9
+				int64_t id = 0, lat = 0, lon = 0;
+				ProtoReader node(group.bytes());
+				while (node.next()) {
+					switch (node.field) {
+					case 1: id = node.svarint(); break;
+					case 8: lat = node.svarint(); break;
+					case 9: lon = node.svarint(); break;
+					default: node.skip(); break;
+					}
+				}
+				addNode(id, lat, lon);
+			}
+			else if (group.field == 2 && group.wire_type == 2) {
+				// DenseNodes: packed delta coded id = 1, lat = 8, lon = 9
+				std::string_view ids_data, lats_data, lons_data;
+				ProtoReader dense(group.bytes());
+				while (dense.next()) {
+					switch (dense.field) {
+					case 1: ids_data = dense.bytes(); break;
+					case 8: lats_data = dense.bytes(); break;
+					case 9: lons_data = dense.bytes(); break;
+					default: dense.skip(); break;
+					}
+				}
+				ProtoReader ids(ids_data), lats(lats_data), lons(lons_data);
+				int64_t id = 0, lat = 0, lon = 0;
+				while (!ids.empty() && !lats.empty() && !lons.empty()) {
+					id += ids.svarint();
+					lat += lats.svarint();
+					lon += lons.svarint();
+					addNode(id, lat, lon);
+				}
+			}
+			else if (group.field == 3 && group.wire_type == 2) {
+				// Way: id = 1, packed keys = 2, packed vals = 3, packed delta coded refs = 8
+				std::string_view keys_data, vals_data, refs_data;
+				int64_t way_id = 0;
+				ProtoReader way(group.bytes());
+				while (way.next()) {
+					switch (way.field) {
+					case 1: way_id = static_cast<int64_t>(way.varint()); break;
+					case 2: keys_data = way.bytes(); break;
+					case 3: vals_data = way.bytes(); break;
+					case 8: refs_data = way.bytes(); break;
+					default: way.skip(); break;
+					}
+				}
+
+				// Check all tags in the way to make sure way passes our filter
+				bool is_valid = true;
+				ProtoReader keys(keys_data), vals(vals_data);
+				while (is_valid && !keys.empty() && !vals.empty()) {
+					is_valid = ParseOSM::isValidWay(string(keys.varint()), string(vals.varint()));
+				}
+				if (!is_valid) continue;
+
+				refs.clear();
+				ProtoReader ref_reader(refs_data);
+				for (int64_t ref = 0; !ref_reader.empty();) {
+					ref += ref_reader.svarint();
+					refs.push_back(ref);
+				}
+				for (size_t i = 1; i < refs.size(); ++i) {
+					partial.segments.push_back({ refs[i - 1], refs[i] });
+				}
+				if (refs.size() > 1) {
+					partial.ways.emplace_back(way_id, static_cast<uint32_t>(refs.size() - 1));
+				}
+			}
+			else {
+				group.skip(); // Relations and changesets
+			}
+		}
+	}
+}
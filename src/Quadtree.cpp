@@ -1,78 +1,203 @@
 #include "Quadtree.hpp"
+#include <algorithm>
+#include <thread>
 
-Quadtree::Quadtree(const Bounds& bounds, unsigned int capacity) :
-	bounds(bounds), capacity(capacity), divided(false)
-{}
-
-void Quadtree::insert(TreeEdge* edge) {
-    // Determine the bounding box for the edge
-    Bounds edge_bounds = {
-        std::min(edge->v1.x, edge->v2.x),
-        std::min(edge->v1.y, edge->v2.y),
-        std::max(edge->v1.x, edge->v2.x),
-        std::max(edge->v1.y, edge->v2.y)
-    };
+// Edges projected at a time before they are handed to insertion
+constexpr uint32_t PROJECT_CHUNK = 1 << 14;
+
+// Cells this deep keep every edge given to them, so edges on top of each other can't divide forever
+constexpr unsigned int MAX_DEPTH = 24;
+
+// Cell of the tree while building, edges are kept per cell until the tree is flattened
+struct BuildCell {
+    BuildCell() = default;
+    explicit BuildCell(const Quadtree::Bounds& cell_bounds) : bounds(cell_bounds) {}
+
+    Quadtree::Bounds bounds;
+    uint32_t first_child = 0;
+    std::vector<uint32_t> edges;
+};
 
-    // Cannot insert if the edge bounds don't fit the view
-    if (!intersects(bounds, edge_bounds)) {
+// Insert an edge into the smallest cell that holds it
+// Cells are referred to by index, since dividing a cell grows the vector
+static void insert(std::vector<BuildCell>& cells, uint32_t cell, uint32_t edge, const Quadtree::Bounds& edge_bounds,
+    unsigned int capacity, unsigned int depth) {
+    // Add edges to current cell if capacity hasn't been reached
+    // Else subdivide current cell to four quadrants and create children
+    if ((cells[cell].first_child == 0 && cells[cell].edges.size() < capacity) || depth == MAX_DEPTH) {
+        cells[cell].edges.push_back(edge);
         return;
     }
+    if (cells[cell].first_child == 0) {
+        // Subdivide current bounding box to four quadrants with equal sizes
+        Quadtree::Bounds b = cells[cell].bounds;
+        float mid_x = (b.left + b.right) / 2;
+        float mid_y = (b.top + b.bottom) / 2;
+        cells[cell].first_child = static_cast<uint32_t>(cells.size());
+        cells.push_back(BuildCell({ b.left, b.top, mid_x, mid_y }));
+        cells.push_back(BuildCell({ mid_x, b.top, b.right, mid_y }));
+        cells.push_back(BuildCell({ b.left, mid_y, mid_x, b.bottom }));
+        cells.push_back(BuildCell({ mid_x, mid_y, b.right, b.bottom }));
+    }
+
+    // Move down into the child that covers the whole edge
+    // Edges crossing the middle of the cell stay in it, so every edge is stored exactly once
+    uint32_t first_child = cells[cell].first_child;
+    for (uint32_t child = first_child; child < first_child + 4; ++child) {
+        const Quadtree::Bounds& bounds = cells[child].bounds;
+        if (edge_bounds.left >= bounds.left && edge_bounds.right <= bounds.right &&
+            edge_bounds.top >= bounds.top && edge_bounds.bottom <= bounds.bottom) {
+            insert(cells, child, edge, edge_bounds, capacity, depth + 1);
+            return;
+        }
+    }
+    cells[cell].edges.push_back(edge);
+}
 
-    // Add edges to current node if capacity hasn't been reached
-    // Else subdivide current node to four quadrants and create children
-    if (edges.size() < capacity) {
-        edges.push_back(edge);
+void Quadtree::build(const Graph& graph, unsigned int capacity, Progress* progress) {
+    const FlatArray<Graph::Edge>& edges = graph.getEdges();
+    uint32_t num_edges = static_cast<uint32_t>(edges.size());
+    auto new_segments = std::make_shared<std::vector<Segment>>(num_edges);
+    std::atomic<size_t> local_projected{ 0 };
+    std::atomic<size_t>& projected = progress ? progress->projected : local_projected;
+    if (progress) {
+        progress->segments = new_segments;
     }
-    else {
-        if (!divided) {
-            subdivide();
+
+    // Project edge endpoints in chunks while this thread inserts the chunks already done
+    std::thread projector([&graph, &edges, &projected, num_edges, out = new_segments->data()]() {
+        std::vector<uint32_t> endpoints(2 * PROJECT_CHUNK);
+        std::vector<Point> points(2 * PROJECT_CHUNK);
+        for (uint32_t begin = 0; begin < num_edges; begin += PROJECT_CHUNK) {
+            uint32_t end = std::min(num_edges, begin + PROJECT_CHUNK);
+            // Look up the endpoints of the chunk, then project them all at once
+            for (uint32_t id = begin; id < end; ++id) {
+                endpoints[2 * (id - begin)] = static_cast<uint32_t>(graph.findIndex(edges[id].from));
+                endpoints[2 * (id - begin) + 1] = static_cast<uint32_t>(graph.findIndex(edges[id].to));
+            }
+            project(graph, endpoints.data(), 2 * (end - begin), points.data());
+            for (uint32_t id = begin; id < end; ++id) {
+                out[id] = { points[2 * (id - begin)], points[2 * (id - begin) + 1] };
+            }
+            projected.store(end, std::memory_order_release);
         }
-        for (auto& child : children) {
-            child->insert(edge);
+    });
+
+    // Insert every edge starting from the root, which covers the whole map
+    std::vector<BuildCell> build_cells(1);
+    build_cells[0].bounds = { 0, 0, 1, 1 };
+    const Segment* ready_segments = new_segments->data();
+    for (uint32_t id = 0; id < num_edges;) {
+        uint32_t ready = static_cast<uint32_t>(projected.load(std::memory_order_acquire));
+        if (ready == id) {
+            std::this_thread::yield();
+            continue;
         }
+        for (; id < ready; ++id) {
+            insert(build_cells, 0, id, segmentBounds(ready_segments[id]), capacity, 0);
+        }
+    }
+    projector.join();
+
+    // Flatten the edge lists of the cells into one array
+    std::vector<Cell> new_cells(build_cells.size());
+    std::vector<uint32_t> new_cell_edges;
+    for (size_t i = 0; i < build_cells.size(); ++i) {
+        new_cells[i].bounds = build_cells[i].bounds;
+        new_cells[i].first_child = build_cells[i].first_child;
+        new_cells[i].begin = static_cast<uint32_t>(new_cell_edges.size());
+        new_cell_edges.insert(new_cell_edges.end(), build_cells[i].edges.begin(), build_cells[i].edges.end());
+        new_cells[i].end = static_cast<uint32_t>(new_cell_edges.size());
     }
+
+    // The projected edges may still be read through progress, so they are shared instead of moved
+    segments = FlatArray<Segment>(new_segments->data(), new_segments->size(), new_segments);
+    cells = std::move(new_cells);
+    cell_edges = std::move(new_cell_edges);
+}
+
+void Quadtree::setArrays(FlatArray<Segment> new_segments, FlatArray<Cell> new_cells, FlatArray<uint32_t> new_cell_edges) {
+    segments = std::move(new_segments);
+    cells = std::move(new_cells);
+    cell_edges = std::move(new_cell_edges);
 }
 
-void Quadtree::query(const Bounds& queryBounds, std::vector<TreeEdge*>& result) const {
+void Quadtree::query(const Bounds& query_bounds, std::vector<uint32_t>& result) const {
+    if (!cells.empty()) {
+        query(0, query_bounds, result);
+    }
+}
+
+void Quadtree::query(uint32_t cell, const Bounds& query_bounds, std::vector<uint32_t>& result) const {
     // Return condition for recursion
-    if (!intersects(bounds, queryBounds)) {
+    if (!intersects(cells[cell].bounds, query_bounds)) {
         return;
     }
 
-    // Add edges within this node
-    for (const auto& edge : edges) {
-        if (intersects(queryBounds, *edge)) {
-            result.push_back(edge);
+    // Add edges within this cell
+    for (uint32_t i = cells[cell].begin; i < cells[cell].end; ++i) {
+        if (intersects(query_bounds, segmentBounds(segments[cell_edges[i]]))) {
+            result.push_back(cell_edges[i]);
         }
     }
 
-    // If the node is divided query the children withing bounds
-    if (divided) {
-        for (const auto& child : children) {
-            child->query(queryBounds, result);
+    // If the cell is divided query the children within bounds
+    uint32_t first_child = cells[cell].first_child;
+    if (first_child != 0) {
+        for (uint32_t child = first_child; child < first_child + 4; ++child) {
+            query(child, query_bounds, result);
         }
     }
 }
 
-void Quadtree::subdivide() {
-    // Calculate limits for quadrant bounding boxes
-    float midX = (bounds.left + bounds.right) / 2;
-    float midY = (bounds.top + bounds.bottom) / 2;
+Quadtree::Point Quadtree::project(const Graph::Bounds& bbox, double lat, double lon) {
+    // Prevent division by zero
+    double lat_range = std::max(bbox.max_lat - bbox.min_lat, 1e-6);
+    double lon_range = std::max(bbox.max_lon - bbox.min_lon, 1e-6);
+
+    // Normalize so that north is up
+    return { static_cast<float>((lon - bbox.min_lon) / lon_range), static_cast<float>((bbox.max_lat - lat) / lat_range) };
+}
+
+void Quadtree::project(const Graph& graph, const uint32_t* indices, size_t count, Point* out) {
+    const Graph::Bounds& bbox = graph.bbox;
+    double lat_range = std::max(bbox.max_lat - bbox.min_lat, 1e-6);
+    double lon_range = std::max(bbox.max_lon - bbox.min_lon, 1e-6);
 
-    // Subdivide current bounding box to four quadrants with equal sizes
-    children[0] = std::make_unique<Quadtree>(Bounds{ bounds.left, bounds.top, midX, midY });
-    children[1] = std::make_unique<Quadtree>(Bounds{ midX, bounds.top, bounds.right, midY });
-    children[2] = std::make_unique<Quadtree>(Bounds{ bounds.left, midY, midX, bounds.bottom });
-    children[3] = std::make_unique<Quadtree>(Bounds{ midX, midY, bounds.right, bounds.bottom });
+    // Same as projecting one node at a time, with the fixed-point scale folded into one multiply and add per axis
+    double x_scale = 1.0 / (COORDINATE_SCALE * lon_range);
+    double x_offset = -bbox.min_lon / lon_range;
+    double y_scale = -1.0 / (COORDINATE_SCALE * lat_range);
+    double y_offset = bbox.max_lat / lat_range;
+    const int32_t* lats = graph.getArrays().node_lats.data();
+    const int32_t* lons = graph.getArrays().node_lons.data();
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = { static_cast<float>(lons[indices[i]] * x_scale + x_offset), static_cast<float>(lats[indices[i]] * y_scale + y_offset) };
+    }
+}
 
-    divided = true;
+Graph::Bounds Quadtree::toEarth(const Graph::Bounds& bbox, const Bounds& map_bounds) {
+    double lat_range = std::max(bbox.max_lat - bbox.min_lat, 1e-6);
+    double lon_range = std::max(bbox.max_lon - bbox.min_lon, 1e-6);
+
+    // y grows southwards, so the bottom of the bounds is the lowest latitude
+    Graph::Bounds earth;
+    earth.min_lat = bbox.max_lat - map_bounds.bottom * lat_range;
+    earth.max_lat = bbox.max_lat - map_bounds.top * lat_range;
+    earth.min_lon = bbox.min_lon + map_bounds.left * lon_range;
+    earth.max_lon = bbox.min_lon + map_bounds.right * lon_range;
+    return earth;
 }
 
-bool Quadtree::intersects(const Bounds& a, const Bounds& b) const {
+bool Quadtree::intersects(const Bounds& a, const Bounds& b) {
     return !(a.right < b.left || a.left > b.right || a.bottom < b.top || a.top > b.bottom);
 }
 
-bool Quadtree::intersects(const Bounds& a, const TreeEdge& edge) const {
-    return intersects(a, Bounds{ edge.v1.x, edge.v1.y, edge.v2.x, edge.v2.y });
+Quadtree::Bounds Quadtree::segmentBounds(const Segment& segment) {
+    return {
+        std::min(segment.from.x, segment.to.x),
+        std::min(segment.from.y, segment.to.y),
+        std::max(segment.from.x, segment.to.x),
+        std::max(segment.from.y, segment.to.y)
+    };
 }
-
@@ -0,0 +1,124 @@
+#include "RoutingGraph.hpp"
+
+void RoutingGraph::build(const Graph& graph) {
+	const Graph::Arrays& arrays = graph.getArrays();
+	size_t num_nodes = arrays.node_ids.size();
+	const uint32_t* offsets = arrays.adj_offsets.data();
+	const uint32_t* targets = arrays.adj_targets.data();
+	const double* weights = arrays.adj_weights.data();
+	const uint32_t* edge_ids = arrays.adj_edges.data();
+
+	// A node continues a chain if it has exactly two different neighbors, neither of them itself
+	// Anything else, parallel edges and self loops included, is a junction
+	std::vector<bool> is_junction(num_nodes);
+	for (uint32_t i = 0; i < num_nodes; ++i) {
+		uint32_t begin = offsets[i];
+		is_junction[i] = offsets[i + 1] - begin != 2 ||
+			targets[begin] == targets[begin + 1] || targets[begin] == i || targets[begin + 1] == i;
+	}
+
+	node_chains.assign(num_nodes, NONE);
+	node_steps.assign(num_nodes, 0);
+	node_offsets.assign(num_nodes, 0);
+	chains.clear();
+	chain_edges.clear();
+	chain_edges.reserve(graph.getEdges().size());
+	std::vector<bool> edge_done(graph.getEdges().size(), false);
+
+	// Follow every edge of a junction not yet in a chain until the next junction
+	// Chain ends are node indices until the junctions are numbered
+	auto walk = [&](uint32_t start) {
+		for (uint32_t pos = offsets[start]; pos < offsets[start + 1]; ++pos) {
+			if (edge_done[edge_ids[pos]]) continue; // Walked from the other end
+			uint32_t chain = static_cast<uint32_t>(chains.size());
+			uint32_t begin = static_cast<uint32_t>(chain_edges.size());
+			uint32_t prev = start, at = pos;
+			double weight = 0;
+			while (true) {
+				edge_done[edge_ids[at]] = true;
+				chain_edges.push_back(edge_ids[at]);
+				weight += weights[at];
+				uint32_t node = targets[at];
+				if (is_junction[node]) {
+					chains.push_back({ start, node, weight, begin, static_cast<uint32_t>(chain_edges.size()) });
+					break;
+				}
+				node_chains[node] = chain;
+				node_steps[node] = static_cast<uint32_t>(chain_edges.size()) - begin;
+				node_offsets[node] = weight;
+
+				// Leave by the edge that doesn't go back
+				at = targets[offsets[node]] == prev ? offsets[node] + 1 : offsets[node];
+				prev = node;
+			}
+		}
+	};
+	for (uint32_t i = 0; i < num_nodes; ++i) {
+		if (is_junction[i]) walk(i);
+	}
+
+	// Rings of degree-2 nodes have no junction to start from, one of their nodes becomes one
+	for (uint32_t i = 0; i < num_nodes; ++i) {
+		if (!is_junction[i] && node_chains[i] == NONE) {
+			is_junction[i] = true;
+			walk(i);
+		}
+	}
+
+	// Number the junctions in node order, so that junctions close in the graph stay close in memory
+	junction_nodes.clear();
+	node_junctions.assign(num_nodes, NONE);
+	for (uint32_t i = 0; i < num_nodes; ++i) {
+		if (is_junction[i]) {
+			node_junctions[i] = static_cast<uint32_t>(junction_nodes.size());
+			junction_nodes.push_back(i);
+		}
+	}
+
+	// Adjacency over junctions, loops are left out since no shortest path between junctions uses them
+	adj_offsets.assign(junction_nodes.size() + 1, 0);
+	for (Chain& chain : chains) {
+		chain.from = node_junctions[chain.from];
+		chain.to = node_junctions[chain.to];
+		if (chain.from == chain.to) continue;
+		++adj_offsets[chain.from + 1];
+		++adj_offsets[chain.to + 1];
+	}
+	for (size_t i = 1; i < adj_offsets.size(); ++i) {
+		adj_offsets[i] += adj_offsets[i - 1];
+	}
+	adj_targets.resize(adj_offsets.back());
+	adj_weights.resize(adj_offsets.back());
+	adj_chains.resize(adj_offsets.back());
+	std::vector<uint32_t> fill(adj_offsets.begin(), adj_offsets.end() - 1);
+	for (uint32_t id = 0; id < chains.size(); ++id) {
+		const Chain& chain = chains[id];
+		if (chain.from == chain.to) continue;
+		uint32_t pos = fill[chain.from]++;
+		adj_targets[pos] = chain.to;
+		adj_weights[pos] = chain.weight;
+		adj_chains[pos] = id;
+		pos = fill[chain.to]++;
+		adj_targets[pos] = chain.from;
+		adj_weights[pos] = chain.weight;
+		adj_chains[pos] = id;
+	}
+}
+
+size_t RoutingGraph::memoryBytes() const {
+	return junction_nodes.size() * sizeof(uint32_t) +
+		node_junctions.size() * (3 * sizeof(uint32_t) + sizeof(double)) +
+		chains.size() * sizeof(Chain) + chain_edges.size() * sizeof(uint32_t) +
+		adj_offsets.size() * sizeof(uint32_t) + adj_targets.size() * (2 * sizeof(uint32_t) + sizeof(double));
+}
+
+RoutingGraph::Location RoutingGraph::locate(uint32_t node) const {
+	Location location;
+	location.junction = node_junctions[node];
+	if (location.junction == NONE) {
+		location.chain = node_chains[node];
+		location.step = node_steps[node];
+		location.offset = node_offsets[node];
+	}
+	return location;
+}
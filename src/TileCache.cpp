@@ -0,0 +1,140 @@
+#include "TileCache.hpp"
+#include "MappedFile.hpp"
+#include <algorithm>
+
+TileCache::TileCache(const Graph& graph, size_t memory_budget) : graph(graph), memory_budget(memory_budget) {
+	size_t num_tiles = graph.getArrays().tiles.size();
+	positions.resize(num_tiles);
+	loaded.resize(num_tiles, false);
+}
+
+void TileCache::addEdgeArray(const void* data, size_t element_size) {
+	std::lock_guard<std::mutex> lock(mutex);
+	edge_arrays.push_back({ static_cast<const char*>(data), element_size });
+}
+
+void TileCache::useNode(size_t index) {
+	const FlatArray<Graph::Tile>& tiles = graph.getArrays().tiles;
+	uint32_t last = last_tile.load(std::memory_order_relaxed);
+	if (last < tiles.size() && index >= tiles[last].node_begin && index < tiles[last].node_end) {
+		return;
+	}
+
+	uint32_t tile = findTile(index);
+	if (tile >= tiles.size()) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	use(tile);
+	last_tile.store(tile, std::memory_order_relaxed);
+}
+
+void TileCache::useArea(const Graph::Bounds& area) {
+	const FlatArray<Graph::Tile>& tiles = graph.getArrays().tiles;
+	std::lock_guard<std::mutex> lock(mutex);
+	for (uint32_t tile = 0; tile < tiles.size(); ++tile) {
+		const Graph::Bounds& bounds = tiles[tile].bounds;
+		if (bounds.max_lat >= area.min_lat && bounds.min_lat <= area.max_lat &&
+			bounds.max_lon >= area.min_lon && bounds.min_lon <= area.max_lon) {
+			use(tile);
+		}
+	}
+}
+
+size_t TileCache::getLoadedBytes() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return loaded_bytes;
+}
+
+size_t TileCache::getLoadedTiles() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return recent.size();
+}
+
+void TileCache::use(uint32_t tile) {
+	if (loaded[tile]) {
+		recent.splice(recent.begin(), recent, positions[tile]);
+		return;
+	}
+
+	advise(tile, true);
+	recent.push_front(tile);
+	positions[tile] = recent.begin();
+	loaded[tile] = true;
+	loaded_bytes += tileBytes(tile);
+
+	// Release the least recently used tiles, keeping at least the one just loaded
+	while (loaded_bytes > memory_budget && recent.size() > 1) {
+		uint32_t old = recent.back();
+		recent.pop_back();
+		loaded[old] = false;
+		loaded_bytes -= tileBytes(old);
+		advise(old, false);
+		if (last_tile.load(std::memory_order_relaxed) == old) {
+			last_tile.store(UINT32_MAX, std::memory_order_relaxed);
+		}
+	}
+}
+
+size_t TileCache::tileBytes(uint32_t tile) const {
+	const Graph::Arrays& arrays = graph.getArrays();
+	const Graph::Tile& t = arrays.tiles[tile];
+	size_t nodes = t.node_end - t.node_begin;
+	size_t neighbors = arrays.adj_offsets[t.node_end] - arrays.adj_offsets[t.node_begin];
+	size_t edges = t.edge_end - t.edge_begin;
+
+	size_t bytes = nodes * Graph::NODE_MEMORY;
+	bytes += neighbors * (sizeof(uint32_t) + sizeof(double) + sizeof(uint32_t));
+	bytes += edges * (sizeof(Graph::Edge) + sizeof(int64_t));
+	for (const EdgeArray& array : edge_arrays) {
+		bytes += edges * array.element_size;
+	}
+	return bytes;
+}
+
+void TileCache::advise(uint32_t tile, bool load) const {
+	const Graph::Arrays& arrays = graph.getArrays();
+	const Graph::Tile& t = arrays.tiles[tile];
+	uint32_t row_begin = arrays.adj_offsets[t.node_begin];
+	uint32_t row_end = arrays.adj_offsets[t.node_end];
+
+	auto advise_range = [load](const void* data, size_t size) {
+		if (load) {
+			MappedFile::prefetch(data, size);
+		}
+		else {
+			MappedFile::evict(data, size);
+		}
+	};
+	// Arrays that have been copied into the graph's own memory are left alone
+	auto range = [&advise_range](const auto& array, size_t first, size_t count) {
+		if (array.isMapped()) {
+			advise_range(array.data() + first, count * sizeof(array[0]));
+		}
+	};
+	size_t nodes = t.node_end - t.node_begin;
+	range(arrays.node_ids, t.node_begin, nodes);
+	range(arrays.node_lats, t.node_begin, nodes);
+	range(arrays.node_lons, t.node_begin, nodes);
+	range(arrays.adj_offsets, t.node_begin, nodes + 1);
+
+	size_t neighbors = row_end - row_begin;
+	range(arrays.adj_targets, row_begin, neighbors);
+	range(arrays.adj_weights, row_begin, neighbors);
+	range(arrays.adj_edges, row_begin, neighbors);
+
+	size_t edges = t.edge_end - t.edge_begin;
+	range(graph.getEdges(), t.edge_begin, edges);
+	range(graph.getEdgeWays(), t.edge_begin, edges);
+	for (const EdgeArray& array : edge_arrays) {
+		advise_range(array.data + t.edge_begin * array.element_size, edges * array.element_size);
+	}
+}
+
+uint32_t TileCache::findTile(size_t index) const {
+	// Tiles are in node order
+	const FlatArray<Graph::Tile>& tiles = graph.getArrays().tiles;
+	const Graph::Tile* it = std::upper_bound(tiles.begin(), tiles.end(), index, [](size_t value, const Graph::Tile& tile) {
+		return value < tile.node_begin;
+	});
+	if (it == tiles.begin()) return UINT32_MAX;
+	return static_cast<uint32_t>(it - tiles.begin() - 1);
+}
@@ -1,10 +1,28 @@
 #include "App.hpp"
 #include "GraphLoader.hpp"
+#include "Benchmark.hpp"
+#include <string>
+#include <vector>
+#include <thread>
 
-int main() {
+int main(int argc, char* argv[]) {
+	// Run benchmarks instead of the viewer when requested
+	if (argc > 1 && std::string(argv[1]) == "--bench") {
+		return Benchmark::run(std::vector<std::string>(argv + 2, argv + argc));
+	}
+
+	// Apply .osc change files to the binary map and exit
+	if (argc > 1 && std::string(argv[1]) == "--apply") {
+		return GraphLoader::applyChanges(std::vector<std::string>(argv + 2, argv + argc)) ? 0 : 1;
+	}
+
+	// Load the map in the background, the window opens right away and shows the map as it becomes ready
 	Graph graph;
-	GraphLoader::loadGraph(graph);
+	Quadtree quadtree;
+	LoadProgress progress;
+	std::thread loader([&]() { GraphLoader::loadGraph(graph, quadtree, &progress); });
 
-    App app(graph);
+    App app(graph, quadtree, progress);
     app.run();
+    loader.join();
 }
\ No newline at end of file